@@ -0,0 +1,58 @@
+#pragma once
+
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace ad {
+namespace ent {
+namespace bench {
+
+
+/// \brief Prevents the compiler from optimizing away a computed value.
+/// \details The value is made observable through a compiler barrier, which emits no instruction.
+template <class T_value>
+void doNotOptimize(const T_value & aValue)
+{
+#if defined(_MSC_VER)
+    // No inline assembly on x64: reading the value through a volatile pointer keeps it computed.
+    (void)*reinterpret_cast<const volatile char *>(&aValue);
+    _ReadWriteBarrier();
+#else
+    asm volatile("" : : "g"(&aValue) : "memory");
+#endif
+}
+
+
+/// \brief Run `aOperation` once, and report the time per item for `aItemCount` items.
+/// \note Intentionally minimal: the benchmarks are not intended as a statistical
+/// tool, but as a quick way to compare implementations on the same machine.
+template <class F_operation>
+double measure(const char * aLabel, std::size_t aItemCount, F_operation && aOperation)
+{
+    using Clock_t = std::chrono::steady_clock;
+
+    Clock_t::time_point start = Clock_t::now();
+    aOperation();
+    std::chrono::duration<double, std::nano> elapsed = Clock_t::now() - start;
+
+    double perItem = elapsed.count() / static_cast<double>(aItemCount);
+    std::cout << std::left << std::setw(64) << aLabel
+              << std::right << std::setw(12) << std::fixed << std::setprecision(2)
+              << perItem << " ns/item"
+              << std::setw(12) << std::setprecision(1)
+              << elapsed.count() / 1e6 << " ms total\n";
+    return perItem;
+}
+
+
+} // namespace bench
+} // namespace ent
+} // namespace ad
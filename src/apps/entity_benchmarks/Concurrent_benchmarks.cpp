@@ -0,0 +1,126 @@
+#include "Benchmark.h"
+
+#include <entity/Entity.h>
+#include <entity/EntityManager.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+namespace bench {
+
+
+namespace {
+
+    struct Position
+    {
+        float x, y, z;
+    };
+
+    struct Velocity
+    {
+        float x, y, z;
+    };
+
+    constexpr std::size_t gEntityCount = 400'000;
+
+    /// \brief Run `aJob(threadId, phase)` on `aThreadCount` threads, each with its own Phase.
+    /// \return The phases, which must be completed on the calling thread.
+    template <class F_job>
+    std::vector<std::unique_ptr<Phase>> runJobs(std::size_t aThreadCount, F_job && aJob)
+    {
+        std::vector<std::unique_ptr<Phase>> phases;
+        std::vector<std::thread> threads;
+        for (std::size_t threadId = 0; threadId != aThreadCount; ++threadId)
+        {
+            Phase & phase = *phases.emplace_back(std::make_unique<Phase>());
+            threads.emplace_back([&aJob, threadId, &phase]()
+            {
+                aJob(threadId, phase);
+            });
+        }
+        for (std::thread & thread : threads)
+        {
+            thread.join();
+        }
+        return phases;
+    }
+
+} // anonymous namespace
+
+
+void runConcurrentBenchmarks()
+{
+    std::cout << "== Concurrent creation (" << gEntityCount << " entities, "
+              << std::thread::hardware_concurrency() << " hardware threads)\n";
+
+    for (std::size_t threadCount : {1, 2, 4, 8})
+    {
+        const std::size_t perThread = gEntityCount / threadCount;
+        const std::string suffix = ", " + std::to_string(threadCount) + " threads";
+
+        {
+            EntityManager world;
+            std::mutex mutex;
+            measure(("addEntity() under a mutex" + suffix).c_str(), gEntityCount, [&]()
+            {
+                runJobs(threadCount, [&](std::size_t, Phase &)
+                {
+                    for (std::size_t i = 0; i != perThread; ++i)
+                    {
+                        std::lock_guard<std::mutex> lock{mutex};
+                        doNotOptimize(world.addEntity());
+                    }
+                });
+            });
+        }
+
+        {
+            EntityManager world;
+            std::vector<std::unique_ptr<Phase>> phases;
+            measure(("addEntity(Phase), reservation" + suffix).c_str(), gEntityCount, [&]()
+            {
+                phases = runJobs(threadCount, [&](std::size_t, Phase & aPhase)
+                {
+                    for (std::size_t i = 0; i != perThread; ++i)
+                    {
+                        doNotOptimize(world.addEntity(aPhase));
+                    }
+                });
+            });
+            measure(("addEntity(Phase), completing the phases" + suffix).c_str(), gEntityCount, [&]()
+            {
+                phases.clear();
+            });
+        }
+
+        {
+            EntityManager world;
+            std::vector<std::unique_ptr<Phase>> phases;
+            measure(("spawn(Phase, 2 components), reservation" + suffix).c_str(), gEntityCount, [&]()
+            {
+                phases = runJobs(threadCount, [&](std::size_t, Phase & aPhase)
+                {
+                    for (std::size_t i = 0; i != perThread; ++i)
+                    {
+                        doNotOptimize(world.spawn(aPhase, Position{}, Velocity{}));
+                    }
+                });
+            });
+            measure(("spawn(Phase, 2 components), completing the phases" + suffix).c_str(), gEntityCount, [&]()
+            {
+                phases.clear();
+            });
+        }
+    }
+}
+
+
+} // namespace bench
+} // namespace ent
+} // namespace ad
@@ -0,0 +1,127 @@
+#include "Benchmark.h"
+
+#include <entity/Entity.h>
+#include <entity/EntityManager.h>
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+namespace bench {
+
+
+namespace {
+
+    struct Position
+    {
+        float x, y, z;
+    };
+
+    struct Velocity
+    {
+        float x, y, z;
+    };
+
+    constexpr std::size_t gEntityCount = 100'000;
+    constexpr std::size_t gRepetitions = 20;
+
+} // anonymous namespace
+
+
+void runHandleBenchmarks()
+{
+    std::cout << "== Handle (" << gEntityCount << " entities x "
+              << gRepetitions << " repetitions)\n";
+
+    EntityManager world;
+    std::vector<Handle<Entity>> handles;
+    handles.reserve(gEntityCount);
+    {
+        Phase phase;
+        for (std::size_t i = 0; i != gEntityCount; ++i)
+        {
+            handles.push_back(world.addEntity());
+            handles.back().get(phase)
+                ->add(Position{1.f, 2.f, 3.f})
+                .add(Velocity{0.f, 1.f, 0.f});
+        }
+    }
+
+    std::vector<Handle<Entity>> shuffled = handles;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{42});
+
+    const std::size_t itemCount = gEntityCount * gRepetitions;
+
+    measure("get()", itemCount, [&]()
+    {
+        float sum = 0.f;
+        for (std::size_t repetition = 0; repetition != gRepetitions; ++repetition)
+        {
+            for (const Handle<Entity> & handle : handles)
+            {
+                sum += handle.get()->get<Position>().x;
+            }
+        }
+        doNotOptimize(sum);
+    });
+
+    measure("get(phase)", itemCount, [&]()
+    {
+        Phase phase;
+        float sum = 0.f;
+        for (std::size_t repetition = 0; repetition != gRepetitions; ++repetition)
+        {
+            for (Handle<Entity> & handle : handles)
+            {
+                sum += handle.get(phase)->get<Position>().x;
+            }
+        }
+        doNotOptimize(sum);
+    });
+
+    measure("get(), random order", itemCount, [&]()
+    {
+        float sum = 0.f;
+        for (std::size_t repetition = 0; repetition != gRepetitions; ++repetition)
+        {
+            for (const Handle<Entity> & handle : shuffled)
+            {
+                sum += handle.get()->get<Position>().x;
+            }
+        }
+        doNotOptimize(sum);
+    });
+
+    measure("get(), 4 threads", itemCount, [&]()
+    {
+        std::vector<std::thread> threads;
+        for (std::size_t threadId = 0; threadId != 4; ++threadId)
+        {
+            threads.emplace_back([&, threadId]()
+            {
+                float sum = 0.f;
+                for (std::size_t repetition = threadId; repetition < gRepetitions; repetition += 4)
+                {
+                    for (const Handle<Entity> & handle : handles)
+                    {
+                        sum += handle.get()->get<Velocity>().y;
+                    }
+                }
+                doNotOptimize(sum);
+            });
+        }
+        for (std::thread & thread : threads)
+        {
+            thread.join();
+        }
+    });
+}
+
+
+} // namespace bench
+} // namespace ent
+} // namespace ad
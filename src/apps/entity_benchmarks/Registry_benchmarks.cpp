@@ -0,0 +1,283 @@
+#include "Benchmark.h"
+
+#include <entity/Entity.h>
+#include <entity/EntityManager.h>
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+namespace bench {
+
+
+namespace {
+
+    struct Position
+    {
+        float x, y, z;
+    };
+
+    constexpr std::size_t gEntityCount = 1'000'000;
+
+} // anonymous namespace
+
+
+void runRegistryBenchmarks()
+{
+    std::cout << "== Registry (" << gEntityCount << " entities)\n";
+
+    EntityManager world;
+    std::vector<Handle<Entity>> handles;
+    handles.reserve(gEntityCount);
+
+    measure("addEntity()", gEntityCount, [&]()
+    {
+        for (std::size_t i = 0; i != gEntityCount; ++i)
+        {
+            handles.push_back(world.addEntity());
+        }
+    });
+
+    {
+        EntityManager bulkWorld;
+        measure("addEntities()", gEntityCount, [&]()
+        {
+            doNotOptimize(bulkWorld.addEntities(gEntityCount));
+        });
+    }
+
+    measure("add<Position>() (with Phase)", gEntityCount, [&]()
+    {
+        Phase phase;
+        for (Handle<Entity> & handle : handles)
+        {
+            handle.get(phase)->add(Position{1.f, 2.f, 3.f});
+        }
+    });
+
+    std::vector<Handle<Entity>> shuffled = handles;
+    std::shuffle(shuffled.begin(), shuffled.end(), std::mt19937{42});
+
+    measure("isValid(), sequential", gEntityCount, [&]()
+    {
+        std::size_t valid = 0;
+        for (const Handle<Entity> & handle : handles)
+        {
+            valid += handle.isValid();
+        }
+        doNotOptimize(valid);
+    });
+
+    measure("isValid(), random order", gEntityCount, [&]()
+    {
+        std::size_t valid = 0;
+        for (const Handle<Entity> & handle : shuffled)
+        {
+            valid += handle.isValid();
+        }
+        doNotOptimize(valid);
+    });
+
+    measure("get()->get<Position>(), sequential", gEntityCount, [&]()
+    {
+        float sum = 0.f;
+        for (const Handle<Entity> & handle : handles)
+        {
+            sum += handle.get()->get<Position>().x;
+        }
+        doNotOptimize(sum);
+    });
+
+    measure("get()->get<Position>(), random order", gEntityCount, [&]()
+    {
+        float sum = 0.f;
+        for (const Handle<Entity> & handle : shuffled)
+        {
+            sum += handle.get()->get<Position>().x;
+        }
+        doNotOptimize(sum);
+    });
+
+    measure("get(phase)->get<Position>(), random order", gEntityCount, [&]()
+    {
+        Phase phase;
+        float sum = 0.f;
+        for (Handle<Entity> & handle : shuffled)
+        {
+            sum += handle.get(phase)->get<Position>().x;
+        }
+        doNotOptimize(sum);
+    });
+
+    measure("erase(), random order", gEntityCount, [&]()
+    {
+        Phase phase;
+        for (Handle<Entity> & handle : shuffled)
+        {
+            handle.get(phase)->erase();
+        }
+    });
+
+    measure("addEntity(), reusing freed handles", gEntityCount, [&]()
+    {
+        for (std::size_t i = 0; i != gEntityCount; ++i)
+        {
+            handles[i] = world.addEntity();
+        }
+    });
+}
+
+
+void runIterationBenchmarks()
+{
+    // Simulates a mass despawn: only one entity in ten is still alive.
+    constexpr std::size_t liveCount = gEntityCount / 10;
+    std::cout << "== Iteration (" << liveCount << " live entities out of " << gEntityCount << ")\n";
+
+    EntityManager world;
+    {
+        std::vector<Handle<Entity>> handles = world.addEntities(gEntityCount);
+        Phase phase;
+        for (std::size_t i = 0; i != gEntityCount; ++i)
+        {
+            if (i % 10 == 0)
+            {
+                handles[i].get(phase)->add(Position{1.f, 2.f, 3.f});
+            }
+            else
+            {
+                handles[i].get(phase)->erase();
+            }
+        }
+    }
+
+    measure("forEachHandle(), generating names", liveCount, [&]()
+    {
+        std::size_t sum = 0;
+        world.forEachHandle([&](Handle<Entity> aHandle, const char *){ sum += aHandle.id(); });
+        doNotOptimize(sum);
+    });
+
+    measure("forEachHandle()", liveCount, [&]()
+    {
+        std::size_t sum = 0;
+        world.forEachHandle([&](Handle<Entity> aHandle, const char *){ sum += aHandle.id(); });
+        doNotOptimize(sum);
+    });
+
+    measure("forEachHandleInStorageOrder()", liveCount, [&]()
+    {
+        std::size_t sum = 0;
+        world.forEachHandleInStorageOrder([&](Handle<Entity> aHandle){ sum += aHandle.id(); });
+        doNotOptimize(sum);
+    });
+
+    measure("forEachHandleParallel(), 4 threads", liveCount, [&]()
+    {
+        std::atomic<std::size_t> sum = 0;
+        world.forEachHandleParallel([&](Handle<Entity> aHandle)
+            {
+                sum.fetch_add(aHandle.id(), std::memory_order_relaxed);
+            },
+            4);
+        doNotOptimize(sum);
+    });
+}
+
+
+void runReuseBenchmarks()
+{
+    std::cout << "== Handle reuse policies (" << gEntityCount << " entities)\n";
+
+    constexpr std::pair<HandleReuse, const char *> policies[] = {
+        {HandleReuse::Fifo, "Fifo"},
+        {HandleReuse::Lifo, "Lifo"},
+        {HandleReuse::LowestIndex, "LowestIndex"},
+    };
+
+    // Steady churn: a tenth of the entities is erased in random order then re-created, repeatedly.
+    constexpr std::size_t churnCount = gEntityCount / 10;
+    constexpr std::size_t churnRounds = 10;
+    for (auto [policy, policyName] : policies)
+    {
+        EntityManager world{policy};
+        std::vector<Handle<Entity>> handles = world.addEntities(gEntityCount);
+        // The erased entities of each round are drawn up-front, so the drawing is not measured.
+        std::vector<std::size_t> indices(gEntityCount);
+        std::iota(indices.begin(), indices.end(), 0);
+        std::vector<std::vector<std::size_t>> victims;
+        std::mt19937 random{42};
+        for (std::size_t round = 0; round != churnRounds; ++round)
+        {
+            std::shuffle(indices.begin(), indices.end(), random);
+            victims.emplace_back(indices.begin(), indices.begin() + churnCount);
+        }
+
+        measure((std::string{"churn (erase() + addEntity()), "} + policyName).c_str(),
+                churnCount * churnRounds,
+                [&]()
+        {
+            for (const std::vector<std::size_t> & roundVictims : victims)
+            {
+                {
+                    Phase phase;
+                    for (std::size_t victim : roundVictims)
+                    {
+                        handles[victim].get(phase)->erase();
+                    }
+                }
+                for (std::size_t victim : roundVictims)
+                {
+                    handles[victim] = world.addEntity();
+                }
+            }
+        });
+    }
+
+    // Wave despawn: the most recent entities are erased in random order,
+    // then a few are re-created and the manager is shrunk.
+    // The traversal cost is linear in the registry size left by shrinkToFit().
+    constexpr std::size_t survivorCount = gEntityCount / 10;
+    constexpr std::size_t respawnCount = gEntityCount / 20;
+    for (auto [policy, policyName] : policies)
+    {
+        EntityManager world{policy};
+        std::vector<Handle<Entity>> handles = world.addEntities(gEntityCount);
+        std::shuffle(handles.begin() + survivorCount, handles.end(), std::mt19937{42});
+        {
+            Phase phase;
+            for (std::size_t i = survivorCount; i != gEntityCount; ++i)
+            {
+                handles[i].get(phase)->erase();
+            }
+        }
+        for (std::size_t i = 0; i != respawnCount; ++i)
+        {
+            world.addEntity();
+        }
+        world.shrinkToFit();
+        // Generates the names of the entities, which is not measured.
+        world.forEachHandle([](Handle<Entity>, const char *){});
+
+        measure((std::string{"forEachHandle() after despawn and shrinkToFit(), "} + policyName).c_str(),
+                survivorCount + respawnCount,
+                [&]()
+        {
+            std::size_t sum = 0;
+            world.forEachHandle([&](Handle<Entity> aHandle, const char *){ sum += aHandle.id(); });
+            doNotOptimize(sum);
+        });
+    }
+}
+
+
+} // namespace bench
+} // namespace ent
+} // namespace ad
@@ -0,0 +1,83 @@
+#include "Benchmark.h"
+
+#include <entity/Entity.h>
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+
+namespace ad {
+namespace ent {
+namespace bench {
+
+
+namespace {
+
+    template <int N_tag>
+    struct Field
+    {
+        float value[4];
+    };
+
+    using C0 = Field<0>;
+    using C1 = Field<1>;
+    using C2 = Field<2>;
+    using C3 = Field<3>;
+    using C4 = Field<4>;
+    using C5 = Field<5>;
+
+    constexpr std::size_t gEntityCount = 200'000;
+
+} // anonymous namespace
+
+
+void runSpawnBenchmarks()
+{
+    std::cout << "== Spawn, 6 components (" << gEntityCount << " entities)\n";
+
+    {
+        EntityManager world;
+        Query<C0, C5> query{world};
+        measure("addEntity() then 6 add() (with Phase)", gEntityCount, [&]()
+        {
+            Phase phase;
+            for (std::size_t i = 0; i != gEntityCount; ++i)
+            {
+                world.addEntity().get(phase)->add(C0{}).add(C1{}).add(C2{})
+                                             .add(C3{}).add(C4{}).add(C5{});
+            }
+        });
+        doNotOptimize(query.countMatches());
+    }
+
+    {
+        EntityManager world;
+        Query<C0, C5> query{world};
+        measure("spawn(Phase, 6 components)", gEntityCount, [&]()
+        {
+            Phase phase;
+            for (std::size_t i = 0; i != gEntityCount; ++i)
+            {
+                world.spawn(phase, C0{}, C1{}, C2{}, C3{}, C4{}, C5{});
+            }
+        });
+        doNotOptimize(query.countMatches());
+    }
+
+    {
+        EntityManager world;
+        Query<C0, C5> query{world};
+        measure("spawn(6 components)", gEntityCount, [&]()
+        {
+            for (std::size_t i = 0; i != gEntityCount; ++i)
+            {
+                world.spawn(C0{}, C1{}, C2{}, C3{}, C4{}, C5{});
+            }
+        });
+        doNotOptimize(query.countMatches());
+    }
+}
+
+
+} // namespace bench
+} // namespace ent
+} // namespace ad
@@ -0,0 +1,29 @@
+namespace ad {
+namespace ent {
+namespace bench {
+
+void runConcurrentBenchmarks();
+void runHandleBenchmarks();
+void runIterationBenchmarks();
+void runRegistryBenchmarks();
+void runReuseBenchmarks();
+void runSpawnBenchmarks();
+
+} // namespace bench
+} // namespace ent
+} // namespace ad
+
+
+int main()
+{
+    using namespace ad::ent::bench;
+
+    runRegistryBenchmarks();
+    runReuseBenchmarks();
+    runIterationBenchmarks();
+    runHandleBenchmarks();
+    runSpawnBenchmarks();
+    runConcurrentBenchmarks();
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+#include "Inspector.h"
+
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <cstdint>
+#include <tuple>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+namespace {
+
+    struct Narrow
+    {
+        float f;
+    };
+
+    struct Chunked
+    {
+        int i;
+    };
+
+    struct Point
+    {
+        float x{0.f};
+        float y{0.f};
+    };
+
+    bool isAligned(const void * aPointer, std::size_t aAlignment)
+    {
+        return reinterpret_cast<std::uintptr_t>(aPointer) % aAlignment == 0;
+    }
+
+} // anonymous namespace
+
+
+template <>
+struct ad::ent::ColumnAlignment<Narrow> : std::integral_constant<std::size_t, 128>
+{};
+
+template <>
+struct ad::ent::UseChunkedStorage<Chunked> : std::true_type
+{};
+
+template <>
+struct ad::ent::SoaFields<Point>
+{
+    static constexpr auto gFields = std::make_tuple(&Point::x, &Point::y);
+};
+
+
+SCENARIO("Component columns are aligned and padded.")
+{
+    GIVEN("An allocator aligned to 64 bytes.")
+    {
+        using Allocator_t = detail::AlignedAllocator<float, 64>;
+
+        THEN("The allocated sizes are padded to a multiple of the alignment.")
+        {
+            CHECK(Allocator_t::getPaddedBytes(1) == 64);
+            CHECK(Allocator_t::getPaddedBytes(16) == 64);
+            CHECK(Allocator_t::getPaddedBytes(17) == 128);
+            CHECK(detail::AlignedAllocator<std::max_align_t, 1>::gAlignment == alignof(std::max_align_t));
+        }
+    }
+
+    GIVEN("An entity manager with entities of diverse components.")
+    {
+        EntityManager world;
+        for (int i = 0; i != 3; ++i)
+        {
+            world.spawn(ComponentA{(double)i}, Narrow{(float)i}, Chunked{i}, Point{(float)i, 0.f});
+        }
+        Archetype & archetype =
+            Inspector<EntityManager>::getArchetypeHandle<ComponentA, Narrow, Chunked, Point>(world).get();
+
+        THEN("The columns are aligned to a cache line by default.")
+        {
+            Storage<ComponentA> & storage = archetype.getStorage(archetype.getStoreIndex<ComponentA>());
+            CHECK(isAligned(storage.mArray.data(), gDefaultColumnAlignment));
+        }
+
+        THEN("The alignment can be overridden per component type.")
+        {
+            Storage<Narrow> & storage = archetype.getStorage(archetype.getStoreIndex<Narrow>());
+            CHECK(isAligned(storage.mArray.data(), 128));
+        }
+
+        THEN("The chunks of chunked storages, and each field of the struct of arrays storages, are aligned.")
+        {
+            Storage<Chunked> & chunked = archetype.getStorage(archetype.getStoreIndex<Chunked>());
+            CHECK(isAligned(chunked.mArray.chunk(0).data(), gDefaultColumnAlignment));
+
+            Query<Point>{world}.eachBatch([](SoaSpan<Point> aPoints)
+                    {
+                        CHECK(isAligned(aPoints.get<&Point::x>().data(), gDefaultColumnAlignment));
+                        CHECK(isAligned(aPoints.get<&Point::y>().data(), gDefaultColumnAlignment));
+                    });
+        }
+    }
+}
@@ -0,0 +1,189 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+#include "Inspector.h"
+
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <vector>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+SCENARIO("Empty archetypes are reclaimed on demand.")
+{
+    GIVEN("An entity manager where an entity visited a transient archetype.")
+    {
+        EntityManager world;
+        Query<ComponentA> queryA{world};
+
+        Handle<Entity> moved = world.spawn(ComponentA{1.});
+        world.spawn(ComponentA{2.});
+        {
+            Phase phase;
+            moved.get(phase)->add(ComponentB{"b"});
+        }
+        {
+            Phase phase;
+            moved.get(phase)->remove<ComponentB>();
+        }
+
+        // The empty archetype, {A} and {A, B}.
+        REQUIRE(Inspector<EntityManager>::countArchetypes(world) == 3);
+        REQUIRE(Inspector<EntityManager>::countMatchedArchetypes<ComponentA>(world) == 2);
+
+        WHEN("The empty archetypes are reclaimed.")
+        {
+            CHECK(world.reclaimEmptyArchetypes() == 1);
+
+            THEN("The transient archetype is destroyed, and removed from the queries.")
+            {
+                CHECK(Inspector<EntityManager>::countArchetypes(world) == 2);
+                CHECK(Inspector<EntityManager>::countMatchedArchetypes<ComponentA>(world) == 1);
+
+                double sum = 0.;
+                queryA.each([&sum](ComponentA & aA)
+                        {
+                            sum += aA.d;
+                        });
+                CHECK(queryA.countMatches() == 2);
+                CHECK(sum == 3.);
+            }
+
+            THEN("There is nothing more to reclaim.")
+            {
+                CHECK(world.reclaimEmptyArchetypes() == 0);
+            }
+
+            WHEN("An entity matches the destroyed archetype again.")
+            {
+                {
+                    Phase phase;
+                    moved.get(phase)->add(ComponentB{"c"});
+                }
+
+                THEN("The archetype is recreated, and matched by the queries.")
+                {
+                    CHECK(Inspector<EntityManager>::countArchetypes(world) == 3);
+                    CHECK(Inspector<EntityManager>::countMatchedArchetypes<ComponentA>(world) == 2);
+                    CHECK(queryA.countMatches() == 2);
+                    CHECK(Query<ComponentA, ComponentB>{world}.countMatches() == 1);
+                    CHECK(moved.get()->get<ComponentB>().str == "c");
+                    CHECK(moved.get()->get<ComponentA>().d == 1.);
+                }
+            }
+
+            WHEN("The state is saved, then restored after the archetype is recreated.")
+            {
+                State saved = world.saveState();
+                {
+                    Phase phase;
+                    moved.get(phase)->add(ComponentB{"c"});
+                }
+                REQUIRE(Inspector<EntityManager>::countArchetypes(world) == 3);
+                world.restoreState(saved);
+
+                THEN("The destroyed archetype is still absent.")
+                {
+                    CHECK(Inspector<EntityManager>::countArchetypes(world) == 2);
+                    CHECK_FALSE(moved.get()->has<ComponentB>());
+                    CHECK(Query<ComponentA, ComponentB>{world}.countMatches() == 0);
+                }
+            }
+        }
+
+        WHEN("All the entities are erased, then the empty archetypes reclaimed.")
+        {
+            std::vector<Handle<Entity>> handles;
+            world.forEachHandle([&handles](Handle<Entity> aHandle, const char *)
+                    {
+                        handles.push_back(aHandle);
+                    });
+            world.eraseAll(handles);
+            CHECK(world.reclaimEmptyArchetypes() == 2);
+
+            THEN("The archetype without components remains.")
+            {
+                CHECK(Inspector<EntityManager>::countArchetypes(world) == 1);
+                Handle<Entity> added = world.addEntity();
+                CHECK(added.isValid());
+            }
+        }
+    }
+}
+
+
+SCENARIO("Empty archetypes are reclaimed at the end of phases.")
+{
+    GIVEN("An entity manager reclaiming at the end of phases.")
+    {
+        EntityManager world;
+        world.setReclaimPolicy(ReclaimPolicy{.mMode = ReclaimPolicy::Mode::PhaseEnd});
+
+        Handle<Entity> moved = world.spawn(ComponentA{1.});
+        REQUIRE(Inspector<EntityManager>::countArchetypes(world) == 2);
+
+        WHEN("An entity leaves its archetype during a phase.")
+        {
+            {
+                Phase phase;
+                moved.get(phase)->add(ComponentB{"b"});
+                REQUIRE(Inspector<EntityManager>::countArchetypes(world) == 2);
+            }
+
+            THEN("The emptied archetype is destroyed when the phase ends.")
+            {
+                CHECK(Inspector<EntityManager>::countArchetypes(world) == 2);
+                CHECK(Inspector<EntityManager>::countMatchedArchetypes<ComponentA>(world) == 1);
+                CHECK(Query<ComponentA>{world}.countMatches() == 1);
+                CHECK(moved.get()->get<ComponentB>().str == "b");
+            }
+        }
+    }
+
+    GIVEN("An entity manager reclaiming the archetypes empty for two phases.")
+    {
+        EntityManager world;
+        world.setReclaimPolicy(ReclaimPolicy{
+            .mMode = ReclaimPolicy::Mode::PhaseEnd,
+            .mMinimumAge = 2,
+        });
+
+        Handle<Entity> moved = world.spawn(ComponentA{1.});
+
+        WHEN("An entity oscillates between two archetypes.")
+        {
+            {
+                Phase phase;
+                moved.get(phase)->add(ComponentB{"b"});
+            }
+            {
+                Phase phase;
+                moved.get(phase)->remove<ComponentB>();
+            }
+
+            THEN("Both archetypes are kept.")
+            {
+                CHECK(Inspector<EntityManager>::countArchetypes(world) == 3);
+            }
+
+            WHEN("A further phase ends.")
+            {
+                {
+                    Phase phase;
+                    moved.get(phase)->get<ComponentA>().d = 2.;
+                }
+
+                THEN("The archetype empty for two phases is destroyed.")
+                {
+                    CHECK(Inspector<EntityManager>::countArchetypes(world) == 2);
+                    CHECK(Inspector<EntityManager>::countMatchedArchetypes<ComponentA>(world) == 1);
+                    CHECK(moved.get()->get<ComponentA>().d == 2.);
+                }
+            }
+        }
+    }
+}
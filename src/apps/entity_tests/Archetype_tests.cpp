@@ -1,6 +1,7 @@
 #include "catch.hpp"
 
 #include "Components_helpers.h" 
+#include "Inspector.h"
 
 #include <entity/Entity.h>
 #include <entity/Query.h>
@@ -10,6 +11,22 @@ using namespace ad;
 using namespace ad::ent;
 
 
+namespace {
+
+    struct ChunkedComponent
+    {
+        std::string str;
+        int i;
+    };
+
+} // anonymous namespace
+
+
+template <>
+struct ad::ent::UseChunkedStorage<ChunkedComponent> : std::true_type
+{};
+
+
 SCENARIO("Stunfest23 bug#2: Entity's position into an archetype, stored in the EntityRecord,"
          " should match the position of the corresponding handle in said Archetype.")
 {
@@ -131,4 +148,324 @@ SCENARIO("Stunfest23 bug#1.")
             }
         }
     }
-}
\ No newline at end of file
+}
+
+SCENARIO("Chunked component storages.")
+{
+    GIVEN("An entity manager with an entity containing components A and a chunked component.")
+    {
+        EntityManager world;
+        Handle<Entity> first = world.spawn(ComponentA{0.}, ChunkedComponent{"first", 0});
+        ChunkedComponent * firstAddress = &first.get()->get<ChunkedComponent>();
+
+        WHEN("Many entities are added to the same archetype.")
+        {
+            constexpr int count = 5000;
+            std::vector<Handle<Entity>> handles;
+            for (int i = 1; i != count; ++i)
+            {
+                handles.push_back(world.spawn(ComponentA{(double)i}, ChunkedComponent{std::to_string(i), i}));
+            }
+
+            THEN("The chunked component of the first entity did not move.")
+            {
+                CHECK(&first.get()->get<ChunkedComponent>() == firstAddress);
+                CHECK(first.get()->get<ChunkedComponent>().str == "first");
+            }
+
+            THEN("The query visits all the components.")
+            {
+                Query<ComponentA, ChunkedComponent> query{world};
+                CHECK(query.verifyArchetypes());
+                int visited = 0;
+                query.each([&](ComponentA & a, ChunkedComponent & c)
+                        {
+                            CHECK(a.d == (double)c.i);
+                            ++visited;
+                        });
+                CHECK(visited == count);
+            }
+
+            WHEN("Entities are erased, and others change archetype.")
+            {
+                std::vector<Handle<Entity>> erased{handles.begin(), handles.begin() + 1000};
+                world.eraseAll(erased);
+                {
+                    Phase phase;
+                    handles[2000].get(phase)->erase();
+                    handles[3000].get(phase)->remove<ComponentA>();
+                }
+
+                THEN("The remaining entities keep their values.")
+                {
+                    Query<ChunkedComponent> query{world};
+                    CHECK(query.verifyArchetypes());
+                    CHECK(query.countMatches() == count - 1001);
+                    for (std::size_t i = 1000; i != handles.size(); ++i)
+                    {
+                        if (i != 2000)
+                        {
+                            CHECK(handles[i].get()->get<ChunkedComponent>().str == std::to_string(i + 1));
+                        }
+                    }
+                }
+
+                THEN("The state can be saved and restored.")
+                {
+                    State state = world.saveState();
+                    {
+                        Phase phase;
+                        first.get(phase)->erase();
+                    }
+                    world.restoreState(state);
+                    CHECK(first.get()->get<ChunkedComponent>().str == "first");
+                    CHECK(Query<ChunkedComponent>{world}.countMatches() == count - 1001);
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO("Storages are driven by the metadata of their component type.")
+{
+    GIVEN("Storages of a trivially copyable component and of a non-trivial component.")
+    {
+        std::unique_ptr<StorageBase> storageA = std::make_unique<Storage<ComponentA>>();
+        std::unique_ptr<StorageBase> storageB = std::make_unique<Storage<ComponentB>>();
+
+        THEN("Their metadata describes the component types.")
+        {
+            CHECK(&storageA->getMetadata() == &Storage<ComponentA>::GetMetadata());
+            CHECK(storageA->getType() == getId<ComponentA>());
+            CHECK(storageB->getType() == getId<ComponentB>());
+        }
+
+        WHEN("Several components are moved to an empty clone of the storage.")
+        {
+            for (int i = 0; i != 5; ++i)
+            {
+                storageB->as<ComponentB>().mArray.push_back(ComponentB{std::to_string(i)});
+            }
+            std::unique_ptr<StorageBase> destination = storageB->cloneEmpty();
+            for (EntityIndex index : {4, 1, 2})
+            {
+                destination->moveFrom(index, *storageB);
+            }
+
+            THEN("They are pushed in order.")
+            {
+                REQUIRE(destination->size() == 3);
+                CHECK(destination->get<ComponentB>(0).str == "4");
+                CHECK(destination->get<ComponentB>(1).str == "1");
+                CHECK(destination->get<ComponentB>(2).str == "2");
+            }
+
+            THEN("Removing from the source moves the last component over the removed one.")
+            {
+                storageB->remove(1);
+                REQUIRE(storageB->size() == 4);
+                CHECK(storageB->get<ComponentB>(0).str == "0");
+                CHECK(storageB->get<ComponentB>(3).str == "3");
+            }
+        }
+    }
+}
+
+
+SCENARIO("Archetypes cache the transitions taken from them.")
+{
+    GIVEN("An entity manager with an entity with component (A).")
+    {
+        EntityManager world;
+        Handle<Entity> h1 = world.spawn(ComponentA{1.});
+        Archetype & archetypeA = Inspector<EntityManager>::getArchetypeHandle<ComponentA>(world).get();
+
+        THEN("No transition is cached yet.")
+        {
+            CHECK(archetypeA.findEdge(Archetype::Transition::Add, getId<ComponentB>()) == nullptr);
+        }
+
+        WHEN("Component (B) is added to the entity.")
+        {
+            {
+                Phase phase;
+                h1.get(phase)->add(ComponentB{"b1"});
+            }
+            Archetype & archetypeAB =
+                Inspector<EntityManager>::getArchetypeHandle<ComponentA, ComponentB>(world).get();
+
+            THEN("The edge to archetype (A, B) is cached, with the column mapping.")
+            {
+                const ArchetypeEdge * edge = archetypeA.findEdge(Archetype::Transition::Add, getId<ComponentB>());
+                REQUIRE(edge != nullptr);
+                CHECK(&Inspector<EntityManager>::getArchetype(world, edge->mDestination) == &archetypeAB);
+                REQUIRE(edge->mColumnMapping.size() == 1);
+                CHECK(edge->mColumnMapping[0] == archetypeAB.getStoreIndex<ComponentA>());
+            }
+
+            THEN("The reverse edge is cached as well.")
+            {
+                const ArchetypeEdge * edge = archetypeAB.findEdge(Archetype::Transition::Remove, getId<ComponentB>());
+                REQUIRE(edge != nullptr);
+                CHECK(&Inspector<EntityManager>::getArchetype(world, edge->mDestination) == &archetypeA);
+                REQUIRE(edge->mColumnMapping.size() == 2);
+                CHECK(edge->mColumnMapping[archetypeAB.getStoreIndex<ComponentA>()] == 0);
+                CHECK(edge->mColumnMapping[archetypeAB.getStoreIndex<ComponentB>()] == ArchetypeEdge::gNoColumn);
+            }
+
+            WHEN("Other entities go back and forth along the edges.")
+            {
+                const std::size_t archetypeCount = Inspector<EntityManager>::countArchetypes(world);
+                Handle<Entity> h2 = world.spawn(ComponentA{2.});
+                for (int i = 0; i != 3; ++i)
+                {
+                    {
+                        Phase phase;
+                        h2.get(phase)->add(ComponentB{"b2"});
+                    }
+                    {
+                        Phase phase;
+                        h1.get(phase)->remove<ComponentB>();
+                    }
+                    {
+                        Phase phase;
+                        h1.get(phase)->add(ComponentB{"b1"});
+                        h2.get(phase)->remove<ComponentB>();
+                    }
+                }
+
+                THEN("No archetype is created, and the components are preserved.")
+                {
+                    CHECK(Inspector<EntityManager>::countArchetypes(world) == archetypeCount);
+                    CHECK(archetypeAB.countEntities() == 1);
+                    CHECK(archetypeA.countEntities() == 1);
+                    CHECK(h1.get()->get<ComponentA>().d == 1.);
+                    CHECK(h1.get()->get<ComponentB>().str == "b1");
+                    CHECK(h2.get()->get<ComponentA>().d == 2.);
+                    CHECK_FALSE(h2.get()->has<ComponentB>());
+                    CHECK(archetypeA.verifyHandlesConsistency(world));
+                    CHECK(archetypeAB.verifyHandlesConsistency(world));
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO("Archetype capacity can be reserved and given back.")
+{
+    GIVEN("An entity manager where capacity is reserved for 1000 entities with components (A, B).")
+    {
+        EntityManager world;
+        world.reserve<ComponentA, ComponentB>(1000);
+        Archetype & archetypeAB =
+            Inspector<EntityManager>::getArchetypeHandle<ComponentA, ComponentB>(world).get();
+
+        THEN("The archetype exists, with the reserved capacity for handles and stores.")
+        {
+            CHECK(archetypeAB.countEntities() == 0);
+            CHECK(archetypeAB.capacity() >= 1000);
+            CHECK(archetypeAB.getStorage(archetypeAB.getStoreIndex<ComponentB>()).capacity() >= 1000);
+        }
+
+        WHEN("1000 entities are spawned, then 900 are erased.")
+        {
+            const std::size_t capacity = archetypeAB.capacity();
+            std::vector<Handle<Entity>> handles;
+            for (int i = 0; i != 1000; ++i)
+            {
+                handles.push_back(world.spawn(ComponentA{(double)i}, ComponentB{std::to_string(i)}));
+            }
+            REQUIRE(archetypeAB.capacity() == capacity);
+            world.eraseAll(std::span{handles}.subspan(100));
+
+            THEN("The capacity is kept by default, and the high-water mark is reported.")
+            {
+                CHECK(archetypeAB.capacity() == capacity);
+                std::vector<ArchetypeStatistics> statistics = world.getArchetypeStatistics();
+                auto found = std::find_if(statistics.begin(), statistics.end(),
+                                          [](const ArchetypeStatistics & aStatistics)
+                                          {
+                                              return aStatistics.mTypeSet == getTypeSet<ComponentA, ComponentB>();
+                                          });
+                REQUIRE(found != statistics.end());
+                CHECK(found->mEntityCount == 100);
+                CHECK(found->mCapacity == capacity);
+                CHECK(found->mHighWaterMark == 1000);
+            }
+
+            WHEN("The entity manager is shrunk.")
+            {
+                world.shrinkToFit();
+
+                THEN("The archetype capacity matches its entities, which are preserved.")
+                {
+                    CHECK(archetypeAB.capacity() == 100);
+                    CHECK(archetypeAB.getStorage(archetypeAB.getStoreIndex<ComponentB>()).capacity() == 100);
+                    CHECK(handles[42].get()->get<ComponentB>().str == "42");
+                    CHECK(archetypeAB.getHighWaterMark() == 1000);
+                }
+            }
+        }
+
+        WHEN("The hysteresis shrink policy is set, and entities are erased one by one.")
+        {
+            world.setShrinkPolicy(ShrinkPolicy{
+                .mMode = ShrinkPolicy::Mode::Hysteresis,
+                .mTrimRatio = 4,
+                .mMinimumCapacity = 16,
+            });
+            std::vector<Handle<Entity>> handles;
+            for (int i = 0; i != 1000; ++i)
+            {
+                handles.push_back(world.spawn(ComponentA{(double)i}, ComponentB{}));
+            }
+            for (std::size_t i = 0; i != 800; ++i)
+            {
+                Phase phase;
+                handles[i].get(phase)->erase();
+            }
+
+            THEN("The capacity is trimmed once it is four times the count of entities.")
+            {
+                // Trimmed to 500 when 250 entities remained.
+                CHECK(archetypeAB.countEntities() == 200);
+                CHECK(archetypeAB.capacity() == 500);
+                CHECK(handles[999].get()->get<ComponentA>().d == 999.);
+            }
+        }
+    }
+}
+
+
+SCENARIO("Capacity can be reserved for the entities created from a blueprint.")
+{
+    GIVEN("A blueprint with component (A).")
+    {
+        EntityManager world;
+        Handle<Entity> blueprint = world.addBlueprint();
+        {
+            Phase phase;
+            blueprint.get(phase)->add(ComponentA{3.});
+        }
+
+        WHEN("Capacity is reserved for 500 entities created from the blueprint.")
+        {
+            world.reserveFromBlueprint(blueprint, 500);
+            Archetype & archetypeA = Inspector<EntityManager>::getArchetypeHandle<ComponentA>(world).get();
+            const std::size_t capacity = archetypeA.capacity();
+
+            THEN("Creating them does not reallocate.")
+            {
+                CHECK(capacity >= 500);
+                for (int i = 0; i != 500; ++i)
+                {
+                    world.createFromBlueprint(blueprint, nullptr);
+                }
+                CHECK(archetypeA.capacity() == capacity);
+                CHECK(archetypeA.countEntities() == 500);
+            }
+        }
+    }
+}
@@ -44,6 +44,7 @@ SCENARIO("Creating a entity from a blueprint")
                     CHECK(h2.isValid());
                     CHECK(h2.get()->get<ComponentA>().d == 1.0f);
                     CHECK(h2.get()->has<Blueprint>() == false);
+                    CHECK(q.verifyArchetypes());
                 }
             }
         }
@@ -0,0 +1,117 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+
+#include <entity/CompactHandle.h>
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <unordered_map>
+#include <unordered_set>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+namespace {
+
+    struct Targets
+    {
+        std::vector<CompactHandle> handles;
+    };
+
+} // anonymous namespace
+
+
+SCENARIO("Compact handles reference entities relatively to their manager.")
+{
+    GIVEN("An entity manager with two entities.")
+    {
+        EntityManager world;
+        Handle<Entity> h1 = world.addEntity();
+        Handle<Entity> h2 = world.addEntity();
+        {
+            Phase phase;
+            h1.get(phase)->add(ComponentA{1.});
+        }
+
+        WHEN("Compact handles are made from the handles.")
+        {
+            CompactHandle c1 = h1;
+            CompactHandle c2 = h2;
+
+            THEN("They resolve to the original handles.")
+            {
+                CHECK(c1.isValid(world));
+                CHECK(c1.resolve(world) == h1);
+                CHECK(c1.id() == h1.id());
+                CHECK(c1.resolve(world).get()->get<ComponentA>().d == 1.);
+                CHECK(c2.resolve(world) == h2);
+            }
+
+            THEN("They compare like the handles.")
+            {
+                CHECK(c1 == CompactHandle{h1});
+                CHECK_FALSE(c1 == c2);
+            }
+
+            WHEN("An entity is erased and its index is re-used.")
+            {
+                {
+                    Phase phase;
+                    h1.get(phase)->erase();
+                }
+                Handle<Entity> h3 = world.addEntity();
+                REQUIRE(h3.id() == h1.id());
+
+                THEN("The compact handle is not valid anymore.")
+                {
+                    CHECK_FALSE(c1.isValid(world));
+                    CHECK_FALSE(c1.resolve(world).isValid());
+                    CHECK_FALSE(c1 == CompactHandle{h3});
+                }
+            }
+        }
+
+        THEN("A default constructed compact handle is never valid.")
+        {
+            CompactHandle defaulted;
+            CHECK_FALSE(defaulted.isValid(world));
+            CHECK(defaulted == CompactHandle{Handle<Entity>{}});
+        }
+
+        WHEN("Compact handles are stored in a component.")
+        {
+            Handle<Entity> holder = world.addEntity();
+            {
+                Phase phase;
+                holder.get(phase)->add(Targets{{h1, h2}});
+            }
+
+            THEN("They can be resolved from a query.")
+            {
+                Query<Targets> query{world};
+                std::size_t resolved = 0;
+                query.each([&](Targets & aTargets)
+                {
+                    for (CompactHandle target : aTargets.handles)
+                    {
+                        resolved += target.isValid(world);
+                    }
+                });
+                CHECK(resolved == 2);
+            }
+        }
+
+        THEN("Compact handles can be used in hash containers.")
+        {
+            std::unordered_set<CompactHandle> set{h1, h2, h1};
+            CHECK(set.size() == 2);
+            CHECK(set.contains(h2));
+
+            std::unordered_map<CompactHandle, int> map{{h1, 1}, {h2, 2}};
+            CHECK(map.at(h2) == 2);
+        }
+    }
+}
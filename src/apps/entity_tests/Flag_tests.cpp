@@ -0,0 +1,173 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+#include "Inspector.h"
+
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <set>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+namespace {
+
+    std::set<double> visitValues(Query<ComponentA> & aQuery, const FlagFilter & aFilter)
+    {
+        std::set<double> result;
+        aQuery.each(aFilter, [&result](ComponentA & a)
+                {
+                    result.insert(a.d);
+                });
+        return result;
+    }
+
+} // anonymous namespace
+
+
+SCENARIO("Flags are set per entity without migration.")
+{
+    GIVEN("An entity manager with two registered flags, and 150 entities with component (A).")
+    {
+        EntityManager world;
+        Flag disabled = world.registerFlag();
+        Flag visible = world.registerFlag();
+        REQUIRE(disabled != visible);
+
+        std::vector<Handle<Entity>> handles;
+        for (int i = 0; i != 150; ++i)
+        {
+            handles.push_back(world.spawn(ComponentA{(double)i}));
+        }
+        Query<ComponentA> queryA{world};
+
+        THEN("The flags are initially unset.")
+        {
+            CHECK_FALSE(handles[0].get()->testFlag(disabled));
+            CHECK_FALSE(handles[149].get()->testFlag(visible));
+            CHECK(visitValues(queryA, FlagFilter{}).size() == 150);
+            CHECK(visitValues(queryA, FlagFilter{}.require(disabled)).empty());
+        }
+
+        WHEN("Flag disabled is set on entities spread over several words.")
+        {
+            const std::size_t archetypeCount = Inspector<EntityManager>::countArchetypes(world);
+            for (std::size_t i : {3, 64, 100, 149})
+            {
+                handles[i].get()->setFlag(disabled);
+            }
+
+            THEN("The entities stay in their archetype.")
+            {
+                CHECK(Inspector<EntityManager>::countArchetypes(world) == archetypeCount);
+                CHECK(Inspector<EntityManager>::getArchetypeHandle<ComponentA>(world).get().countEntities() == 150);
+                CHECK(handles[3].get()->testFlag(disabled));
+                CHECK_FALSE(handles[4].get()->testFlag(disabled));
+            }
+
+            THEN("Queries can filter on the flag.")
+            {
+                CHECK(visitValues(queryA, FlagFilter{}.require(disabled)) == std::set<double>{3., 64., 100., 149.});
+                CHECK(visitValues(queryA, FlagFilter{}.exclude(disabled)).size() == 146);
+                CHECK(visitValues(queryA, FlagFilter{}.require(disabled).exclude(visible)).size() == 4);
+                CHECK(visitValues(queryA, FlagFilter{}.require(disabled).require(visible)).empty());
+            }
+
+            WHEN("A flagged entity changes archetype.")
+            {
+                {
+                    Phase phase;
+                    handles[64].get(phase)->add(ComponentB{"b"});
+                }
+
+                THEN("It keeps its flag, and the entity moved in its place keeps its own flags.")
+                {
+                    CHECK(handles[64].get()->testFlag(disabled));
+                    CHECK(handles[149].get()->testFlag(disabled));
+                    CHECK(visitValues(queryA, FlagFilter{}.require(disabled)) == std::set<double>{3., 64., 100., 149.});
+                    CHECK(Query<ComponentB>{world}.countMatches() == 1);
+                }
+            }
+
+            WHEN("Flagged and unflagged entities are erased.")
+            {
+                {
+                    Phase phase;
+                    handles[3].get(phase)->erase();
+                }
+                world.eraseAll(std::vector<Handle<Entity>>{handles[0], handles[100], handles[120]});
+
+                THEN("The remaining entities keep their flags.")
+                {
+                    CHECK(visitValues(queryA, FlagFilter{}.require(disabled)) == std::set<double>{64., 149.});
+                    CHECK(visitValues(queryA, FlagFilter{}.exclude(disabled)).size() == 144);
+                }
+
+                THEN("New entities start with the flags unset.")
+                {
+                    for (int i = 0; i != 4; ++i)
+                    {
+                        CHECK_FALSE(world.spawn(ComponentA{-1.}).get()->testFlag(disabled));
+                    }
+                    CHECK(visitValues(queryA, FlagFilter{}.require(disabled)) == std::set<double>{64., 149.});
+                }
+            }
+        }
+
+        WHEN("Flag disabled is set on a low index, then a tail range of entities is erased.")
+        {
+            handles[3].get()->setFlag(disabled);
+            // The new size ends in a word past the only allocated word of the column.
+            world.eraseAll(std::span<const Handle<Entity>>{handles}.subspan(80));
+
+            THEN("The remaining entities keep their flags.")
+            {
+                CHECK(visitValues(queryA, FlagFilter{}.require(disabled)) == std::set<double>{3.});
+                CHECK(visitValues(queryA, FlagFilter{}.exclude(disabled)).size() == 79);
+                CHECK_FALSE(world.spawn(ComponentA{-1.}).get()->testFlag(disabled));
+            }
+        }
+
+        WHEN("Flags are toggled while iterating the query.")
+        {
+            queryA.each([visible](Handle<Entity> aHandle, ComponentA & a)
+                    {
+                        aHandle.get()->setFlag(visible, (int)a.d % 2 == 0);
+                    });
+
+            THEN("The flags are set accordingly.")
+            {
+                CHECK(visitValues(queryA, FlagFilter{}.require(visible)).size() == 75);
+                CHECK(*visitValues(queryA, FlagFilter{}.exclude(visible)).begin() == 1.);
+            }
+        }
+    }
+}
+
+
+SCENARIO("The number of flags is bounded.")
+{
+    GIVEN("An entity manager.")
+    {
+        EntityManager world;
+
+        WHEN("The maximum number of flags is registered.")
+        {
+            for (std::size_t i = 0; i != gMaxFlags; ++i)
+            {
+                CHECK(world.registerFlag() == i);
+            }
+
+            THEN("No more flags can be registered.")
+            {
+                CHECK_THROWS_AS(world.registerFlag(), std::logic_error);
+            }
+        }
+    }
+}
@@ -4,12 +4,52 @@
 
 #include <entity/Entity.h>
 #include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <array>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
 
 
 using namespace ad;
 using namespace ad::ent;
 
 
+namespace {
+
+    // Move-only, and large enough that copying it would matter.
+    struct Buffer
+    {
+        Buffer(std::size_t aSize, int aValue) :
+            values(aSize, aValue)
+        {}
+
+        Buffer(const Buffer &) = delete;
+        Buffer & operator=(const Buffer &) = delete;
+
+        Buffer(Buffer && aRhs) noexcept :
+            values{std::move(aRhs.values)}
+        { ++gMoves; }
+
+        Buffer & operator=(Buffer && aRhs) noexcept
+        {
+            values = std::move(aRhs.values);
+            ++gMoves;
+            return *this;
+        }
+
+        std::array<int, 64> header{};
+        std::vector<int> values;
+
+        static inline int gMoves = 0;
+    };
+
+} // anonymous namespace
+
+
 SCENARIO("Handles provide a phase-less view access to Entities.")
 {
     GIVEN("An entity manager with an entity.")
@@ -82,6 +122,66 @@ SCENARIO("Handles are comparable")
 }
 
 
+SCENARIO("An entity can be copied over another entity.")
+{
+    GIVEN("An entity with component (A), and an entity with component (B) observed by queries.")
+    {
+        EntityManager world;
+        Handle<Entity> source = world.spawn(ComponentA{5.});
+        Handle<Entity> destination = world.spawn(ComponentB{"b"});
+        Handle<Entity> other = world.spawn(ComponentB{"other"});
+
+        Query<ComponentA> queryA{world};
+        Query<ComponentB> queryB{world};
+        std::vector<Handle<Entity>> added;
+        std::vector<Handle<Entity>> removed;
+        queryA.onAddEntity([&added](Handle<Entity> aHandle, ComponentA &)
+                {
+                    added.push_back(aHandle);
+                });
+        queryB.onRemoveEntity([&removed](Handle<Entity> aHandle, ComponentB &)
+                {
+                    removed.push_back(aHandle);
+                });
+
+        WHEN("The first entity is copied over the second.")
+        {
+            {
+                Phase phase;
+                source.get(phase)->copy(destination);
+            }
+
+            THEN("The destination has the components of the source instead of its own.")
+            {
+                CHECK(destination.get()->get<ComponentA>().d == 5.);
+                CHECK_FALSE(destination.get()->has<ComponentB>());
+                CHECK(source.get()->get<ComponentA>().d == 5.);
+                CHECK(source != destination);
+            }
+
+            THEN("The destination left its initial archetype.")
+            {
+                CHECK(queryA.countMatches() == 2);
+                CHECK(queryB.countMatches() == 1);
+                CHECK(other.get()->get<ComponentB>().str == "other");
+            }
+
+            THEN("The queries are notified.")
+            {
+                CHECK(added == std::vector<Handle<Entity>>{destination});
+                CHECK(removed == std::vector<Handle<Entity>>{destination});
+            }
+
+            THEN("The copy is an independent entity.")
+            {
+                destination.get()->get<ComponentA>().d = 6.;
+                CHECK(source.get()->get<ComponentA>().d == 5.);
+            }
+        }
+    }
+}
+
+
 SCENARIO("Handles allow to test the validity of the underlying Entity.")
 {
     GIVEN("An entity manager with an entity.")
@@ -185,4 +285,528 @@ SCENARIO("Handle re-use.")
             }
         }
     }
-}
\ No newline at end of file
+}
+
+SCENARIO("Handle re-use with many entities.")
+{
+    GIVEN("An entity manager with several entities.")
+    {
+        EntityManager world;
+        std::vector<Handle<Entity>> handles;
+        for (int i = 0; i != 8; ++i)
+        {
+            handles.push_back(world.addEntity());
+        }
+
+        WHEN("Some entities are erased.")
+        {
+            {
+                Phase scoped;
+                handles[5].get(scoped)->erase();
+                handles[1].get(scoped)->erase();
+                handles[3].get(scoped)->erase();
+            }
+
+            THEN("Only the erased handles are invalidated.")
+            {
+                CHECK(world.countLiveEntities() == 5);
+                for (std::size_t i = 0; i != handles.size(); ++i)
+                {
+                    CHECK(handles[i].isValid() == (i != 1 && i != 3 && i != 5));
+                }
+            }
+
+            WHEN("As many entities are added.")
+            {
+                Handle<Entity> r1 = world.addEntity();
+                Handle<Entity> r2 = world.addEntity();
+                Handle<Entity> r3 = world.addEntity();
+
+                THEN("The freed indices are re-used, in the order they were freed.")
+                {
+                    CHECK(r1.id() == handles[5].id());
+                    CHECK(r2.id() == handles[1].id());
+                    CHECK(r3.id() == handles[3].id());
+                }
+
+                THEN("The erased handles are still invalid.")
+                {
+                    CHECK(r1.isValid());
+                    CHECK(r2.isValid());
+                    CHECK(r3.isValid());
+                    CHECK_FALSE(handles[1].isValid());
+                    CHECK_FALSE(handles[3].isValid());
+                    CHECK_FALSE(handles[5].isValid());
+                    CHECK(world.countLiveEntities() == 8);
+                }
+
+                THEN("A new entity uses a new index.")
+                {
+                    Handle<Entity> h = world.addEntity();
+                    CHECK(h.id() == handles.size());
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO("Handle re-use policies.")
+{
+    GIVEN("Several entities, some of which are erased.")
+    {
+        HandleReuse reuse = GENERATE(HandleReuse::Fifo, HandleReuse::Lifo, HandleReuse::LowestIndex);
+        EntityManager world{reuse};
+        std::vector<Handle<Entity>> handles = world.addEntities(8);
+        {
+            Phase scoped;
+            handles[5].get(scoped)->erase();
+            handles[1].get(scoped)->erase();
+            handles[3].get(scoped)->erase();
+        }
+
+        WHEN("As many entities are added.")
+        {
+            std::vector<Handle<Entity>> reused;
+            for (int i = 0; i != 3; ++i)
+            {
+                reused.push_back(world.addEntity());
+            }
+
+            THEN("The freed indices are re-used in the order of the policy.")
+            {
+                std::vector<EntityIndex> expected;
+                switch (reuse)
+                {
+                    case HandleReuse::Fifo:
+                        expected = {5, 1, 3};
+                        break;
+                    case HandleReuse::Lifo:
+                        expected = {3, 1, 5};
+                        break;
+                    case HandleReuse::LowestIndex:
+                        expected = {1, 3, 5};
+                        break;
+                }
+                for (std::size_t i = 0; i != reused.size(); ++i)
+                {
+                    CHECK(reused[i].id() == handles[expected[i]].id());
+                    CHECK(reused[i].isValid());
+                }
+                CHECK_FALSE(handles[1].isValid());
+                CHECK_FALSE(handles[3].isValid());
+                CHECK_FALSE(handles[5].isValid());
+            }
+        }
+
+        WHEN("As many entities are created in a phase.")
+        {
+            std::vector<Handle<Entity>> reused;
+            {
+                Phase phase;
+                for (int i = 0; i != 3; ++i)
+                {
+                    reused.push_back(world.addEntity(phase));
+                }
+            }
+
+            THEN("The freed indices are re-used.")
+            {
+                std::set<EntityIndex> ids;
+                for (Handle<Entity> handle : reused)
+                {
+                    CHECK(handle.isValid());
+                    ids.insert(handle.id());
+                }
+                CHECK(ids == std::set<EntityIndex>{1, 3, 5});
+                CHECK(world.countLiveEntities() == 8);
+            }
+        }
+
+        WHEN("The state is saved and restored.")
+        {
+            State state = world.saveState();
+            world.restoreState(state);
+
+            THEN("The policy is preserved.")
+            {
+                Handle<Entity> h = world.addEntity();
+                CHECK(h.id() == (reuse == HandleReuse::Fifo ? 5 : reuse == HandleReuse::Lifo ? 3 : 1));
+            }
+        }
+    }
+}
+
+
+SCENARIO("Shrinking the entity manager after large despawns.")
+{
+    GIVEN("Many entities, where all but the first few are erased.")
+    {
+        HandleReuse reuse = GENERATE(HandleReuse::Fifo, HandleReuse::Lifo, HandleReuse::LowestIndex);
+        EntityManager world{reuse};
+        std::vector<Handle<Entity>> handles = world.addEntities(64);
+        {
+            Phase scoped;
+            for (std::size_t i = 2; i != handles.size(); ++i)
+            {
+                if (i != 4)
+                {
+                    handles[i].get(scoped)->erase();
+                }
+            }
+        }
+
+        WHEN("The manager is shrunk.")
+        {
+            world.shrinkToFit();
+
+            THEN("The live entities are unaffected.")
+            {
+                CHECK(world.countLiveEntities() == 3);
+                CHECK(handles[0].isValid());
+                CHECK(handles[1].isValid());
+                CHECK(handles[4].isValid());
+                CHECK(handles[4].name() == std::string{"Entity 4"});
+            }
+
+            THEN("The freed indices below the highest live index are still re-used first.")
+            {
+                Handle<Entity> h1 = world.addEntity();
+                Handle<Entity> h2 = world.addEntity();
+                Handle<Entity> h3 = world.addEntity();
+                CHECK(std::set<EntityIndex>{h1.id(), h2.id()} == std::set<EntityIndex>{2, 3});
+                CHECK(h3.id() == 5);
+            }
+
+            WHEN("The manager grows again.")
+            {
+                std::vector<Handle<Entity>> regrown = world.addEntities(64);
+                Handle<Entity> deferred;
+                {
+                    Phase phase;
+                    deferred = world.addEntity(phase);
+                }
+
+                THEN("The handles of the erased entities remain invalid.")
+                {
+                    for (std::size_t i = 2; i != handles.size(); ++i)
+                    {
+                        CHECK(handles[i].isValid() == (i == 4));
+                    }
+                    for (Handle<Entity> handle : regrown)
+                    {
+                        CHECK(handle.isValid());
+                    }
+                    CHECK(deferred.isValid());
+                    CHECK(deferred.id() == 67);
+                    CHECK(world.countLiveEntities() == 3 + 64 + 1);
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO("Handles give access to the entity name.")
+{
+    GIVEN("An entity manager with a named entity and an unnamed entity.")
+    {
+        EntityManager world;
+        Handle<Entity> named = world.addEntity("hero");
+        Handle<Entity> unnamed = world.addEntity();
+
+        {
+            Phase init;
+            named.get(init)->add<ComponentA>({1.});
+            unnamed.get(init)->add<ComponentB>({"b"});
+        }
+
+        THEN("The named entity has the provided name.")
+        {
+            CHECK(std::string{named.name()} == "hero");
+        }
+
+        THEN("The unnamed entity has a generated name.")
+        {
+            CHECK(std::string{unnamed.name()} == "Entity " + std::to_string(unnamed.id()));
+        }
+
+        THEN("The names are available while iterating the handles.")
+        {
+            std::size_t count = 0;
+            world.forEachHandle([&](Handle<Entity> aHandle, const char * aName)
+            {
+                CHECK(std::string{aName} == aHandle.name());
+                ++count;
+            });
+            CHECK(count == 2);
+        }
+
+        WHEN("The named entity is erased, and an unnamed entity re-uses its index.")
+        {
+            {
+                Phase phase;
+                named.get(phase)->erase();
+            }
+            Handle<Entity> reused = world.addEntity();
+            REQUIRE(reused.id() == named.id());
+
+            THEN("The new entity does not inherit the name.")
+            {
+                CHECK(std::string{reused.name()} == "Entity " + std::to_string(reused.id()));
+            }
+        }
+
+        WHEN("The state is saved, and the original manager is discarded.")
+        {
+            State backup = world.saveState();
+            world.restoreState(backup);
+            backup = State{};
+
+            THEN("The names are still available.")
+            {
+                CHECK(std::string{named.name()} == "hero");
+                CHECK(std::string{unnamed.name()} == "Entity " + std::to_string(unnamed.id()));
+            }
+        }
+    }
+}
+
+
+SCENARIO("Entities can be created concurrently.")
+{
+    GIVEN("An entity manager with some erased entities.")
+    {
+        EntityManager world;
+        std::vector<Handle<Entity>> initial = world.addEntities(4);
+        {
+            Phase phase;
+            initial[2].get(phase)->erase();
+            initial[0].get(phase)->erase();
+        }
+
+        WHEN("Entities are created from several threads, each with its own phase.")
+        {
+            constexpr std::size_t threadCount = 4;
+            constexpr std::size_t perThread = 100;
+
+            std::vector<std::unique_ptr<Phase>> phases;
+            std::vector<std::vector<Handle<Entity>>> created(threadCount);
+            {
+                std::vector<std::thread> threads;
+                for (std::size_t threadId = 0; threadId != threadCount; ++threadId)
+                {
+                    Phase & phase = *phases.emplace_back(std::make_unique<Phase>());
+                    threads.emplace_back([&, threadId, &phase = phase]()
+                    {
+                        for (std::size_t i = 0; i != perThread; ++i)
+                        {
+                            if (i % 2 == 0)
+                            {
+                                created[threadId].push_back(world.addEntity(phase));
+                            }
+                            else
+                            {
+                                created[threadId].push_back(
+                                    world.spawn(phase, ComponentA{(double)i}));
+                            }
+                        }
+                    });
+                }
+                for (std::thread & thread : threads)
+                {
+                    thread.join();
+                }
+            }
+
+            THEN("The handles are not valid until the phases complete.")
+            {
+                CHECK_FALSE(created[0][0].isValid());
+                CHECK(world.countLiveEntities() == 2);
+            }
+
+            WHEN("The phases complete.")
+            {
+                phases.clear();
+
+                THEN("All the created entities are valid and distinct, the freed indices were re-used.")
+                {
+                    CHECK(world.countLiveEntities() == 2 + threadCount * perThread);
+
+                    std::set<EntityIndex> indices;
+                    for (const std::vector<Handle<Entity>> & handles : created)
+                    {
+                        for (const Handle<Entity> & handle : handles)
+                        {
+                            CHECK(handle.isValid());
+                            indices.insert(handle.id());
+                        }
+                    }
+                    CHECK(indices.size() == threadCount * perThread);
+                    CHECK(indices.contains(initial[0].id()));
+                    CHECK(indices.contains(initial[2].id()));
+                    CHECK_FALSE(initial[0].isValid());
+                    CHECK_FALSE(initial[2].isValid());
+                }
+
+                THEN("The spawned entities have their component.")
+                {
+                    CHECK(created[1][3].get()->get<ComponentA>().d == 3.);
+                    CHECK(created[1][2].getTypeSet().empty());
+                }
+
+                THEN("Entities can still be added immediately.")
+                {
+                    Handle<Entity> h = world.addEntity();
+                    CHECK(h.isValid());
+                    CHECK(h.id() == 4 + threadCount * perThread - 2);
+                    CHECK(world.countLiveEntities() == 3 + threadCount * perThread);
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO("Iterating the live entities.")
+{
+    GIVEN("An entity manager where most entities were erased.")
+    {
+        EntityManager world;
+        std::vector<Handle<Entity>> handles = world.addEntities(1000);
+        {
+            Phase phase;
+            for (std::size_t i = 0; i != handles.size(); ++i)
+            {
+                if (i % 10 == 0)
+                {
+                    handles[i].get(phase)->add(ComponentA{(double)i});
+                }
+                else if (i % 10 == 5)
+                {
+                    handles[i].get(phase)->add(ComponentB{});
+                }
+                else
+                {
+                    handles[i].get(phase)->erase();
+                }
+            }
+        }
+        REQUIRE(world.countLiveEntities() == 200);
+
+        std::set<EntityIndex> expected;
+        world.forEachHandle([&](Handle<Entity> aHandle, const char *)
+        {
+            expected.insert(aHandle.id());
+        });
+        REQUIRE(expected.size() == 200);
+
+        WHEN("The entities are iterated in storage order.")
+        {
+            std::vector<Handle<Entity>> visited;
+            world.forEachHandleInStorageOrder([&](Handle<Entity> aHandle)
+            {
+                visited.push_back(aHandle);
+            });
+
+            THEN("Each live entity is visited once, grouped by archetype.")
+            {
+                REQUIRE(visited.size() == 200);
+                std::set<EntityIndex> ids;
+                for (const Handle<Entity> & handle : visited)
+                {
+                    ids.insert(handle.id());
+                }
+                CHECK(ids == expected);
+
+                // Entities with the same components are visited consecutively.
+                std::size_t archetypeChanges = 0;
+                for (std::size_t i = 1; i != visited.size(); ++i)
+                {
+                    archetypeChanges += (visited[i].getTypeSet() != visited[i - 1].getTypeSet());
+                }
+                CHECK(archetypeChanges == 1);
+            }
+        }
+
+        WHEN("The entities are iterated in parallel.")
+        {
+            std::mutex mutex;
+            std::multiset<EntityIndex> ids;
+            world.forEachHandleParallel([&](Handle<Entity> aHandle)
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    ids.insert(aHandle.id());
+                },
+                3);
+
+            THEN("Each live entity is visited once.")
+            {
+                CHECK(ids.size() == 200);
+                CHECK(std::set<EntityIndex>(ids.begin(), ids.end()) == expected);
+            }
+        }
+    }
+}
+
+
+SCENARIO("Components can be constructed in place.")
+{
+    GIVEN("An entity manager with an entity with component (A).")
+    {
+        EntityManager world;
+        Handle<Entity> h1 = world.spawn(ComponentA{1.});
+        Buffer::gMoves = 0;
+
+        WHEN("A move-only component is emplaced.")
+        {
+            int value = 7;
+            {
+                Phase phase;
+                h1.get(phase)->emplace<Buffer>(std::size_t{3}, std::ref(value));
+                value = 8; // The reference is read when the phase is flushed.
+            }
+
+            THEN("It is constructed directly in its storage.")
+            {
+                CHECK(Buffer::gMoves == 0);
+                CHECK(h1.get()->get<Buffer>().values == std::vector<int>{8, 8, 8});
+                CHECK(h1.get()->get<ComponentA>().d == 1.);
+            }
+
+            WHEN("The component is emplaced again.")
+            {
+                {
+                    Phase phase;
+                    h1.get(phase)->emplace<Buffer>(std::size_t{1}, 2);
+                }
+
+                THEN("The value is replaced.")
+                {
+                    CHECK(h1.get()->get<Buffer>().values == std::vector<int>{2});
+                }
+            }
+
+            WHEN("An entity is removed before another entity with the same components.")
+            {
+                Handle<Entity> h2 = world.spawn(ComponentA{2.});
+                {
+                    Phase phase;
+                    h2.get(phase)->emplace<Buffer>(std::size_t{2}, 5);
+                }
+                // The storage might have grown.
+                Buffer::gMoves = 0;
+                {
+                    Phase phase;
+                    h1.get(phase)->erase();
+                }
+
+                THEN("The remaining component is moved over, not copied.")
+                {
+                    CHECK(Buffer::gMoves == 1);
+                    CHECK(h2.get()->get<Buffer>().values == std::vector<int>{5, 5});
+                }
+            }
+        }
+    }
+}
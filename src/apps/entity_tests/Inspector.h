@@ -15,9 +15,19 @@ public:
     static std::size_t countArchetypes(const EntityManager & aEntityManager)
     { return aEntityManager.mState->mArchetypes.size(); }
 
+    static std::size_t countNames(const EntityManager & aEntityManager)
+    { return aEntityManager.mState->mNameTable.size(); }
+
     template <class... VT_components>
     static Handle<Archetype> getArchetypeHandle(EntityManager & aEntityManager)
     { return aEntityManager.getArchetypeHandle(getTypeSet<VT_components...>()); }
+
+    static Archetype & getArchetype(EntityManager & aEntityManager, HandleKey<Archetype> aKey)
+    { return aEntityManager.archetype(aKey); }
+
+    template <class... VT_components>
+    static std::size_t countMatchedArchetypes(EntityManager & aEntityManager)
+    { return aEntityManager.mState->getQueryBackend<VT_components...>()->mMatchingArchetypes.size(); }
 };
 
 
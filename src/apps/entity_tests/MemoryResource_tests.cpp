@@ -0,0 +1,136 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+#include "Inspector.h"
+
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <memory_resource>
+#include <optional>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+namespace {
+
+    struct Chunked
+    {
+        int i;
+    };
+
+    /// \brief Forwards to the new-delete resource, keeping count of the outstanding allocations.
+    class CountingResource : public std::pmr::memory_resource
+    {
+    public:
+        std::size_t mOutstandingBytes{0};
+        std::size_t mAllocations{0};
+
+    private:
+        void * do_allocate(std::size_t aBytes, std::size_t aAlignment) override
+        {
+            mOutstandingBytes += aBytes;
+            ++mAllocations;
+            return std::pmr::new_delete_resource()->allocate(aBytes, aAlignment);
+        }
+
+        void do_deallocate(void * aPointer, std::size_t aBytes, std::size_t aAlignment) override
+        {
+            mOutstandingBytes -= aBytes;
+            std::pmr::new_delete_resource()->deallocate(aPointer, aBytes, aAlignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource & aOther) const noexcept override
+        {
+            return this == &aOther;
+        }
+    };
+
+} // anonymous namespace
+
+
+template <>
+struct ad::ent::UseChunkedStorage<Chunked> : std::true_type
+{};
+
+
+SCENARIO("Entity managers allocate their stores from a memory resource.")
+{
+    GIVEN("An entity manager using a counting resource.")
+    {
+        CountingResource resource;
+        std::optional<EntityManager> world{std::in_place, &resource};
+        CHECK(world->getMemoryResource() == &resource);
+
+        WHEN("Entities are spawned, and moved to other archetypes.")
+        {
+            std::vector<Handle<Entity>> handles;
+            for (int i = 0; i != 100; ++i)
+            {
+                handles.push_back(world->spawn(ComponentA{(double)i}, Chunked{i}));
+            }
+            {
+                Phase phase;
+                handles[0].get(phase)->add(ComponentB{"b"});
+            }
+
+            THEN("The stores and handles are allocated from the manager resource.")
+            {
+                CHECK(resource.mOutstandingBytes >= 100 * (sizeof(ComponentA) + sizeof(Chunked)));
+                CHECK(Query<ComponentA, Chunked>{*world}.countMatches() == 100);
+                CHECK(handles[0].get()->get<ComponentB>().str == "b");
+            }
+
+            WHEN("The state is saved and restored.")
+            {
+                const std::size_t allocations = resource.mAllocations;
+                State saved = world->saveState();
+                handles[5].get()->get<ComponentA>().d = -5.;
+                world->restoreState(saved);
+
+                THEN("The copies are allocated from the same resource.")
+                {
+                    CHECK(resource.mAllocations > allocations);
+                    CHECK(handles[5].get()->get<ComponentA>().d == 5.);
+                }
+            }
+
+            WHEN("The manager is destroyed.")
+            {
+                handles.clear();
+                world.reset();
+
+                THEN("All the memory is returned to the resource.")
+                {
+                    CHECK(resource.mOutstandingBytes == 0);
+                }
+            }
+        }
+    }
+
+    GIVEN("A throwaway entity manager using a monotonic buffer.")
+    {
+        std::pmr::monotonic_buffer_resource arena;
+        {
+            EntityManager simulation{&arena, HandleReuse::Lifo};
+            for (int i = 0; i != 50; ++i)
+            {
+                simulation.spawn(ComponentA{(double)i}, ComponentB{"simulated"});
+            }
+
+            THEN("It behaves as a default manager.")
+            {
+                double sum = 0.;
+                Query<ComponentA, ComponentB>{simulation}.each([&sum](ComponentA & aA, ComponentB &)
+                        {
+                            sum += aA.d;
+                        });
+                CHECK(sum == 49. * 50. / 2.);
+            }
+        }
+        // The manager is destroyed before its arena, which releases everything at once.
+        arena.release();
+    }
+}
@@ -0,0 +1,138 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+#include "Inspector.h"
+
+#include <entity/Entity.h>
+#include <entity/EntityManager.h>
+
+#include <string>
+#include <string_view>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+SCENARIO("Entities can be retrieved by name.")
+{
+    GIVEN("An entity manager with named and unnamed entities.")
+    {
+        EntityManager world;
+        Handle<Entity> hero = world.addEntity("hero");
+        Handle<Entity> villain = world.addEntity("villain");
+        Handle<Entity> unnamed = world.addEntity();
+
+        THEN("Named entities are found, from different string types.")
+        {
+            CHECK(world.handleFromName("hero") == hero);
+            CHECK(world.handleFromName(std::string{"villain"}) == villain);
+            CHECK(world.handleFromName(std::string_view{"hero"}) == hero);
+        }
+
+        THEN("Unknown names return an invalid handle.")
+        {
+            CHECK_FALSE(world.handleFromName("sidekick").isValid());
+        }
+
+        THEN("Generated names of unnamed entities are not indexed.")
+        {
+            std::string generated = unnamed.name();
+            CHECK_FALSE(world.handleFromName(generated).isValid());
+        }
+
+        THEN("Generated names are not interned.")
+        {
+            REQUIRE(Inspector<EntityManager>::countNames(world) == 2);
+            CHECK(std::string{unnamed.name()} == "Entity " + std::to_string(unnamed.id()));
+            world.forEachHandle([](Handle<Entity>, const char *)
+                    {});
+            CHECK(Inspector<EntityManager>::countNames(world) == 2);
+        }
+
+        THEN("Several names can be resolved at once.")
+        {
+            std::string_view names[] = {"villain", "nobody", "hero"};
+            std::vector<Handle<Entity>> handles = world.handlesFromNames(names);
+
+            REQUIRE(handles.size() == 3);
+            CHECK(handles[0] == villain);
+            CHECK_FALSE(handles[1].isValid());
+            CHECK(handles[2] == hero);
+        }
+
+        WHEN("A named entity is erased.")
+        {
+            {
+                Phase phase;
+                hero.get(phase)->erase();
+            }
+
+            THEN("It cannot be retrieved by name anymore.")
+            {
+                CHECK_FALSE(world.handleFromName("hero").isValid());
+                CHECK(world.handleFromName("villain") == villain);
+            }
+
+            WHEN("The name is given to a new entity.")
+            {
+                Handle<Entity> newHero = world.addEntity("hero");
+
+                THEN("The new entity is retrieved by name.")
+                {
+                    CHECK(world.handleFromName("hero") == newHero);
+                    CHECK(std::string{newHero.name()} == "hero");
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO("Names of erased entities are discarded.")
+{
+    GIVEN("An entity manager.")
+    {
+        EntityManager world;
+
+        WHEN("Many uniquely named entities are added and erased.")
+        {
+            for (int wave = 0; wave != 10; ++wave)
+            {
+                std::vector<Handle<Entity>> handles;
+                for (int i = 0; i != 1000; ++i)
+                {
+                    std::string name = "wave" + std::to_string(wave) + "_enemy" + std::to_string(i);
+                    handles.push_back(world.addEntity(name.c_str()));
+                }
+                for (int i = 0; i != 100; ++i)
+                {
+                    handles.push_back(world.addEntity());
+                    // Generates the name, which is not retained.
+                    handles.back().name();
+                }
+
+                Phase phase;
+                for (Handle<Entity> handle : handles)
+                {
+                    handle.get(phase)->erase();
+                }
+            }
+
+            THEN("No name is retained.")
+            {
+                CHECK(world.countLiveEntities() == 0);
+                CHECK(Inspector<EntityManager>::countNames(world) == 0);
+                CHECK_FALSE(world.handleFromName("wave9_enemy999").isValid());
+            }
+
+            THEN("Names are still functional.")
+            {
+                Handle<Entity> h = world.addEntity("wave3_enemy5");
+                CHECK(world.handleFromName("wave3_enemy5") == h);
+                CHECK(std::string{h.name()} == "wave3_enemy5");
+                CHECK(Inspector<EntityManager>::countNames(world) == 1);
+            }
+        }
+    }
+}
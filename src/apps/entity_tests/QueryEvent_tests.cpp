@@ -1,6 +1,7 @@
 #include "catch.hpp"
 
 #include "Components_helpers.h"
+#include "Inspector.h"
 
 #include <entity/Entity.h>
 #include <entity/EntityManager.h>
@@ -426,3 +427,95 @@ SCENARIO("Existing entities matching a query are signaled when registering a lis
         }
     }
 }
+
+
+SCENARIO("Several components are added and removed in a single migration.")
+{
+    GIVEN("An entity manager with an entity with component (A), and queries with listeners.")
+    {
+        EntityManager world;
+        Handle<Entity> h1 = world.spawn(ComponentA{1.});
+
+        Query<ComponentA, ComponentB> queryAB{world};
+        Query<ComponentA, ComponentB, ComponentC> queryABC{world};
+        std::size_t addedAB = 0;
+        std::size_t addedABC = 0;
+        std::size_t removedAB = 0;
+        queryAB.onAddEntity([&](Handle<Entity>, ComponentA &, ComponentB &)
+                {
+                    ++addedAB;
+                });
+        queryABC.onAddEntity([&](Handle<Entity>, ComponentA & a, ComponentB & b, ComponentC & c)
+                {
+                    ++addedABC;
+                    // All the components are in place when the listeners are notified.
+                    CHECK(a.d == 1.);
+                    CHECK(b.str == "b");
+                    CHECK(c.vec == std::vector<int>{1, 2});
+                });
+        queryAB.onRemoveEntity([&](Handle<Entity>, ComponentA &, ComponentB &)
+                {
+                    ++removedAB;
+                });
+
+        const std::size_t archetypeCount = Inspector<EntityManager>::countArchetypes(world);
+
+        WHEN("Components (B) and (C) are added at once.")
+        {
+            {
+                Phase phase;
+                h1.get(phase)->add(ComponentB{"b"}, ComponentC{{1, 2}});
+            }
+
+            THEN("Only the final archetype is created.")
+            {
+                CHECK(Inspector<EntityManager>::countArchetypes(world) == archetypeCount + 1);
+                CHECK(h1.get()->get<ComponentA>().d == 1.);
+                CHECK(h1.get()->get<ComponentB>().str == "b");
+                CHECK(h1.get()->get<ComponentC>().vec == std::vector<int>{1, 2});
+            }
+
+            THEN("Each listener is notified once.")
+            {
+                CHECK(addedAB == 1);
+                CHECK(addedABC == 1);
+            }
+
+            WHEN("Components (B) and (C) are removed at once.")
+            {
+                {
+                    Phase phase;
+                    h1.get(phase)->remove<ComponentB, ComponentC>();
+                }
+
+                THEN("The entity is back to archetype (A), without intermediate archetype.")
+                {
+                    CHECK(Inspector<EntityManager>::countArchetypes(world) == archetypeCount + 1);
+                    CHECK(h1.get()->get<ComponentA>().d == 1.);
+                    CHECK_FALSE(h1.get()->has<ComponentB>());
+                    CHECK_FALSE(h1.get()->has<ComponentC>());
+                    CHECK(removedAB == 1);
+                    CHECK(Inspector<EntityManager>::getArchetypeHandle<ComponentA>(world).get().countEntities() == 1);
+                }
+            }
+
+            WHEN("Components already present are added along a new one.")
+            {
+                {
+                    Phase phase;
+                    h1.get(phase)->add(ComponentB{"b2"}, ComponentA{2.}, ComponentEmpty{});
+                }
+
+                THEN("The present components are replaced, and the entity migrates once.")
+                {
+                    CHECK(Inspector<EntityManager>::countArchetypes(world) == archetypeCount + 2);
+                    CHECK(h1.get()->get<ComponentA>().d == 2.);
+                    CHECK(h1.get()->get<ComponentB>().str == "b2");
+                    CHECK(h1.get()->get<ComponentC>().vec == std::vector<int>{1, 2});
+                    CHECK(h1.get()->has<ComponentEmpty>());
+                    CHECK(addedAB == 1);
+                }
+            }
+        }
+    }
+}
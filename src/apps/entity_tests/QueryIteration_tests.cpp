@@ -6,6 +6,8 @@
 #include <entity/Query.h>
 
 #include <iostream>
+#include <set>
+#include <string>
 
 
 // Should appear before catch inclusion.
@@ -248,6 +250,96 @@ SCENARIO("Query iteration with handles.")
 }
 
 
+SCENARIO("Query iteration over a list of handles.")
+{
+    GIVEN("An entity manager with entities (A), entities (A, B), and an entity (B).")
+    {
+        EntityManager world;
+        std::vector<Handle<Entity>> handles;
+        for (int i = 0; i != 10; ++i)
+        {
+            if (i % 2 == 0)
+            {
+                handles.push_back(world.spawn(ComponentA{(double)i}));
+            }
+            else
+            {
+                handles.push_back(world.spawn(ComponentA{(double)i}, ComponentB{std::to_string(i)}));
+            }
+        }
+        Handle<Entity> onlyB = world.spawn(ComponentB{"onlyB"});
+
+        Handle<Entity> erased = world.spawn(ComponentA{-1.});
+        {
+            Phase phase;
+            erased.get(phase)->erase();
+        }
+
+        Query<ComponentA> queryA{world};
+
+        GIVEN("A list of handles in arbitrary order, with repetitions, invalid and non-matching handles.")
+        {
+            std::vector<Handle<Entity>> list{
+                handles[7], handles[2], onlyB, handles[9], erased, handles[2], Handle<Entity>{}, handles[4], handles[1],
+            };
+
+            WHEN("The query is iterated over the list.")
+            {
+                std::vector<std::pair<EntityIndex, double>> visited;
+                std::size_t count = queryA.eachOf(list, [&](Handle<Entity> aHandle, ComponentA & a)
+                        {
+                            visited.emplace_back(aHandle.id(), a.d);
+                            CHECK(aHandle.get()->get<ComponentA>().d == a.d);
+                        });
+
+                THEN("Each matching handle is visited with its components, as many times as it appears.")
+                {
+                    CHECK(count == 6);
+                    REQUIRE(visited.size() == 6);
+                    std::multiset<double> values;
+                    for (auto [_id, value] : visited)
+                    {
+                        values.insert(value);
+                    }
+                    CHECK(values == std::multiset<double>{1., 2., 2., 4., 7., 9.});
+                }
+
+                THEN("The entities of an archetype are visited consecutively.")
+                {
+                    // Entities (A) have even values, entities (A, B) have odd values.
+                    std::size_t parityChanges = 0;
+                    for (std::size_t i = 1; i != visited.size(); ++i)
+                    {
+                        if ((int)visited[i].second % 2 != (int)visited[i - 1].second % 2)
+                        {
+                            ++parityChanges;
+                        }
+                    }
+                    CHECK(parityChanges == 1);
+                }
+            }
+
+            WHEN("The component (A) is gathered from the list.")
+            {
+                std::vector<ComponentA> gathered(list.size(), ComponentA{-10.});
+                std::size_t count = queryA.gather<ComponentA>(list, gathered);
+
+                THEN("The values of matching handles are written at their position.")
+                {
+                    CHECK(count == 6);
+                    std::vector<double> values;
+                    for (const ComponentA & a : gathered)
+                    {
+                        values.push_back(a.d);
+                    }
+                    CHECK(values == std::vector<double>{7., 2., -10., 9., -10., 2., -10., 4., 1.});
+                }
+            }
+        }
+    }
+}
+
+
 SCENARIO("Query iteration with subset of components.")
 {
     GIVEN("An entity manager with two entities.")
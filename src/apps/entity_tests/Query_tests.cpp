@@ -8,6 +8,8 @@
 #include <entity/Query.h>
 
 #include <array>
+#include <set>
+#include <string>
 
 
 using namespace ad;
@@ -342,6 +344,121 @@ SCENARIO("Removing components takes entities out of corresponding queries.")
 }
 
 
+SCENARIO("Erasing many entities at once.")
+{
+    GIVEN("An entity manager with entities (A) and entities (A, B), and a listener on removals from (A).")
+    {
+        EntityManager world;
+        std::vector<Handle<Entity>> handles;
+        for (int i = 0; i != 20; ++i)
+        {
+            if (i % 2 == 0)
+            {
+                handles.push_back(world.spawn(ComponentA{(double)i}));
+            }
+            else
+            {
+                handles.push_back(world.spawn(ComponentA{(double)i}, ComponentB{std::to_string(i)}));
+            }
+        }
+
+        Query<ComponentA> queryA{world};
+        std::set<double> removedValues;
+        queryA.onRemoveEntity([&](Handle<Entity> h, ComponentA & a)
+                {
+                    CHECK(h.isValid());
+                    removedValues.insert(a.d);
+                });
+
+        // Checks that each remaining entity still has its components.
+        auto checkRemaining = [&](const std::set<double> & aErased)
+        {
+            for (std::size_t i = 0; i != handles.size(); ++i)
+            {
+                bool erased = aErased.contains((double)i);
+                REQUIRE(handles[i].isValid() == !erased);
+                if (!erased)
+                {
+                    CHECK(handles[i].get()->get<ComponentA>().d == (double)i);
+                    if (i % 2 == 1)
+                    {
+                        CHECK(handles[i].get()->get<ComponentB>().str == std::to_string(i));
+                    }
+                }
+            }
+            CHECK(queryA.verifyArchetypes());
+            CHECK(Query<ComponentA, ComponentB>{world}.verifyArchetypes());
+        };
+
+        WHEN("Entities from both archetypes are erased at once, some handles appearing twice.")
+        {
+            std::vector<Handle<Entity>> victims{
+                handles[18], handles[3], handles[0], handles[19], handles[7], handles[3], handles[2],
+            };
+            world.eraseAll(victims);
+
+            THEN("Each erased entity is signaled once, with its component value.")
+            {
+                CHECK(removedValues == std::set<double>{0., 2., 3., 7., 18., 19.});
+            }
+
+            THEN("Only the erased entities are removed.")
+            {
+                CHECK(world.countLiveEntities() == 14);
+                CHECK(queryA.countMatches() == 14);
+                checkRemaining({0., 2., 3., 7., 18., 19.});
+            }
+        }
+
+        WHEN("All the entities are erased at once.")
+        {
+            world.eraseAll(handles);
+
+            THEN("The manager is empty.")
+            {
+                CHECK(removedValues.size() == 20);
+                CHECK(world.countLiveEntities() == 0);
+                CHECK(queryA.countMatches() == 0);
+                checkRemaining({0., 1., 2., 3., 4., 5., 6., 7., 8., 9.,
+                                10., 11., 12., 13., 14., 15., 16., 17., 18., 19.});
+            }
+        }
+
+        WHEN("The entities with a component (A) value multiple of 3 are removed through the query.")
+        {
+            std::size_t count = queryA.removeIf([](ComponentA & a)
+                    {
+                        return (int)a.d % 3 == 0;
+                    });
+
+            THEN("Exactly those entities are erased.")
+            {
+                CHECK(count == 7);
+                CHECK(removedValues == std::set<double>{0., 3., 6., 9., 12., 15., 18.});
+                CHECK(world.countLiveEntities() == 13);
+                checkRemaining({0., 3., 6., 9., 12., 15., 18.});
+            }
+        }
+
+        WHEN("The entities with component (B) are removed through a query taking the handle.")
+        {
+            Query<ComponentB> queryB{world};
+            std::size_t count = queryB.removeIf([&](Handle<Entity> aHandle, ComponentB &)
+                    {
+                        return aHandle != handles[5];
+                    });
+
+            THEN("All the entities (A, B) except the excluded one are erased.")
+            {
+                CHECK(count == 9);
+                CHECK(world.countLiveEntities() == 11);
+                checkRemaining({1., 3., 7., 9., 11., 13., 15., 17., 19.});
+            }
+        }
+    }
+}
+
+
 SCENARIO("Queries are updated with new matching archetypes.")
 {
     GIVEN("An entity manager, with an entity with components (A, B).")
@@ -0,0 +1,149 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+#include "Inspector.h"
+
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+namespace {
+
+    struct Body
+    {
+        float x{0.f};
+        float y{0.f};
+        float vx{0.f};
+        std::string name;
+    };
+
+} // anonymous namespace
+
+
+template <>
+struct ad::ent::SoaFields<Body>
+{
+    static constexpr auto gFields = std::make_tuple(&Body::x, &Body::y, &Body::vx, &Body::name);
+};
+
+
+SCENARIO("Components declaring their fields are stored as a struct of arrays.")
+{
+    static_assert(SoaComponent<Body>);
+    static_assert(std::is_same_v<ComponentRef_t<Body>, SoaRef<Body>>);
+
+    GIVEN("An entity manager with 5 entities with components (A, Body).")
+    {
+        EntityManager world;
+        std::vector<Handle<Entity>> handles;
+        for (int i = 0; i != 5; ++i)
+        {
+            handles.push_back(
+                world.spawn(ComponentA{(double)i},
+                            Body{.x = (float)i, .y = 0.f, .vx = 1.f, .name = "body" + std::to_string(i)}));
+        }
+        Archetype & archetype = Inspector<EntityManager>::getArchetypeHandle<ComponentA, Body>(world).get();
+
+        THEN("Each field is stored in its own contiguous array.")
+        {
+            Storage<Body> & storage =
+                archetype.getStorage(archetype.getStoreIndex<Body>());
+            SoaSpan<Body> bodies = storage.batch();
+            REQUIRE(bodies.size() == 5);
+            CHECK(&bodies.get<&Body::x>()[1] == &bodies.get<&Body::x>()[0] + 1);
+            CHECK(bodies.field<3>()[2] == "body2");
+            CHECK(storage.data() == nullptr);
+        }
+
+        THEN("The entities give access to the components via a proxy.")
+        {
+            SoaRef<Body> body = handles[3].get()->get<Body>();
+            CHECK(body.get<&Body::x>() == 3.f);
+            Body copy = body;
+            CHECK(copy.name == "body3");
+
+            body.get<&Body::y>() = 10.f;
+            CHECK(handles[3].get()->get<Body>().get<&Body::y>() == 10.f);
+            body = Body{.x = -1.f, .y = -2.f, .vx = -3.f, .name = "replaced"};
+            CHECK(static_cast<Body>(handles[3].get()->get<Body>()).name == "replaced");
+            CHECK(static_cast<Body>(handles[2].get()->get<Body>()).name == "body2");
+        }
+
+        WHEN("The bodies are integrated by batch.")
+        {
+            Query<ComponentA, Body> query{world};
+            std::size_t batches = 0;
+            query.eachBatch([&batches](std::span<ComponentA> aA, SoaSpan<Body> aBodies)
+                    {
+                        ++batches;
+                        std::span<float> x = aBodies.get<&Body::x>();
+                        std::span<const float> vx = aBodies.get<&Body::vx>();
+                        for (std::size_t i = 0; i != x.size(); ++i)
+                        {
+                            x[i] += 2.f * vx[i];
+                        }
+                        CHECK(aA.size() == x.size());
+                    });
+
+            THEN("The fields of all the entities are updated.")
+            {
+                CHECK(batches == 1);
+                query.each([](ComponentA & aA, SoaRef<Body> aBody)
+                        {
+                            CHECK(aBody.get<&Body::x>() == (float)aA.d + 2.f);
+                        });
+                CHECK(handles[4].get()->get<Body>().get<&Body::x>() == 6.f);
+            }
+        }
+
+        WHEN("An entity is erased, and another one migrates to a new archetype.")
+        {
+            {
+                Phase phase;
+                handles[1].get(phase)->erase();
+                handles[2].get(phase)->add(ComponentB{"b"});
+            }
+
+            THEN("The fields are relocated together.")
+            {
+                CHECK(archetype.countEntities() == 3);
+                CHECK(archetype.verifyStoresConsistency());
+                for (int i : {0, 3, 4})
+                {
+                    Body body = handles[i].get()->get<Body>();
+                    CHECK(body.x == (float)i);
+                    CHECK(body.name == "body" + std::to_string(i));
+                }
+                Body migrated = handles[2].get()->get<Body>();
+                CHECK(migrated.name == "body2");
+                CHECK(Query<Body, ComponentB>{world}.countMatches() == 1);
+            }
+        }
+
+        WHEN("An entity is copied, and the state is saved.")
+        {
+            Handle<Entity> copy = world.addEntity();
+            {
+                Phase phase;
+                handles[0].get(phase)->copy(copy);
+            }
+            State saved = world.saveState();
+            handles[0].get()->get<Body>().get<&Body::name>() = "modified";
+
+            THEN("The copies hold the original values.")
+            {
+                CHECK(static_cast<Body>(copy.get()->get<Body>()).name == "body0");
+                world.restoreState(saved);
+                CHECK(static_cast<Body>(handles[0].get()->get<Body>()).name == "body0");
+            }
+        }
+    }
+}
@@ -0,0 +1,169 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+#include "Inspector.h"
+
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <set>
+#include <vector>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+namespace {
+
+    struct Burning
+    {
+        int turns;
+    };
+
+    struct Selected
+    {};
+
+} // anonymous namespace
+
+
+template <>
+struct ad::ent::UseSparseStorage<Burning> : std::true_type
+{};
+
+template <>
+struct ad::ent::UseSparseStorage<Selected> : std::true_type
+{};
+
+
+SCENARIO("Sparse components are toggled without migrating the entities.")
+{
+    static_assert(SparseComponent<Selected> && !TagComponent<Selected>);
+
+    GIVEN("An entity manager with 10 entities with component (A), the odd ones also with component (B).")
+    {
+        EntityManager world;
+        std::vector<Handle<Entity>> handles;
+        for (int i = 0; i != 10; ++i)
+        {
+            handles.push_back(i % 2 == 0 ? world.spawn(ComponentA{(double)i})
+                                         : world.spawn(ComponentA{(double)i}, ComponentB{"b"}));
+        }
+        const std::size_t archetypeCount = Inspector<EntityManager>::countArchetypes(world);
+        Archetype & archetypeA = Inspector<EntityManager>::getArchetypeHandle<ComponentA>(world).get();
+
+        WHEN("Sparse component (Burning) is added to entities 0, 3 and 4.")
+        {
+            {
+                Phase phase;
+                for (int i : {0, 3, 4})
+                {
+                    handles[i].get(phase)->add(Burning{i});
+                }
+            }
+
+            THEN("The entities stay in their archetype, and have the component.")
+            {
+                CHECK(Inspector<EntityManager>::countArchetypes(world) == archetypeCount);
+                CHECK(archetypeA.countEntities() == 5);
+                CHECK(handles[3].get()->has<Burning>());
+                CHECK_FALSE(handles[1].get()->has<Burning>());
+                CHECK(handles[4].get()->get<Burning>().turns == 4);
+                CHECK(handles[4].get()->get<ComponentA>().d == 4.);
+                CHECK(archetypeA.verifyHandlesConsistency(world));
+            }
+
+            THEN("Queries including it only visit the entities with the component.")
+            {
+                Query<ComponentA, Burning> queryBurning{world};
+                std::set<double> visited;
+                queryBurning.each([&visited](ComponentA & a, Burning & aBurning)
+                        {
+                            CHECK(a.d == (double)aBurning.turns);
+                            visited.insert(a.d);
+                        });
+                CHECK(visited == std::set<double>{0., 3., 4.});
+                CHECK(queryBurning.countMatches() == 3);
+                CHECK(Query<ComponentB, Burning>{world}.countMatches() == 1);
+                CHECK(Query<Burning>{world}.countMatches() == 3);
+                CHECK(Query<ComponentA>{world}.countMatches() == 10);
+            }
+
+            THEN("Visiting given handles skips the entities without the component.")
+            {
+                Query<ComponentA, Burning> queryBurning{world};
+                std::set<double> visited;
+                CHECK(queryBurning.eachOf(handles, [&visited](ComponentA & a, Burning &)
+                        {
+                            visited.insert(a.d);
+                        }) == 3);
+                CHECK(visited == std::set<double>{0., 3., 4.});
+            }
+
+            WHEN("The component is removed from entity 3, and added again on entity 0.")
+            {
+                {
+                    Phase phase;
+                    handles[3].get(phase)->remove<Burning>();
+                    handles[0].get(phase)->emplace<Burning>(10);
+                }
+
+                THEN("The other entities keep their component.")
+                {
+                    CHECK_FALSE(handles[3].get()->has<Burning>());
+                    CHECK(handles[0].get()->get<Burning>().turns == 10);
+                    CHECK(handles[4].get()->get<Burning>().turns == 4);
+                    CHECK(Query<Burning>{world}.countMatches() == 2);
+                }
+            }
+
+            WHEN("The burning entities with component (B) are erased by a query.")
+            {
+                CHECK(Query<ComponentB, Burning>{world}.removeIf([](ComponentB &, Burning &)
+                        {
+                            return true;
+                        }) == 1);
+
+                THEN("The component is released with the entity, its index is reused without it.")
+                {
+                    CHECK_FALSE(handles[3].isValid());
+                    CHECK(Query<Burning>{world}.countMatches() == 2);
+                    Handle<Entity> reused = world.spawn(ComponentB{"reused"});
+                    CHECK_FALSE(reused.get()->has<Burning>());
+                }
+            }
+
+            WHEN("The state is saved, then the components are modified.")
+            {
+                State saved = world.saveState();
+                {
+                    Phase phase;
+                    handles[4].get(phase)->get<Burning>().turns = 100;
+                    handles[0].get(phase)->remove<Burning>();
+                }
+
+                THEN("Restoring the state restores the sparse components.")
+                {
+                    world.restoreState(saved);
+                    CHECK(handles[0].get()->has<Burning>());
+                    CHECK(handles[4].get()->get<Burning>().turns == 4);
+                }
+            }
+        }
+
+        WHEN("An empty sparse component (Selected) is added.")
+        {
+            {
+                Phase phase;
+                handles[5].get(phase)->add(Selected{});
+            }
+
+            THEN("It is stored in a sparse set, not as a tag.")
+            {
+                CHECK(Inspector<EntityManager>::countArchetypes(world) == archetypeCount);
+                CHECK(handles[5].get()->has<Selected>());
+                CHECK(Query<ComponentB, Selected>{world}.countMatches() == 1);
+            }
+        }
+    }
+}
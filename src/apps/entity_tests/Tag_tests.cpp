@@ -0,0 +1,117 @@
+#include "catch.hpp"
+
+#include "Components_helpers.h"
+#include "Inspector.h"
+
+#include <entity/EntityManager.h>
+#include <entity/Query.h>
+
+#include <set>
+
+
+using namespace ad;
+using namespace ad::ent;
+
+
+namespace {
+
+    struct Selected
+    {};
+
+    struct Hostile
+    {};
+
+} // anonymous namespace
+
+
+SCENARIO("Empty components are tags, without storage.")
+{
+    static_assert(TagComponent<Selected>);
+    static_assert(TagComponent<Blueprint>);
+    static_assert(!TagComponent<ComponentA>);
+
+    GIVEN("An entity manager with entities having component (A) and tags (Selected, Hostile).")
+    {
+        EntityManager world;
+        Handle<Entity> h1 = world.spawn(ComponentA{1.}, Selected{}, Hostile{});
+        Handle<Entity> h2 = world.spawn(ComponentA{2.}, Selected{});
+        Archetype & archetypeAS = Inspector<EntityManager>::getArchetypeHandle<ComponentA, Selected>(world).get();
+
+        THEN("The tags are part of the archetypes signature, without a store.")
+        {
+            CHECK(h1.get()->has<Selected>());
+            CHECK(h1.get()->has<Hostile>());
+            CHECK_FALSE(h2.get()->has<Hostile>());
+            CHECK(archetypeAS.getTypeSet() == getTypeSet<ComponentA, Selected>());
+            CHECK(archetypeAS.getStoreIndex<ComponentA>() == 0);
+            CHECK(archetypeAS.getStoreIndex<Selected>() == Archetype::gTagStoreIndex);
+            CHECK(archetypeAS.verifyStoresConsistency());
+        }
+
+        THEN("Queries on tags visit the matching entities, with a shared instance of the tags.")
+        {
+            std::set<double> visited;
+            std::set<const Selected *> instances;
+            Query<ComponentA, Selected>{world}.each([&](ComponentA & a, Selected & aSelected)
+                    {
+                        visited.insert(a.d);
+                        instances.insert(&aSelected);
+                    });
+            CHECK(visited == std::set<double>{1., 2.});
+            CHECK(instances.size() == 1);
+            CHECK(Query<Hostile>{world}.countMatches() == 1);
+        }
+
+        WHEN("A tag is added then removed from an entity.")
+        {
+            {
+                Phase phase;
+                h2.get(phase)->add(Hostile{});
+            }
+
+            THEN("Only the component columns are mapped along the transition.")
+            {
+                const ArchetypeEdge * edge =
+                    archetypeAS.findEdge(Archetype::Transition::Add, getId<Hostile>());
+                REQUIRE(edge != nullptr);
+                CHECK(edge->mColumnMapping.size() == 1);
+                CHECK(h2.get()->has<Hostile>());
+                CHECK(h2.get()->get<ComponentA>().d == 2.);
+                CHECK(Query<Hostile>{world}.countMatches() == 2);
+            }
+
+            WHEN("The tag is removed.")
+            {
+                {
+                    Phase phase;
+                    h2.get(phase)->remove<Hostile>();
+                    h1.get(phase)->remove<Selected>();
+                }
+
+                THEN("The entities keep their other components.")
+                {
+                    CHECK_FALSE(h2.get()->has<Hostile>());
+                    CHECK(h2.get()->get<ComponentA>().d == 2.);
+                    CHECK_FALSE(h1.get()->has<Selected>());
+                    CHECK(h1.get()->has<Hostile>());
+                    CHECK(h1.get()->get<ComponentA>().d == 1.);
+                    CHECK(archetypeAS.verifyHandlesConsistency(world));
+                    CHECK(Query<Selected>{world}.countMatches() == 1);
+                }
+            }
+        }
+
+        WHEN("An entity with only tags is spawned.")
+        {
+            Handle<Entity> h3 = world.spawn(Selected{}, Hostile{});
+
+            THEN("It is visited by the queries on its tags.")
+            {
+                CHECK(h3.get()->has<Selected>());
+                CHECK(Query<Selected, Hostile>{world}.countMatches() == 2);
+                CHECK(Inspector<EntityManager>::getArchetypeHandle<Selected, Hostile>(world)
+                        .get().countEntities() == 1);
+            }
+        }
+    }
+}
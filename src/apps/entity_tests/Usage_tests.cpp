@@ -817,3 +817,171 @@ SCENARIO("Adding components to entities does not break other handles.")
         }
     }
 }
+
+
+SCENARIO("Adding entities in bulk.")
+{
+    GIVEN("An entity manager with an entity.")
+    {
+        EntityManager world;
+        Handle<Entity> h1 = world.addEntity();
+
+        WHEN("Several entities are added at once.")
+        {
+            std::vector<Handle<Entity>> handles = world.addEntities(100);
+
+            THEN("All entities are valid, and distinct.")
+            {
+                REQUIRE(handles.size() == 100);
+                CHECK(world.countLiveEntities() == 101);
+                for (std::size_t i = 0; i != handles.size(); ++i)
+                {
+                    CHECK(handles[i].isValid());
+                    CHECK(handles[i].id() != h1.id());
+                    if (i != 0)
+                    {
+                        CHECK(handles[i].id() != handles[i - 1].id());
+                    }
+                }
+            }
+
+            THEN("The entities can be used as any other entity.")
+            {
+                {
+                    Phase phase;
+                    for (std::size_t i = 0; i != handles.size(); ++i)
+                    {
+                        handles[i].get(phase)->add(ComponentA{(double)i});
+                    }
+                }
+
+                Query<ComponentA> query{world};
+                CHECK(query.countMatches() == 100);
+                CHECK(handles[42].get()->get<ComponentA>().d == 42.);
+                CHECK(query.verifyArchetypes());
+            }
+
+            WHEN("Some entities are erased, and the span variant is used.")
+            {
+                {
+                    Phase phase;
+                    handles[10].get(phase)->erase();
+                    handles[20].get(phase)->erase();
+                }
+
+                std::vector<Handle<Entity>> more(5);
+                world.addEntities(more);
+
+                THEN("The freed handles are re-used first.")
+                {
+                    CHECK(world.countLiveEntities() == 104);
+                    CHECK(more[0].id() == handles[10].id());
+                    CHECK(more[1].id() == handles[20].id());
+                    for (const Handle<Entity> & handle : more)
+                    {
+                        CHECK(handle.isValid());
+                    }
+                    CHECK_FALSE(handles[10].isValid());
+                }
+            }
+        }
+    }
+}
+
+
+SCENARIO("Spawning entities with all their components.")
+{
+    GIVEN("An entity manager, with queries listening for added entities.")
+    {
+        EntityManager world;
+
+        Query<ComponentA> queryA{world};
+        Query<ComponentA, ComponentB> queryAB{world};
+        std::size_t addedA = 0;
+        std::size_t addedAB = 0;
+        queryA.onAddEntity([&](Handle<Entity>, ComponentA &)
+                {
+                    ++addedA;
+                });
+        queryAB.onAddEntity([&](Handle<Entity>, ComponentA &, ComponentB &)
+                {
+                    ++addedAB;
+                });
+
+        WHEN("An entity is spawned with components (A, B).")
+        {
+            Handle<Entity> h1 = world.spawn(ComponentA{1.}, ComponentB{"spawned"});
+
+            THEN("The entity has both components, and each query was notified once.")
+            {
+                CHECK(h1.isValid());
+                CHECK(h1.getTypeSet() == getTypeSet<ComponentA, ComponentB>());
+                CHECK(h1.get()->get<ComponentA>().d == 1.);
+                CHECK(h1.get()->get<ComponentB>().str == "spawned");
+
+                CHECK(addedA == 1);
+                CHECK(addedAB == 1);
+                CHECK(queryAB.countMatches() == 1);
+                CHECK(queryAB.verifyArchetypes());
+            }
+
+            WHEN("An entity with the same components in another order is spawned.")
+            {
+                Handle<Entity> h2 = world.spawn(ComponentB{"second"}, ComponentA{2.});
+
+                THEN("It shares the archetype of the first entity.")
+                {
+                    CHECK(h2.getTypeSet() == h1.getTypeSet());
+                    CHECK(queryAB.countMatches() == 2);
+                    CHECK(h2.get()->get<ComponentA>().d == 2.);
+                    CHECK(h1.get()->get<ComponentB>().str == "spawned");
+                }
+            }
+
+            WHEN("The same components are added one at a time to another entity.")
+            {
+                Handle<Entity> h2 = world.addEntity();
+                {
+                    Phase phase;
+                    h2.get(phase)->add(ComponentA{2.})
+                        .add(ComponentB{"added"});
+                }
+
+                THEN("Both entities are in the same archetype.")
+                {
+                    CHECK(queryAB.countMatches() == 2);
+                    CHECK(queryAB.verifyArchetypes());
+                    CHECK(addedA == 2);
+                    CHECK(addedAB == 2);
+                }
+            }
+        }
+
+        WHEN("An entity is spawned within a phase.")
+        {
+            Handle<Entity> h1;
+            {
+                Phase phase;
+                h1 = world.spawn(phase, ComponentA{3.}, ComponentB{"deferred"});
+
+                THEN("The handle is reserved, but the entity is only created at the end of the phase.")
+                {
+                    CHECK_FALSE(h1.isValid());
+                    CHECK(world.countLiveEntities() == 0);
+                    CHECK(addedA == 0);
+                }
+            }
+
+            THEN("After the phase, the entity has both components, and each query was notified once.")
+            {
+                REQUIRE(h1.isValid());
+                CHECK(h1.getTypeSet() == getTypeSet<ComponentA, ComponentB>());
+                CHECK(h1.get()->get<ComponentA>().d == 3.);
+                CHECK(h1.get()->get<ComponentB>().str == "deferred");
+                CHECK(addedA == 1);
+                CHECK(addedAB == 1);
+                CHECK(queryAB.verifyArchetypes());
+            }
+        }
+    }
+}
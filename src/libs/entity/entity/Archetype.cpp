@@ -104,7 +104,9 @@ bool Archetype::verifyStoresConsistency()
 
 
 template<Archetype::Operation N_operation>
-void Archetype::moveOrCopy(EntityIndex aSourceEntityIndex, Archetype & aDestination, EntityManager & aManager)
+void Archetype::moveOrCopy(EntityIndex aSourceEntityIndex,
+                           Archetype & aDestination,
+                           std::span<const std::size_t> aColumnMapping)
 {
 #if defined(ENTITY_SANITIZE)
     // If one of the archetypes is currently under iteration via Query::each(),
@@ -112,54 +114,120 @@ void Archetype::moveOrCopy(EntityIndex aSourceEntityIndex, Archetype & aDestinat
     assert(this->mCurrentQueryIterations == 0);
     assert(aDestination.mCurrentQueryIterations == 0);
 #endif
+    assert(aColumnMapping.size() == mStores.size());
 
-    // Move the matching components from the stores of `this` archetype to the destination stores.
+    // Push the components of the source stores which have a destination store, at the back of it.
     for(std::size_t sourceStoreId = 0;
-        sourceStoreId != mType.size();
+        sourceStoreId != mStores.size();
         ++sourceStoreId)
     {
-        for(std::size_t destinationStoreId = 0; 
-            destinationStoreId != aDestination.mType.size();
-            ++destinationStoreId)
+        if(std::size_t destinationStoreId = aColumnMapping[sourceStoreId];
+           destinationStoreId != ArchetypeEdge::gNoColumn)
         {
-            // Found matching components, move-push from source at the back of destination
-            if(mType[sourceStoreId] == aDestination.mType[destinationStoreId])
+            if constexpr (N_operation == Operation::Move)
             {
-                if constexpr (N_operation == Operation::Move)
-                {
-                    aDestination.mStores[destinationStoreId]
-                        ->moveFrom(aSourceEntityIndex, *mStores[sourceStoreId]);
-                    break; // Once the matching destination store has been found, go to next source store.
-
-                }
-                else if constexpr (N_operation == Operation::Copy)
-                {
-                        aDestination.mStores[destinationStoreId]
-                            ->copyFrom(aSourceEntityIndex, *mStores[sourceStoreId]);
-                        break; // Once the matching destination store has been found, go to next source store.
-                }
+                aDestination.mStores[destinationStoreId]
+                    ->moveFrom(aSourceEntityIndex, *mStores[sourceStoreId]);
             }
+            else if constexpr (N_operation == Operation::Copy)
+            {
+                aDestination.mStores[destinationStoreId]
+                    ->copyFrom(aSourceEntityIndex, *mStores[sourceStoreId]);
+            }
+        }
+    }
+}
+
+
+std::vector<std::size_t> Archetype::computeColumnMapping(const Archetype & aDestination) const
+{
+    std::vector<std::size_t> mapping(mType.size(), ArchetypeEdge::gNoColumn);
+    for(std::size_t sourceStoreId = 0; sourceStoreId != mType.size(); ++sourceStoreId)
+    {
+        auto found = std::find(aDestination.mType.begin(), aDestination.mType.end(), mType[sourceStoreId]);
+        if(found != aDestination.mType.end())
+        {
+            mapping[sourceStoreId] = found - aDestination.mType.begin();
         }
     }
+    return mapping;
+}
+
+
+const ArchetypeEdge & Archetype::insertEdge(Transition aTransition,
+                                            ComponentId aComponent,
+                                            HandleKey<Archetype> aDestinationKey,
+                                            const Archetype & aDestination)
+{
+    EdgeList & list = edges(aTransition);
+    auto position = std::lower_bound(list.begin(), list.end(), aComponent,
+                                     [](const auto & aEdge, ComponentId aId)
+                                     {
+                                         return aEdge.first < aId;
+                                     });
+    assert(position == list.end() || position->first != aComponent);
+    return list.emplace(position,
+                        aComponent,
+                        ArchetypeEdge{
+                            .mDestination = aDestinationKey,
+                            .mColumnMapping = computeColumnMapping(aDestination),
+                        })
+        ->second;
+}
+
+
+void Archetype::eraseEdgesTo(std::span<const HandleKey<Archetype>> aDestinations)
+{
+    auto isErased = [aDestinations](const auto & aEdge)
+    {
+        return std::find(aDestinations.begin(), aDestinations.end(), aEdge.second.mDestination)
+               != aDestinations.end();
+    };
+    // Erasing preserves the order of the remaining edges.
+    std::erase_if(mAddEdges, isErased);
+    std::erase_if(mRemoveEdges, isErased);
 }
 
 
 void Archetype::move(std::size_t aEntityIndex, Archetype & aDestination, EntityManager & aManager)
 {
-    moveOrCopy<Operation::Move>(aEntityIndex, aDestination, aManager);
+    move(aEntityIndex, aDestination, computeColumnMapping(aDestination), aManager);
+}
+
+
+void Archetype::move(EntityIndex aEntityIndex,
+                     Archetype & aDestination,
+                     std::span<const std::size_t> aColumnMapping,
+                     EntityManager & aManager)
+{
+    moveOrCopy<Operation::Move>(aEntityIndex, aDestination, aColumnMapping);
 
+    // Flags are not part of the archetype, they follow the entity.
+    copyFlags(aEntityIndex, aDestination, aDestination.mHandles.size());
     // Copy the HandleKey for the moved entity.
-    aDestination.mHandles.push_back(mHandles[aEntityIndex]);
+    aDestination.pushHandle(mHandles[aEntityIndex]);
 
     remove(aEntityIndex, aManager);
 }
 
+
 void Archetype::copy(EntityIndex aSourceEntityIndex, HandleKey<Entity> aDestHandle, Archetype & aDestination, EntityManager & aManager)
 {
-    moveOrCopy<Operation::Copy>(aSourceEntityIndex, aDestination, aManager);
-    //
+    copy(aSourceEntityIndex, aDestHandle, aDestination, computeColumnMapping(aDestination), aManager);
+}
+
+
+void Archetype::copy(EntityIndex aSourceEntityIndex,
+                     HandleKey<Entity> aDestHandle,
+                     Archetype & aDestination,
+                     std::span<const std::size_t> aColumnMapping,
+                     EntityManager & aManager)
+{
+    moveOrCopy<Operation::Copy>(aSourceEntityIndex, aDestination, aColumnMapping);
+
+    copyFlags(aSourceEntityIndex, aDestination, aDestination.mHandles.size());
     // Copy the HandleKey for the moved entity.
-    aDestination.mHandles.push_back(aDestHandle);
+    aDestination.pushHandle(aDestHandle);
 }
 
 void Archetype::remove(EntityIndex aEntityIndex, EntityManager & aManager)
@@ -186,6 +254,78 @@ void Archetype::remove(EntityIndex aEntityIndex, EntityManager & aManager)
     {
         mStores[storeId]->remove(aEntityIndex);
     }
+
+    // Erase the flags, mHandles already being one element shorter.
+    for(std::size_t flag = 0; flag != mUsedFlags; ++flag)
+    {
+        mFlags[flag].eraseByMoveOver(aEntityIndex, mHandles.size());
+    }
+
+    applyShrinkPolicy(aManager.getShrinkPolicy());
+}
+
+
+void Archetype::removeMany(std::span<const EntityIndex> aEntityIndices, EntityManager & aManager)
+{
+#if defined(ENTITY_SANITIZE)
+    // If this archetype is currently under iteration via Query::each(), there is an error.
+    assert(mCurrentQueryIterations == 0);
+#endif
+    assert(std::is_sorted(aEntityIndices.begin(), aEntityIndices.end())
+           && std::adjacent_find(aEntityIndices.begin(), aEntityIndices.end()) == aEntityIndices.end());
+    assert(aEntityIndices.empty() || aEntityIndices.back() < countEntities());
+
+    // Plan the relocations once, for all the stores:
+    // each hole, by increasing index, receives the last entity that is not removed.
+    std::vector<Relocation> relocations;
+    std::size_t end = countEntities();
+    std::size_t lowest = 0;
+    std::size_t highest = aEntityIndices.size();
+    while (lowest != highest)
+    {
+        // Drop the removed entities at the end, which do not need to be relocated.
+        if (aEntityIndices[highest - 1] == end - 1)
+        {
+            --highest;
+            --end;
+        }
+        else
+        {
+            relocations.emplace_back(--end, aEntityIndices[lowest++]);
+        }
+    }
+    const std::size_t newSize = countEntities() - aEntityIndices.size();
+
+    detail::compactByRelocation(mHandles, relocations, newSize);
+    for (auto [_source, destination] : relocations)
+    {
+        aManager.record(mHandles[destination]).mIndex = destination;
+    }
+
+    for (auto & store : mStores)
+    {
+        store->compact(relocations, newSize);
+    }
+
+    for(std::size_t flag = 0; flag != mUsedFlags; ++flag)
+    {
+        mFlags[flag].compact(relocations, newSize);
+    }
+
+    applyShrinkPolicy(aManager.getShrinkPolicy());
+}
+
+
+void Archetype::copyFlags(EntityIndex aSourceIndex, Archetype & aDestination, EntityIndex aDestinationIndex) const
+{
+    for(std::size_t flag = 0; flag != mUsedFlags; ++flag)
+    {
+        if (mFlags[flag].test(aSourceIndex))
+        {
+            aDestination.mUsedFlags = std::max(aDestination.mUsedFlags, flag + 1);
+            aDestination.mFlags[flag].set(aDestinationIndex, true);
+        }
+    }
 }
 
 
@@ -195,18 +335,65 @@ void Archetype::pushKey(HandleKey<Entity> aKey)
     // If this archetype is currently under iteration via Query::each(), there is an error.
     assert(mCurrentQueryIterations == 0);
 #endif
-    mHandles.push_back(aKey); 
+    pushHandle(aKey);
 }
 
-std::unique_ptr<Archetype> Archetype::makeRestrictedFromTypeId(const ComponentId aId) const
+
+void Archetype::reserve(std::size_t aCount)
 {
-    auto result = std::make_unique<Archetype>();
+    const std::size_t capacity = countEntities() + aCount;
+    mHandles.reserve(capacity);
+    for (auto & store : mStores)
+    {
+        store->reserve(capacity);
+    }
+}
+
+
+void Archetype::shrink(std::size_t aCapacity)
+{
+#if defined(ENTITY_SANITIZE)
+    // The stores are reallocated, which would invalidate an iteration.
+    assert(mCurrentQueryIterations == 0);
+#endif
+    detail::shrinkCapacity(mHandles, aCapacity);
+    for (auto & store : mStores)
+    {
+        store->shrink(aCapacity);
+    }
+}
+
+
+void Archetype::applyShrinkPolicy(const ShrinkPolicy & aPolicy)
+{
+    if (aPolicy.mMode == ShrinkPolicy::Mode::Hysteresis
+        && capacity() > aPolicy.mMinimumCapacity
+        && countEntities() * aPolicy.mTrimRatio <= capacity())
+    {
+        std::size_t target = std::max(2 * countEntities(), aPolicy.mMinimumCapacity);
+        if (target < capacity())
+        {
+            shrink(target);
+        }
+    }
+}
+
+std::unique_ptr<Archetype> Archetype::makeRestrictedFromTypeIds(std::span<const ComponentId> aIds) const
+{
+    auto isRetired = [aIds](ComponentId aId)
+    {
+        return std::find(aIds.begin(), aIds.end(), aId) != aIds.end();
+    };
+
+    auto result = std::make_unique<Archetype>(mResource);
     result->mType = mType;
-    std::erase(result->mType, aId);
+    std::erase_if(result->mType, isRetired);
+    result->mTags = mTags;
+    std::erase_if(result->mTags, isRetired);
 
     for (const auto & store : mStores)
     {
-        if(store->getType() != aId)
+        if(!isRetired(store->getType()))
         {
             result->mStores.push_back(store->cloneEmpty());
         }
@@ -1,15 +1,28 @@
 #pragma once
 
 #include "Component.h"
+#include "Flag.h"
 #include "HandleKey.h"
+#include "Soa.h"
+#include "detail/AlignedAllocator.h"
+#include "detail/BitColumn.h"
+#include "detail/ChunkedVector.h"
+#include "detail/SparseSet.h"
 
 #if defined(ENTITY_SANITIZE)
 #include <handy/AtomicVariations.h>
 #endif
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <limits>
 #include <memory>
+#include <memory_resource>
+#include <span>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <cassert>
@@ -19,82 +32,256 @@ namespace ad {
 namespace ent {
 
 
+class Archetype; // forward
 class Entity; // forward
 
 template <class>
 class Storage;
 
+class StorageBase;
+
+
+/// \brief The handles of the entities stored in an archetype, in the same order than its stores.
+using EntityHandles = detail::ColumnVector<HandleKey<Entity>>;
+
+
+/// \brief Layout and type-erased operations of the Storage of a component type.
+///
+/// There is a single record per component type (see Storage::GetMetadata()),
+/// each StorageBase only points to the record of its component type.
+/// The compaction of a column after removing many entities costs a single indirect call.
+struct ColumnMetadata
+{
+    ComponentId mId;
+
+    std::unique_ptr<StorageBase> (*mMakeEmpty)(std::pmr::memory_resource * aResource);
+    std::unique_ptr<StorageBase> (*mClone)(const StorageBase & aStorage);
+    std::size_t (*mCount)(const StorageBase & aStorage);
+    std::size_t (*mCapacity)(const StorageBase & aStorage);
+    void (*mReserve)(StorageBase & aStorage, std::size_t aCapacity);
+    /// \brief Reduce the capacity to `aCapacity`, but not below the count of components.
+    void (*mShrink)(StorageBase & aStorage, std::size_t aCapacity);
+    void * (*mData)(StorageBase & aStorage);
+    /// \brief Move the component at `aSourceIndex` in `aSource`, pushing it at the back of `aDestination`.
+    void (*mMoveBack)(StorageBase & aDestination, StorageBase & aSource, EntityIndex aSourceIndex);
+    /// \brief Copy the component at `aSourceIndex` in `aSource`, pushing it at the back of `aDestination`.
+    void (*mCopyBack)(StorageBase & aDestination, const StorageBase & aSource, EntityIndex aSourceIndex);
+    void (*mRemove)(StorageBase & aStorage, EntityIndex aIndex);
+    void (*mCompact)(StorageBase & aStorage,
+                     std::span<const Relocation> aRelocations,
+                     std::size_t aNewSize);
+};
+
+
+/// \brief Type-erased Storage, dispatching its operations through the ColumnMetadata record of its component type.
 class StorageBase
 {
 public:
+    StorageBase(const ColumnMetadata & aMetadata, std::pmr::memory_resource * aResource) :
+        mMetadata{&aMetadata},
+        mResource{aResource}
+    {}
+
+    // The only virtual member, so the storages can be owned via a pointer to the base.
     virtual ~StorageBase() = default;
 
     template <class T_data>
     Storage<T_data> & as();
 
     template <class T_data>
-    T_data & get(EntityIndex aElementId);
+    const Storage<T_data> & as() const;
+
+    template <class T_data>
+    ComponentRef_t<T_data> get(EntityIndex aElementId);
+
+    const ColumnMetadata & getMetadata() const
+    { return *mMetadata; }
+
+    /// \brief The memory resource providing the buffers of this storage.
+    std::pmr::memory_resource * getResource() const
+    { return mResource; }
+
+    std::size_t size() const
+    { return mMetadata->mCount(*this); }
+
+    std::size_t capacity() const
+    { return mMetadata->mCapacity(*this); }
+
+    void reserve(std::size_t aCapacity)
+    { mMetadata->mReserve(*this, aCapacity); }
 
-    virtual std::size_t size() const = 0;
-    virtual void * data() = 0;
-    virtual std::unique_ptr<StorageBase> cloneEmpty() const = 0;
-    virtual std::unique_ptr<StorageBase> clone() const = 0;
+    void shrink(std::size_t aCapacity)
+    { mMetadata->mShrink(*this, aCapacity); }
+
+    /// \return nullptr if the storage is not a single contiguous array (chunked or struct of arrays).
+    void * data()
+    { return mMetadata->mData(*this); }
+
+    /// \brief Make an empty storage of the same component type, using the same memory resource.
+    std::unique_ptr<StorageBase> cloneEmpty() const
+    { return mMetadata->mMakeEmpty(mResource); }
+
+    std::unique_ptr<StorageBase> clone() const
+    { return mMetadata->mClone(*this); }
+
+    // Note: pushes back into this storage, but do not remove from source.
+    // Archetype::remove() will take care of that removal.
     /// \brief Move data from aSource, pushing it a the back of this storage.
-    virtual void moveFrom(EntityIndex aSourceIndex, StorageBase & aSource) = 0;
+    void moveFrom(EntityIndex aSourceIndex, StorageBase & aSource)
+    {
+        assert(mMetadata == aSource.mMetadata);
+        mMetadata->mMoveBack(*this, aSource, aSourceIndex);
+    }
+
     /// \brief Copy data from aSource, pushing it a the back of this storage.
-    virtual void copyFrom(EntityIndex aSourceIndex, StorageBase & aSource) = 0;
+    void copyFrom(EntityIndex aSourceIndex, const StorageBase & aSource)
+    {
+        assert(mMetadata == aSource.mMetadata);
+        mMetadata->mCopyBack(*this, aSource, aSourceIndex);
+    }
 
-    virtual void remove(EntityIndex aSourceIndex) = 0;
+    void remove(EntityIndex aSourceIndex)
+    { mMetadata->mRemove(*this, aSourceIndex); }
 
-    /// Intended for use with tests, to ensure the consistency of an Archetype.
-    virtual ComponentId getType() = 0;
+    /// \brief Apply each relocation in order, then truncate the storage to `aNewSize`.
+    void compact(std::span<const Relocation> aRelocations, std::size_t aNewSize)
+    { mMetadata->mCompact(*this, aRelocations, aNewSize); }
 
+    /// Intended for use with tests, to ensure the consistency of an Archetype.
+    ComponentId getType() const
+    { return mMetadata->mId; }
 
 private:
-    // TODO cache the pointer instead of virtual function,
+    // TODO cache the pointer to the data,
     // but does not work with vectors since insertion can invalidate
-    //void * mData;
+    const ColumnMetadata * mMetadata;
+    std::pmr::memory_resource * mResource;
 };
 
 
 template <class T_component>
 class Storage : public StorageBase
 {
-public:
-    std::size_t size() const override
-    { return mArray.size(); }
+    static_assert(!(UseChunkedStorage<T_component>::value && SoaComponent<T_component>),
+                  "A component cannot be stored both in chunks and as a struct of arrays.");
 
-    void * data() override
-    { return mArray.data(); }
+public:
+    explicit Storage(std::pmr::memory_resource * aResource = std::pmr::get_default_resource()) :
+        StorageBase{GetMetadata(), aResource},
+        mArray(aResource)
+    {}
 
     /// @brief Non-virtual function, to access the underlying array when a fully typed Storage is available.
+    /// \return A reference to the component, or a SoaRef for a SoaComponent.
+    decltype(auto) operator[](std::size_t aIndex)
+    { return mArray[aIndex]; }
+
+    decltype(auto) operator[](std::size_t aIndex) const
+    { return mArray[aIndex]; }
+
+    /// \brief The contiguous array of the components, as a std::span, or a SoaSpan for a SoaComponent.
+    auto batch()
+    {
+        static_assert(!UseChunkedStorage<T_component>::value, "Chunked storages are not contiguous.");
+        if constexpr (SoaComponent<T_component>)
+        {
+            return SoaSpan<T_component>{mArray};
+        }
+        else
+        {
+            return std::span<T_component>{mArray};
+        }
+    }
+
+    static const ColumnMetadata & GetMetadata();
+
+    using Array_t = std::conditional_t<UseChunkedStorage<T_component>::value,
+                                       detail::ChunkedVector<T_component,
+                                                             ColumnAlignment<T_component>::value>,
+                                       std::conditional_t<SoaComponent<T_component>,
+                                                          detail::SoaVector<T_component>,
+                                                          detail::ColumnVector<T_component>>>;
+
+    // Client should not be able to get access to Storage instances at all
+//private:
+    Array_t mArray;
+
+private:
+    static void moveBack(StorageBase & aDestination, StorageBase & aSource, EntityIndex aSourceIndex);
+    static void copyBack(StorageBase & aDestination, const StorageBase & aSource, EntityIndex aSourceIndex);
+};
+
+
+/// \brief Storage of tag components, which have no column in the archetypes.
+///
+/// It mimics the indexing of the other storages, all indices designating the same shared instance,
+/// so iterating a query does not special case the tags.
+template <TagComponent T_component>
+class Storage<T_component>
+{
+public:
+    struct Array_t
+    {
+        T_component & operator[](std::size_t /*aIndex*/) const
+        { return GetInstance(); }
+    };
+
     T_component & operator[](std::size_t aIndex)
     { return mArray[aIndex]; }
 
     const T_component & operator[](std::size_t aIndex) const
     { return mArray[aIndex]; }
 
-    std::unique_ptr<StorageBase> cloneEmpty() const override
-    { return std::make_unique<Storage<T_component>>(); }
+    /// \brief The single storage of T_component, shared by all archetypes with this tag.
+    static Storage & GetShared()
+    {
+        static Storage shared;
+        return shared;
+    }
 
-    std::unique_ptr<StorageBase> clone() const override
-    { return std::make_unique<Storage<T_component>>(*this); }
+    Array_t mArray;
 
-    // Note: pushes back into mArray, but do not remove from source.
-    // Archetype::remove() will take care of that removal.
-    void moveFrom(EntityIndex aSourceIndex, StorageBase & aSource) override
-    { mArray.push_back(std::move(aSource.get<T_component>(aSourceIndex))); }
+private:
+    static T_component & GetInstance()
+    {
+        static T_component instance{};
+        return instance;
+    }
+};
 
-    void copyFrom(EntityIndex aSourceIndex, StorageBase & aSource) override
-    { mArray.push_back(T_component{aSource.get<T_component>(aSourceIndex)}); }
 
-    void remove(EntityIndex aSourceIndex) override;
+/// \brief View of the sparse set of a sparse component, indexed by the position of the entities in an archetype.
+///
+/// It mimics the indexing of the other storages, so iterating a query does not special case sparse components.
+/// The entities of the archetype are not required to have the component, see contains().
+template <SparseComponent T_component>
+class Storage<T_component>
+{
+public:
+    struct Array_t
+    {
+        T_component & operator[](std::size_t aIndex) const
+        { return mSet->get((*mHandles)[aIndex]); }
 
-    ComponentId getType() override;
+        detail::SparseSet<T_component> * mSet;
+        const EntityHandles * mHandles;
+    };
 
-    // Client should not be able to get access to Storage instances at all
-//private:
-    std::vector<T_component> mArray;
+    Storage(detail::SparseSet<T_component> & aSet, const EntityHandles & aHandles) :
+        mArray{&aSet, &aHandles}
+    {}
+
+    T_component & operator[](std::size_t aIndex)
+    { return mArray[aIndex]; }
+
+    const T_component & operator[](std::size_t aIndex) const
+    { return mArray[aIndex]; }
+
+    /// \brief Return whether the entity at `aIndex` in the archetype has the component.
+    bool contains(std::size_t aIndex) const
+    { return mArray.mSet->contains((*mArray.mHandles)[aIndex]); }
+
+    Array_t mArray;
 };
 
 
@@ -127,6 +314,74 @@ private:
 class EntityManager; //forward
 
 
+/// \brief Cached transition from an Archetype to the Archetype obtained by adding or removing a single component.
+///
+/// Each Archetype keeps its outgoing edges, so a structural change does not rebuild and look up a TypeSet.
+struct ArchetypeEdge
+{
+    /// \brief Marks the source stores without a matching store in the destination.
+    static constexpr std::size_t gNoColumn = std::numeric_limits<std::size_t>::max();
+
+    HandleKey<Archetype> mDestination;
+    /// \brief For each store of the source archetype, the index of the store of the same component
+    /// in the destination archetype, or gNoColumn.
+    std::vector<std::size_t> mColumnMapping;
+};
+
+
+/// \brief When the archetypes give back the memory of their removed entities.
+struct ShrinkPolicy
+{
+    enum class Mode
+    {
+        /// \brief Only EntityManager::shrinkToFit() releases memory.
+        Manual,
+        /// \brief An archetype is trimmed when its entities occupy less than 1 / mTrimRatio of its capacity,
+        /// down to twice its count of entities.
+        /// The gap between both thresholds prevents an archetype oscillating around a size
+        /// from reallocating on each cycle.
+        Hysteresis,
+    };
+
+    Mode mMode{Mode::Manual};
+    std::size_t mTrimRatio{4};
+    /// \brief The archetypes are never automatically trimmed below this capacity.
+    std::size_t mMinimumCapacity{64};
+};
+
+
+/// \brief When the archetypes without entities are destroyed, see EntityManager::reclaimEmptyArchetypes().
+struct ReclaimPolicy
+{
+    enum class Mode
+    {
+        /// \brief Only EntityManager::reclaimEmptyArchetypes() destroys archetypes.
+        Manual,
+        /// \brief At the end of each Phase deferring operations on entities of the manager,
+        /// the archetypes found empty at the end of mMinimumAge consecutive such phases are destroyed.
+        /// With the default age of 1, the archetypes emptied by a phase are destroyed when it ends.
+        PhaseEnd,
+    };
+
+    Mode mMode{Mode::Manual};
+    /// \brief A higher age keeps the archetypes of transient component combinations,
+    /// for entities oscillating between archetypes over a few phases.
+    std::size_t mMinimumAge{1};
+};
+
+
+/// \brief Memory usage of an Archetype, see EntityManager::getArchetypeStatistics().
+struct ArchetypeStatistics
+{
+    TypeSet mTypeSet;
+    std::size_t mEntityCount;
+    /// \brief The count of entities which can be stored without reallocating.
+    std::size_t mCapacity;
+    /// \brief The highest count of entities stored at once, since the archetype was created.
+    std::size_t mHighWaterMark;
+};
+
+
 /// \brief Actual storage for the different components of an Archetype.
 ///
 /// It is a light wrapper around a vector of unique_ptrs, with the added
@@ -157,17 +412,45 @@ private:
 class Archetype
 {
 public:
+    enum class Transition
+    {
+        Add,
+        Remove,
+    };
+
+    Archetype() :
+        Archetype{std::pmr::get_default_resource()}
+    {}
+
+    /// \brief Construct an empty archetype, whose stores and handles are allocated from `aResource`.
+    explicit Archetype(std::pmr::memory_resource * aResource) :
+        mHandles(aResource),
+        mResource{aResource}
+    {}
+
+    std::pmr::memory_resource * getResource() const
+    { return mResource; }
+
     //std::size_t getSize() const
     //{ return mSize; }
     TypeSet getTypeSet() const
-    { return {mType.begin(), mType.end()}; }
+    {
+        TypeSet result{mType.begin(), mType.end()};
+        result.insert(mTags.begin(), mTags.end());
+        return result;
+    }
 
-    /// \brief Constructs an Archetype which extends this Archetype with component T_component
-    template <class T_component>
+    /// \brief Constructs an Archetype with exactly the components VT_components, allocating from `aResource`.
+    template <class... VT_components>
+    static std::unique_ptr<Archetype> makeWith(std::pmr::memory_resource * aResource);
+
+    /// \brief Constructs an Archetype which extends this Archetype with components VT_components
+    /// \details The components already present in this Archetype are not duplicated.
+    template <class... VT_components>
     std::unique_ptr<Archetype> makeExtended() const;
 
-    /// \brief Constructs an Archetype which restricts this Archetype, excluding component T_component
-    template <class T_component>
+    /// \brief Constructs an Archetype which restricts this Archetype, excluding components VT_components
+    template <class... VT_components>
     std::unique_ptr<Archetype> makeRestricted() const;
 
     std::size_t countEntities() const;
@@ -176,10 +459,42 @@ public:
     bool has() const;
 
     template <class T_component>
-    T_component & get(EntityIndex aEntityIndex);
+    ComponentRef_t<T_component> get(EntityIndex aEntityIndex);
 
     void remove(EntityIndex aEntityIndex, EntityManager & aManager);
 
+    /// \brief Remove all the entities at `aEntityIndices`, which must be strictly increasing.
+    /// \details The holes are filled with the last remaining entities, as remove() does,
+    /// but each store is compacted in a single pass.
+    /// The records of the relocated entities are updated.
+    void removeMany(std::span<const EntityIndex> aEntityIndices, EntityManager & aManager);
+
+    /// \brief Return whether `aFlag` is set for the entity at `aEntityIndex`.
+    bool testFlag(EntityIndex aEntityIndex, Flag aFlag) const
+    {
+        assert(aFlag < gMaxFlags && aEntityIndex < countEntities());
+        return mFlags[aFlag].test(aEntityIndex);
+    }
+
+    /// \brief Set `aFlag` to `aValue` for the entity at `aEntityIndex`.
+    /// \note This does not change the list of entities, so it is allowed during iteration.
+    /// \warning Thread unsafe with respect to other flag writes in this archetype:
+    /// the bits of consecutive entities share a word.
+    void setFlag(EntityIndex aEntityIndex, Flag aFlag, bool aValue)
+    {
+        assert(aFlag < gMaxFlags && aEntityIndex < countEntities());
+        if (aValue)
+        {
+            mUsedFlags = std::max<std::size_t>(mUsedFlags, aFlag + 1);
+        }
+        mFlags[aFlag].set(aEntityIndex, aValue);
+    }
+
+    /// \brief Select the entities passing `aFilter`, among the entities of word `aWordIndex` in the flag columns.
+    /// \return A bit per entity, bit `n` corresponding to the entity at `aWordIndex * gWordBits + n`.
+    /// \attention implementation detail, intended for use by Query iteration.
+    detail::BitColumn::Word selectFlagged(const FlagFilter & aFilter, std::size_t aWordIndex) const;
+
     /// \brief Intended for tests, makes sure that each handle in this Archetype
     /// corresponds to an Entity whose archetype is this instance.
     bool verifyHandlesConsistency(EntityManager & aManager);
@@ -198,15 +513,86 @@ public:
               Archetype & aDestination,
               EntityManager & aManager);
 
+    /// \brief Move an entity along `aColumnMapping`, which must be the mapping of an edge from `this` to `aDestination`.
+    /// \details Same as move() above, without matching the components of both archetypes.
+    void move(EntityIndex aEntityIndex,
+              Archetype & aDestination,
+              std::span<const std::size_t> aColumnMapping,
+              EntityManager & aManager);
+
     void copy(EntityIndex aSourceEntityIndex, HandleKey<Entity> aDestHandle, Archetype & aDestination, EntityManager & aManager);
 
+    void copy(EntityIndex aSourceEntityIndex,
+              HandleKey<Entity> aDestHandle,
+              Archetype & aDestination,
+              std::span<const std::size_t> aColumnMapping,
+              EntityManager & aManager);
+
+    /// \brief Return the edge for `aTransition` of component `aComponent`, or nullptr if it is not cached yet.
+    const ArchetypeEdge * findEdge(Transition aTransition, ComponentId aComponent) const;
+
+    /// \brief Cache the edge for `aTransition` of component `aComponent`, leading to `aDestination`.
+    /// \details The column mapping is computed once, here.
+    /// \return The inserted edge, which stays valid until the next edge insertion in this archetype.
+    const ArchetypeEdge & insertEdge(Transition aTransition,
+                                     ComponentId aComponent,
+                                     HandleKey<Archetype> aDestinationKey,
+                                     const Archetype & aDestination);
+
+    /// \brief Remove the cached edges leading to any of the archetypes in `aDestinations`.
+    void eraseEdgesTo(std::span<const HandleKey<Archetype>> aDestinations);
+
+    /// \brief For each store of `this` archetype, the index of the store of the same component in `aDestination`.
+    /// \see ArchetypeEdge::mColumnMapping
+    std::vector<std::size_t> computeColumnMapping(const Archetype & aDestination) const;
+
     template <class T_component>
     EntityIndex push(T_component aComponent);
 
-    /// \attention For use by the EntityManager on the empty archetype only.
+    /// \brief Construct a T_component from `aArgs` directly at the back of its store.
+    template <class T_component, class... VT_args>
+    EntityIndex emplace(VT_args &&... aArgs);
+
+    /// \attention For use by the EntityManager, after it pushed all the components of the entity.
     void pushKey(HandleKey<Entity> aKey);
 
+    /// \brief Ensure that `aCount` calls to pushKey() will not reallocate.
+    /// \attention For use by the EntityManager on the empty archetype only.
+    void reserveKeys(std::size_t aCount)
+    { mHandles.reserve(mHandles.size() + aCount); }
+
+    /// \brief Ensure that `aCount` more entities can be stored without reallocating the handles nor the stores.
+    void reserve(std::size_t aCount);
+
+    /// \brief The count of entities which can be stored without reallocating the handles.
+    std::size_t capacity() const
+    { return mHandles.capacity(); }
+
+    /// \brief Reduce the capacity of the handles and stores to `aCapacity`, but not below the count of entities.
+    void shrink(std::size_t aCapacity);
+
+    void shrinkToFit()
+    { shrink(countEntities()); }
+
+    /// \brief Trim the capacity if `aPolicy` requires it, given the current count of entities.
+    void applyShrinkPolicy(const ShrinkPolicy & aPolicy);
+
+    /// \brief The highest count of entities stored at once in this archetype.
+    std::size_t getHighWaterMark() const
+    { return mHighWaterMark; }
+
+    /// \brief Count the end of a phase, see ReclaimPolicy::Mode::PhaseEnd.
+    /// \return The count of consecutive phase ends at which this archetype was empty.
+    std::size_t agePhaseEnd()
+    { return mEmptyAge = (countEntities() == 0 ? mEmptyAge + 1 : 0); }
+
+    /// \brief The store index of the tag components, which have no store in the archetype.
+    static constexpr std::size_t gTagStoreIndex = std::numeric_limits<std::size_t>::max();
+    /// \brief The store index of the sparse components, which are stored outside of the archetypes.
+    static constexpr std::size_t gSparseStoreIndex = gTagStoreIndex - 1;
+
     // TODO should not be public, this is an implementation detail for queries
+    /// \return gTagStoreIndex if T_component is a tag, gSparseStoreIndex if it is a sparse component.
     template <class T_component>
     StorageIndex<T_component> getStoreIndex() const;
 
@@ -214,7 +600,7 @@ public:
     Storage<T_component> & getStorage(StorageIndex<T_component> aComponentIndex);
 
     /// \attention implementation detail, intended for use by Query iteration.
-    const std::vector<HandleKey<Entity>> & getEntityIndices() const
+    const EntityHandles & getEntityIndices() const
     { return mHandles; }
 
 #if defined(ENTITY_SANITIZE)
@@ -230,21 +616,64 @@ private:
 
     /// \brief base template for archetype copy and move
     template<Operation N_operation>
-    void moveOrCopy(EntityIndex aSourceEntityIndex, Archetype & aDestination, EntityManager & aManager);
+    void moveOrCopy(EntityIndex aSourceEntityIndex,
+                    Archetype & aDestination,
+                    std::span<const std::size_t> aColumnMapping);
+
+    // Sorted by ComponentId.
+    using EdgeList = std::vector<std::pair<ComponentId, ArchetypeEdge>>;
 
-    std::unique_ptr<Archetype> makeRestrictedFromTypeId(const ComponentId aId) const;
+    EdgeList & edges(Transition aTransition)
+    { return aTransition == Transition::Add ? mAddEdges : mRemoveEdges; }
+
+    const EdgeList & edges(Transition aTransition) const
+    { return aTransition == Transition::Add ? mAddEdges : mRemoveEdges; }
+
+    std::unique_ptr<Archetype> makeRestrictedFromTypeIds(std::span<const ComponentId> aIds) const;
+
+    /// \brief Add T_component to the type of this archetype, with a store unless it is a tag.
+    template <class T_component>
+    void appendComponent();
+
+    /// \brief Set the flags of the entity at `aDestinationIndex` in `aDestination`
+    /// to the flags of the entity at `aSourceIndex` in this archetype.
+    void copyFlags(EntityIndex aSourceIndex, Archetype & aDestination, EntityIndex aDestinationIndex) const;
 
 
     /// \brief Intended for tests, makes sure that each store size matche the count of handles.
     bool checkStoreSize() const;
 
+    /// \brief Push the handle of an entity whose components were pushed to the stores.
+    void pushHandle(HandleKey<Entity> aKey)
+    {
+        mHandles.push_back(aKey);
+        mHighWaterMark = std::max(mHighWaterMark, mHandles.size());
+    }
+
     //std::size_t mSize{0};
     // TODO cache typeset, or even better only have a typeset, so the components are ordered
     //TypeSet mTypeSet;
+    // The components with a store, in the same order than mStores.
     std::vector<ComponentId> mType;
     DataStore mStores;
+    // The tag components, which are only part of the signature.
+    std::vector<ComponentId> mTags;
     // The handles of the entities stored in this archetype, in the same order than in each Store.
-    std::vector<HandleKey<Entity>> mHandles;
+    EntityHandles mHandles;
+    // One bit column per flag, in the same order than the handles.
+    std::array<detail::BitColumn, gMaxFlags> mFlags;
+    // One past the highest flag ever set in this archetype: the columns past it do not need maintenance.
+    std::size_t mUsedFlags{0};
+    // The transitions already taken from this archetype.
+    // The edges to a destroyed archetype are erased (see eraseEdgesTo()), so the destinations stay valid
+    // (and are copied alongside the archetypes when the state is saved).
+    EdgeList mAddEdges;
+    EdgeList mRemoveEdges;
+    std::size_t mHighWaterMark{0};
+    // The count of consecutive phase ends at which the archetype was empty.
+    std::size_t mEmptyAge{0};
+    // Provides the buffers of the stores and of the handles.
+    std::pmr::memory_resource * mResource;
 };
 
 
@@ -255,21 +684,82 @@ private:
 namespace detail
 {
 
+    /// \brief Move `aSource` onto `aDestination`, which are both live elements.
+    /// \details Overloaded for the proxies to the elements of a struct of arrays, see Soa.h.
     template <class T_element>
-    void eraseByMoveOver(std::vector<T_element> & aVector, std::size_t aErasedIndex)
+    void relocate(T_element & aDestination, T_element & aSource)
+    {
+        aDestination = std::move(aSource);
+    }
+
+
+    template <class>
+    struct IsVector : std::false_type
+    {};
+
+    template <class T_element, class T_allocator>
+    struct IsVector<std::vector<T_element, T_allocator>> : std::true_type
+    {};
+
+
+    /// \brief Reduce the capacity of `aArray` to `aCapacity`, but not below its size.
+    /// \details Unlike std::vector::shrink_to_fit(), this is binding.
+    template <class T_array>
+    void shrinkCapacity(T_array & aArray, std::size_t aCapacity)
+    {
+        aCapacity = std::max(aCapacity, aArray.size());
+        if constexpr (IsVector<T_array>::value)
+        {
+            if (aArray.capacity() > aCapacity)
+            {
+                T_array shrunk(aArray.get_allocator());
+                shrunk.reserve(aCapacity);
+                for (auto & element : aArray)
+                {
+                    shrunk.push_back(std::move(element));
+                }
+                aArray = std::move(shrunk);
+            }
+        }
+        else
+        {
+            aArray.shrink(aCapacity);
+        }
+    }
+
+
+    template <class T_array>
+    void eraseByMoveOver(T_array & aArray, std::size_t aErasedIndex)
     {
-        assert(aVector.size() > aErasedIndex);
+        assert(aArray.size() > aErasedIndex);
 
         // Implementer note:
         // This method moves the last element of the store onto the removed index,
         // then it erases the last element.
+        if (aErasedIndex != aArray.size() - 1)
+        {
+            relocate(aArray[aErasedIndex], aArray.back());
+        }
+        aArray.pop_back();
+    }
 
-        auto elementIt = aVector.begin() + aErasedIndex;
-        // Can only remove from a non-empty storage, so end()-1 must be valid.
-        auto backIt = aVector.end() - 1;
 
-        std::move(backIt, aVector.end(), elementIt);
-        aVector.pop_back();
+    template <class T_array>
+    void compactByRelocation(T_array & aArray,
+                             std::span<const Relocation> aRelocations,
+                             std::size_t aNewSize)
+    {
+        assert(aArray.size() >= aNewSize);
+
+        for (auto [source, destination] : aRelocations)
+        {
+            relocate(aArray[destination], aArray[source]);
+        }
+        // Note: not resize(), which would require default constructible elements.
+        while (aArray.size() > aNewSize)
+        {
+            aArray.pop_back();
+        }
     }
 
 
@@ -279,105 +769,294 @@ namespace detail
 template <class T_data>
 Storage<T_data> & StorageBase::as()
 {
-    assert(getId<T_data>() == this->getType());
-    return *reinterpret_cast<Storage<T_data> *>(this);
+    assert(mMetadata == &Storage<T_data>::GetMetadata());
+    return *static_cast<Storage<T_data> *>(this);
+}
+
+
+template <class T_data>
+const Storage<T_data> & StorageBase::as() const
+{
+    assert(mMetadata == &Storage<T_data>::GetMetadata());
+    return *static_cast<const Storage<T_data> *>(this);
 }
 
 
 template <class T_data>
-T_data & StorageBase::get(EntityIndex aElementId)
+ComponentRef_t<T_data> StorageBase::get(EntityIndex aElementId)
 {
     return as<T_data>().mArray[aElementId];
 }
 
 
 template <class T_component>
-void Storage<T_component>::remove(EntityIndex aSourceIndex)
+const ColumnMetadata & Storage<T_component>::GetMetadata()
 {
-    detail::eraseByMoveOver(mArray, aSourceIndex);
+    // Function local static, so it is initialized before any Storage uses it,
+    // even from static initialization.
+    static const ColumnMetadata metadata{
+        .mId = getId<T_component>(),
+        .mMakeEmpty = [](std::pmr::memory_resource * aResource) -> std::unique_ptr<StorageBase>
+        {
+            return std::make_unique<Storage<T_component>>(aResource);
+        },
+        .mClone = [](const StorageBase & aStorage) -> std::unique_ptr<StorageBase>
+        {
+            if constexpr (std::is_copy_constructible_v<T_component>)
+            {
+                return std::make_unique<Storage<T_component>>(aStorage.as<T_component>());
+            }
+            else
+            {
+                throw std::logic_error{"Cannot clone the storage of a non-copyable component."};
+            }
+        },
+        .mCount = [](const StorageBase & aStorage) -> std::size_t
+        {
+            return aStorage.as<T_component>().mArray.size();
+        },
+        .mCapacity = [](const StorageBase & aStorage) -> std::size_t
+        {
+            return aStorage.as<T_component>().mArray.capacity();
+        },
+        .mReserve = [](StorageBase & aStorage, std::size_t aCapacity)
+        {
+            aStorage.as<T_component>().mArray.reserve(aCapacity);
+        },
+        .mShrink = [](StorageBase & aStorage, std::size_t aCapacity)
+        {
+            detail::shrinkCapacity(aStorage.as<T_component>().mArray, aCapacity);
+        },
+        .mData = [](StorageBase & aStorage) -> void *
+        {
+            if constexpr (UseChunkedStorage<T_component>::value || SoaComponent<T_component>)
+            {
+                return nullptr;
+            }
+            else
+            {
+                return aStorage.as<T_component>().mArray.data();
+            }
+        },
+        .mMoveBack = &Storage<T_component>::moveBack,
+        .mCopyBack = &Storage<T_component>::copyBack,
+        .mRemove = [](StorageBase & aStorage, EntityIndex aIndex)
+        {
+            detail::eraseByMoveOver(aStorage.as<T_component>().mArray, aIndex);
+        },
+        .mCompact = [](StorageBase & aStorage, std::span<const Relocation> aRelocations, std::size_t aNewSize)
+        {
+            detail::compactByRelocation(aStorage.as<T_component>().mArray, aRelocations, aNewSize);
+        },
+    };
+    return metadata;
 }
 
 
 template <class T_component>
-ComponentId Storage<T_component>::getType()
+void Storage<T_component>::moveBack(StorageBase & aDestination, StorageBase & aSource, EntityIndex aSourceIndex)
 {
-    return getId<T_component>();
+    aDestination.as<T_component>().mArray.push_back(std::move(aSource.as<T_component>().mArray[aSourceIndex]));
 }
 
 
 template <class T_component>
+void Storage<T_component>::copyBack(StorageBase & aDestination, const StorageBase & aSource, EntityIndex aSourceIndex)
+{
+    // Move-only components can be stored, as long as their entities are not copied
+    // (and the EntityManager state is not saved).
+    if constexpr (std::is_copy_constructible_v<T_component>)
+    {
+        aDestination.as<T_component>().mArray.push_back(T_component{aSource.as<T_component>().mArray[aSourceIndex]});
+    }
+    else
+    {
+        throw std::logic_error{"Cannot copy a non-copyable component."};
+    }
+}
+
+
+inline detail::BitColumn::Word Archetype::selectFlagged(const FlagFilter & aFilter,
+                                                       std::size_t aWordIndex) const
+{
+    using Word = detail::BitColumn::Word;
+    constexpr std::size_t wordBits = detail::BitColumn::gWordBits;
+
+    assert(aWordIndex * wordBits < countEntities());
+    const std::size_t remaining = countEntities() - aWordIndex * wordBits;
+    Word selected = remaining >= wordBits ? ~Word{0} : (Word{1} << remaining) - 1;
+
+    for (FlagSet required = aFilter.mRequired; required != 0; required &= required - 1)
+    {
+        selected &= mFlags[std::countr_zero(required)].word(aWordIndex);
+    }
+    for (FlagSet excluded = aFilter.mExcluded; excluded != 0; excluded &= excluded - 1)
+    {
+        selected &= ~mFlags[std::countr_zero(excluded)].word(aWordIndex);
+    }
+    return selected;
+}
+
+
+inline const ArchetypeEdge * Archetype::findEdge(Transition aTransition, ComponentId aComponent) const
+{
+    const EdgeList & list = edges(aTransition);
+    auto found = std::lower_bound(list.begin(), list.end(), aComponent,
+                                  [](const auto & aEdge, ComponentId aId)
+                                  {
+                                      return aEdge.first < aId;
+                                  });
+    if (found != list.end() && found->first == aComponent)
+    {
+        return &found->second;
+    }
+    return nullptr;
+}
+
+
+template <class... VT_components>
+std::unique_ptr<Archetype> Archetype::makeWith(std::pmr::memory_resource * aResource)
+{
+    auto result = std::make_unique<Archetype>(aResource);
+    (result->template appendComponent<VT_components>(), ...);
+    return result;
+}
+
+
+template <class... VT_components>
 std::unique_ptr<Archetype> Archetype::makeExtended() const
 {
     // TODO reuse the typeset already computed in the calling code
     // once we directly stores the typeset in the Archetype.
-    auto result = std::make_unique<Archetype>();
+    auto result = std::make_unique<Archetype>(mResource);
     result->mType = mType;
-    result->mType.push_back(getId<T_component>());
+    result->mTags = mTags;
 
     for (const auto & store : mStores)
     {
         result->mStores.push_back(store->cloneEmpty());
     }
-    result->mStores.push_back(std::make_unique<Storage<T_component>>());
+
+    ([&result, this]()
+    {
+        if (!has<VT_components>())
+        {
+            result->template appendComponent<VT_components>();
+        }
+    }(), ...);
 
     return result;
 }
 
 
-template <class T_component>
+template <class... VT_components>
 std::unique_ptr<Archetype> Archetype::makeRestricted() const
 {
-    ComponentId retired = getId<T_component>();
-    return makeRestrictedFromTypeId(retired);
+    const ComponentId retired[] = {getId<VT_components>()...};
+    return makeRestrictedFromTypeIds(retired);
+}
+
+template <class T_component>
+void Archetype::appendComponent()
+{
+    static_assert(!SparseComponent<T_component>,
+                  "Sparse components are not part of the archetypes, they are added to existing entities.");
+
+    if constexpr (TagComponent<T_component>)
+    {
+        mTags.push_back(getId<T_component>());
+    }
+    else
+    {
+        mType.push_back(getId<T_component>());
+        mStores.push_back(std::make_unique<Storage<T_component>>(mResource));
+    }
 }
 
+
 template <class T_component>
 bool Archetype::has() const
 {
-    return std::find(mType.begin(), mType.end(), getId<T_component>()) != mType.end();
+    const std::vector<ComponentId> & components = TagComponent<T_component> ? mTags : mType;
+    return std::find(components.begin(), components.end(), getId<T_component>()) != components.end();
 }
 
 
 template <class T_component>
-T_component & Archetype::get(EntityIndex aEntityIndex)
+ComponentRef_t<T_component> Archetype::get(EntityIndex aEntityIndex)
 {
     assert(has<T_component>());
 
-    for(std::size_t storeId = 0; storeId != mType.size(); ++storeId)
+    if constexpr (TagComponent<T_component>)
     {
-        if(mType[storeId] == getId<T_component>())
+        return Storage<T_component>::GetShared()[aEntityIndex];
+    }
+    else
+    {
+        for(std::size_t storeId = 0; storeId != mType.size(); ++storeId)
         {
-            return mStores[storeId]->get<T_component>(aEntityIndex);
+            if(mType[storeId] == getId<T_component>())
+            {
+                return mStores[storeId]->get<T_component>(aEntityIndex);
+            }
         }
-    }
 
-    // TODO not sure if we should ressort to exception for this kind of situations?
-    throw std::logic_error("Archetype does not have requested component.");
+        // TODO not sure if we should ressort to exception for this kind of situations?
+        throw std::logic_error("Archetype does not have requested component.");
+    }
 }
 
 
 template <class T_component>
 EntityIndex Archetype::push(T_component aComponent)
+{
+    return emplace<T_component>(std::move(aComponent));
+}
+
+
+template <class T_component, class... VT_args>
+EntityIndex Archetype::emplace(VT_args &&... aArgs)
 {
     assert(has<T_component>());
 
-    for(std::size_t storeId = 0; storeId != mType.size(); ++storeId)
+    if constexpr (TagComponent<T_component>)
     {
-        if(mType[storeId] == getId<T_component>())
+        // Nothing is stored for a tag, the arguments are discarded.
+        ((void)aArgs, ...);
+        return mHandles.size();
+    }
+    else
+    {
+        for(std::size_t storeId = 0; storeId != mType.size(); ++storeId)
         {
-            auto & components = mStores[storeId]->as<T_component>().mArray;
-            components.push_back(std::move(aComponent));
-            return components.size() - 1;
+            if(mType[storeId] == getId<T_component>())
+            {
+                auto & components = mStores[storeId]->as<T_component>().mArray;
+                components.emplace_back(std::forward<VT_args>(aArgs)...);
+                return components.size() - 1;
+            }
         }
-    }
 
-    throw std::logic_error("Archetype does not have requested component.");
+        throw std::logic_error("Archetype does not have requested component.");
+    }
 }
 
 
 template <class T_component>
 StorageIndex<T_component> Archetype::getStoreIndex() const
 {
+    if constexpr (SparseComponent<T_component>)
+    {
+        return gSparseStoreIndex;
+    }
+    else if constexpr (TagComponent<T_component>)
+    {
+        if (has<T_component>())
+        {
+            return gTagStoreIndex;
+        }
+    }
+
     for(std::size_t storeId = 0; storeId != mType.size(); ++storeId)
     {
         if(mType[storeId] == getId<T_component>())
@@ -392,7 +1071,18 @@ StorageIndex<T_component> Archetype::getStoreIndex() const
 template <class T_component>
 Storage<T_component> & Archetype::getStorage(StorageIndex<T_component> aComponentIndex)
 {
-    return mStores[aComponentIndex]->template as<T_component>();
+    static_assert(!SparseComponent<T_component>,
+                  "Sparse components are stored outside of the archetypes.");
+
+    if constexpr (TagComponent<T_component>)
+    {
+        assert(aComponentIndex == gTagStoreIndex);
+        return Storage<T_component>::GetShared();
+    }
+    else
+    {
+        return mStores[aComponentIndex]->template as<T_component>();
+    }
 }
 
 } // namespace ent
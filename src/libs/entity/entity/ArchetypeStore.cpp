@@ -8,10 +8,12 @@ namespace ent {
 ArchetypeStore & ArchetypeStore::operator=(const ArchetypeStore & aRhs)
 {
     mTypeSetToArchetype = aRhs.mTypeSetToArchetype;
+    mResource = aRhs.mResource;
+    mFreeKeys = aRhs.mFreeKeys;
     mHandleToArchetype.clear();
     for(const auto & archetypePtr : aRhs.mHandleToArchetype)
     {
-        mHandleToArchetype.push_back(std::make_unique<Archetype>(*archetypePtr));
+        mHandleToArchetype.push_back(archetypePtr ? std::make_unique<Archetype>(*archetypePtr) : nullptr);
     }
     return *this;
 }
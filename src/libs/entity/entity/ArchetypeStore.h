@@ -7,8 +7,11 @@
 
 #include <map>
 #include <memory>
+#include <memory_resource>
 #include <vector>
 
+#include <cassert>
+
 
 namespace ad {
 namespace ent {
@@ -17,6 +20,12 @@ namespace ent {
 class ArchetypeStore
 {
 public:
+    /// \brief The archetypes allocate their stores and handles from `aResource`.
+    explicit ArchetypeStore(std::pmr::memory_resource * aResource = std::pmr::get_default_resource()) :
+        mHandleToArchetype{getInitialVector(aResource)},
+        mResource{aResource}
+    {}
+
     std::pair<Archetype &, HandleKey<Archetype>> getEmptyArchetype();
 
     ArchetypeStore & operator=(const ArchetypeStore & aRhs);
@@ -31,20 +40,58 @@ public:
     auto endMap() const
     { return mTypeSetToArchetype.end(); }
 
+    /// \brief The count of live archetypes.
     auto size() const
-    { return mHandleToArchetype.size(); }
+    { return mHandleToArchetype.size() - mFreeKeys.size(); }
+
+    std::pmr::memory_resource * getResource() const
+    { return mResource; }
+
+    /// \brief Invoke `aCallback` with each live archetype, by order of their slot
+    /// (i.e. of creation, until destroyed archetypes get their slot reused).
+    template <class F_callback>
+    void forEach(F_callback && aCallback) const
+    {
+        for (const std::unique_ptr<Archetype> & archetype : mHandleToArchetype)
+        {
+            if (archetype)
+            {
+                aCallback(*archetype);
+            }
+        }
+    }
+
+    template <class F_callback>
+    void forEach(F_callback && aCallback)
+    {
+        for (std::unique_ptr<Archetype> & archetype : mHandleToArchetype)
+        {
+            if (archetype)
+            {
+                aCallback(*archetype);
+            }
+        }
+    }
 
     /// \return The HandleKey to the archetype matching `aTargetTypeSet`,
     /// and true if it was inserted, false if it was already present.
+    /// \details The slot of a destroyed archetype is reused, with the next generation of its key.
     template <class F_maker>
     std::pair<HandleKey<Archetype>, bool> makeIfAbsent(const TypeSet & aTargetTypeSet,
                                                        F_maker aMakeCallback);
 
+    /// \brief Destroy the archetypes for which `aPredicate` returns true,
+    /// and the edges leading to them from the remaining archetypes.
+    /// \details The archetype without components is never destroyed.
+    /// \return The keys of the destroyed archetypes.
+    template <class F_predicate>
+    std::vector<HandleKey<Archetype>> eraseIf(F_predicate aPredicate);
+
 private:
-    static std::vector<std::unique_ptr<Archetype>> getInitialVector()
+    static std::vector<std::unique_ptr<Archetype>> getInitialVector(std::pmr::memory_resource * aResource)
     { 
         std::vector<std::unique_ptr<Archetype>> result;
-        result.push_back(std::make_unique<Archetype>());
+        result.push_back(std::make_unique<Archetype>(aResource));
         return result;
     };
 
@@ -55,7 +102,10 @@ private:
     // Initially, we stored the archetype by value in the vector
     // Yet on reallocation, this would invalidate all reference to the archetype
     // (notably, to its vector of handles in Query::each())
-    std::vector<std::unique_ptr<Archetype>> mHandleToArchetype{getInitialVector()};
+    // The slots of destroyed archetypes are null.
+    std::vector<std::unique_ptr<Archetype>> mHandleToArchetype;
+    // The keys of the null slots, with the generation of the destroyed archetype.
+    std::vector<HandleKey<Archetype>> mFreeKeys;
     // TODO It is probably not useful to use an HandleKey here, a simple index could be better.
     std::map<TypeSet, HandleKey<Archetype>> mTypeSetToArchetype{
         {
@@ -63,6 +113,7 @@ private:
             gEmptyTypeSetArchetypeHandle, 
         }
     };
+    std::pmr::memory_resource * mResource;
 };
 
 
@@ -77,11 +128,13 @@ inline std::pair<Archetype &, HandleKey<Archetype>> ArchetypeStore::getEmptyArch
 
 inline Archetype & ArchetypeStore::get(HandleKey<Archetype> aKey)
 {
+    assert(mHandleToArchetype.at(aKey) != nullptr);
     return *mHandleToArchetype.at(aKey);
 }
 
 inline const Archetype & ArchetypeStore::get(HandleKey<Archetype> aKey) const
 {
+    assert(mHandleToArchetype.at(aKey) != nullptr);
     return *mHandleToArchetype.at(aKey);
 }
 
@@ -103,16 +156,60 @@ std::pair<HandleKey<Archetype>, bool> ArchetypeStore::makeIfAbsent(const TypeSet
     }
     else
     {
-        std::size_t insertedPosition = mHandleToArchetype.size();
-        mHandleToArchetype.push_back(aMakeCallback());
-        HandleKey<Archetype> inserted = mTypeSetToArchetype.emplace(
-            aTargetTypeSet,
-            HandleKey<Archetype>::MakeIndex(insertedPosition))
-            .first->second;
+        // Reuse the slot of a destroyed archetype if any,
+        // the next generation telling apart the keys of the destroyed archetype.
+        HandleKey<Archetype> inserted = mFreeKeys.empty() ?
+            HandleKey<Archetype>::MakeIndex(mHandleToArchetype.size())
+            : HandleKey<Archetype>{mFreeKeys.back()}.advanceGeneration();
+        std::unique_ptr<Archetype> archetype = aMakeCallback();
+        if (mFreeKeys.empty())
+        {
+            mHandleToArchetype.push_back(std::move(archetype));
+        }
+        else
+        {
+            mHandleToArchetype[inserted] = std::move(archetype);
+            mFreeKeys.pop_back();
+        }
+        mTypeSetToArchetype.emplace(aTargetTypeSet, inserted);
         return {inserted, true};
     }
 }
 
 
+template <class F_predicate>
+std::vector<HandleKey<Archetype>> ArchetypeStore::eraseIf(F_predicate aPredicate)
+{
+    std::vector<HandleKey<Archetype>> erased;
+    for (auto mapping = mTypeSetToArchetype.begin(); mapping != mTypeSetToArchetype.end();)
+    {
+        HandleKey<Archetype> key = mapping->second;
+        if (key != gEmptyTypeSetArchetypeHandle && aPredicate(*mHandleToArchetype[key]))
+        {
+#if defined(ENTITY_SANITIZE)
+            assert(mHandleToArchetype[key]->mCurrentQueryIterations == 0);
+#endif
+            erased.push_back(key);
+            mHandleToArchetype[key].reset();
+            mFreeKeys.push_back(key);
+            mapping = mTypeSetToArchetype.erase(mapping);
+        }
+        else
+        {
+            ++mapping;
+        }
+    }
+
+    if (!erased.empty())
+    {
+        forEach([&erased](Archetype & aArchetype)
+        {
+            aArchetype.eraseEdgesTo(erased);
+        });
+    }
+    return erased;
+}
+
+
 } // namespace ent
 } // namespace ad
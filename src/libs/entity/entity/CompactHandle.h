@@ -0,0 +1,80 @@
+#pragma once
+
+
+#include "Entity.h"
+#include "HandleKey.h"
+
+#include <functional>
+#include <type_traits>
+
+
+namespace ad {
+namespace ent {
+
+
+/// \brief A handle to an Entity relative to its EntityManager: it only stores the HandleKey.
+///
+/// It is half the size of Handle<Entity>, which also stores a pointer to the manager.
+/// This is intended for components storing many references to other entities
+/// (target lists, inventories, graph edges...), where the manager is known from the context.
+///
+/// A CompactHandle is resolved to a Handle<Entity> against an explicitly provided EntityManager.
+/// \attention It must be resolved against the manager of the referenced entity,
+/// which cannot be verified.
+class CompactHandle
+{
+    friend struct std::hash<CompactHandle>;
+
+public:
+    /// \brief Construct a CompactHandle which never resolves to a valid Handle.
+    constexpr CompactHandle() :
+        mKey{HandleKey<Entity>::MakeLatest()}
+    {}
+
+    /*implicit*/ CompactHandle(const Handle<Entity> & aHandle) :
+        mKey{aHandle.mKey}
+    {}
+
+    /// \return The Handle to the referenced entity in `aManager`.
+    /// It is not valid if the entity was erased.
+    Handle<Entity> resolve(EntityManager & aManager) const
+    { return Handle<Entity>{mKey, aManager}; }
+
+    /// \brief Checks whether the referenced entity is still alive in `aManager`.
+    bool isValid(EntityManager & aManager) const
+    { return resolve(aManager).isValid(); }
+
+    /// \attention Removes the generation, only returning the index part of the HandleKey.
+    EntityIndex id() const
+    { return mKey; }
+
+    constexpr bool operator==(const CompactHandle & aRhs) const = default;
+
+private:
+    HandleKey<Entity> mKey;
+};
+
+
+static_assert(sizeof(CompactHandle) == 8);
+static_assert(std::is_trivially_copyable_v<CompactHandle>);
+
+
+} // namespace ent
+} // namespace ad
+
+
+namespace std {
+
+
+template <>
+struct hash<ad::ent::CompactHandle>
+{
+    std::size_t operator()(const ad::ent::CompactHandle & aHandle) const noexcept
+    {
+        return std::hash<ad::ent::HandleKey<ad::ent::Entity>::Underlying_t>{}(
+            aHandle.mKey.getValue());
+    }
+};
+
+
+} // namespace std
@@ -3,7 +3,9 @@
 
 #include <set>
 #include <typeindex>
+#include <type_traits>
 #include <limits>
+#include <utility>
 #include <vector>
 
 
@@ -13,6 +15,9 @@ namespace ent {
 
 using EntityIndex = std::size_t;
 
+/// \brief Relocation of an element from the first index to the second index, when compacting storages.
+using Relocation = std::pair<EntityIndex, EntityIndex>;
+
 using ComponentId = std::type_index;
 
 
@@ -23,6 +28,74 @@ template <class T_component>
 }
 
 
+/// \brief Specialize as std::true_type for a component type to be stored in fixed-size chunks
+/// (see detail::ChunkedVector) instead of a std::vector.
+/// \details The components then keep their address while entities are added to the archetype,
+/// and spawn bursts never reallocate (and move) the whole storage.
+/// This costs an extra indirection on each access.
+template <class T_component>
+struct UseChunkedStorage : std::false_type
+{};
+
+
+/// \brief The default alignment of the component columns: a cache line,
+/// which is also the width of the widest SIMD registers (AVX-512).
+constexpr std::size_t gDefaultColumnAlignment = 64;
+
+/// \brief Specialize with a different `value` to override the alignment of the columns of a component type.
+/// \details The column buffers are aligned to this value (or to the alignment of the component, if stricter),
+/// and their size is padded to a multiple of it: distinct columns never share a cache line,
+/// and vectorized loops can load full registers past the last component.
+/// \note The chunks of a chunked storage are aligned, but not padded (they are already full-sized).
+template <class T_component>
+struct ColumnAlignment : std::integral_constant<std::size_t, gDefaultColumnAlignment>
+{};
+
+
+/// \brief Specialize as std::true_type for a component type to be stored in a sparse set
+/// keyed by entity (see detail::SparseSet), outside of the archetypes.
+/// \details Intended for components added and removed frequently (e.g. status effects):
+/// the component is not part of the archetype signature, so adding or removing it
+/// is constant time and never migrates the entity.
+/// Queries including it test each entity of the matching archetypes for membership in the set.
+/// \note Sparse components must be added and removed one at a time,
+/// and do not trigger the query add / remove events.
+template <class T_component>
+struct UseSparseStorage : std::false_type
+{};
+
+template <class T_component>
+concept SparseComponent = UseSparseStorage<T_component>::value;
+
+
+/// \brief Specialize for a component type to be stored as one column per field (struct of arrays),
+/// listing its fields as a tuple of pointers to data members in a `gFields` static data member:
+///
+///     template <> struct ad::ent::SoaFields<Body>
+///     { static constexpr auto gFields = std::make_tuple(&Body::x, &Body::y, &Body::z); };
+///
+/// \details A system reading some of the fields then only loads those fields arrays.
+/// The component is accessed via a SoaRef proxy instead of a reference (see Soa.h),
+/// and Query::eachBatch() exposes the array of each field.
+/// \note The listed fields must cover the value of the component, which is assembled from its fields.
+template <class T_component>
+struct SoaFields
+{};
+
+template <class T_component>
+concept SoaComponent = requires { SoaFields<T_component>::gFields; }
+                       && !SparseComponent<T_component>;
+
+
+/// \brief Empty component types, which are only recorded in the signature of the archetypes.
+/// \details A tag has no storage: entities do not move it when changing archetype,
+/// and the callbacks asking for it by reference all receive the same shared instance.
+template <class T_component>
+concept TagComponent = std::is_empty_v<T_component>
+                       && std::is_default_constructible_v<T_component>
+                       && !SparseComponent<T_component>;
+
+
 // TODO A constexpr datastructure would allow some optimizations.
 // (such as not storing the query type set in a static data member.)
 // HOTTAKE with the size of typeset we deal with it is probably 
@@ -38,6 +111,37 @@ TypeSet getTypeSet()
     return TypeSet{ {getId<VT_components>()...} };
 }
 
+/// \brief The TypeSet of the components among VT_components which are part of the archetypes signature,
+/// i.e. excluding the sparse components.
+template <class... VT_components>
+TypeSet getArchetypeTypeSet()
+{
+    TypeSet result;
+    ([&result]()
+    {
+        if constexpr (!SparseComponent<VT_components>)
+        {
+            result.insert(getId<VT_components>());
+        }
+    }(), ...);
+    return result;
+}
+
+
+/// \brief True if no type appears twice in the pack.
+template <class T_first, class... VT_others>
+constexpr bool areDistinct()
+{
+    if constexpr (sizeof...(VT_others) == 0)
+    {
+        return true;
+    }
+    else
+    {
+        return (!std::is_same_v<T_first, VT_others> && ...) && areDistinct<VT_others...>();
+    }
+}
+
 
 // TODO Ad 2022/07/08: Ideally, this types becomes unused and can be removed.
 // It is first implemented because QueryBackends are re-instantiated for different orderings
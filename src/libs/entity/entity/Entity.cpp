@@ -3,6 +3,8 @@
 #include "EntityManager.h"
 #include "entity/Component.h"
 
+#include <algorithm>
+
 namespace ad {
 namespace ent {
 
@@ -13,6 +15,20 @@ Phase::~Phase()
     {
         operation();
     }
+    for (EntityManager * manager : mManagers)
+    {
+        manager->endPhase();
+    }
+}
+
+
+void Phase::notifyAtEnd(EntityManager & aManager)
+{
+    std::lock_guard<std::mutex> lock{mMutex};
+    if (std::find(mManagers.begin(), mManagers.end(), &aManager) == mManagers.end())
+    {
+        mManagers.push_back(&aManager);
+    }
 }
 
 
@@ -60,9 +76,8 @@ Handle<Entity>::Handle() :
 
 bool Handle<Entity>::isValid() const
 {
-    // This will test if the generation is the same (it would be a logical error if the index was not).
-    // Compare against mKey (which inlcudes the generation), not ::id()
-    return mManager->keyForIndex(mKey) == mKey;
+    // This will test if the generation is the same.
+    return mManager->isValid(mKey);
 }
 
 void Handle<Entity>::copy(Handle<Entity> aHandle)
@@ -70,35 +85,100 @@ void Handle<Entity>::copy(Handle<Entity> aHandle)
     auto & sourceHandle = *this;
     auto & destHandle = aHandle;
 
-    assert(sourceHandle.record().mArchetype != destHandle.record().mArchetype);
+    const EntityRecord sourceRecord = sourceHandle.record();
+    const EntityRecord initialDestRecord = destHandle.record();
+    assert(sourceRecord.mArchetype != initialDestRecord.mArchetype);
+
+    Archetype & targetArchetype = mManager->archetype(sourceRecord.mArchetype);
+    Archetype & initialDestArchetype = mManager->archetype(initialDestRecord.mArchetype);
+
+    // Notify the query backends that match the destination initial archetype,
+    // but not the target archetype, that the destination entity is being removed.
+    for (const auto & removedQuery :
+         mManager->getExtraQueryBackends(initialDestArchetype, targetArchetype))
+    {
+        removedQuery->signalEntityRemoved(destHandle, initialDestRecord);
+    }
 
-    Archetype & targetArchetype = mManager->archetype(sourceHandle.record().mArchetype);
     EntityIndex newIndex = targetArchetype.countEntities();
 
-    sourceHandle.archetype().copy(
-        sourceHandle.record().mIndex, sourceHandle.mKey, targetArchetype, *mManager);
+    targetArchetype.copy(
+        sourceRecord.mIndex, destHandle.mKey, targetArchetype, *mManager);
+    // The destination entity leaves its initial archetype.
+    initialDestArchetype.remove(initialDestRecord.mIndex, *mManager);
+    mManager->copySparseComponents(sourceHandle.mKey, destHandle.mKey);
 
     EntityRecord newRecord{
-        .mArchetype = sourceHandle.record().mArchetype,
+        .mArchetype = sourceRecord.mArchetype,
         .mIndex = newIndex,
-        .mNamePtr = destHandle.record().mNamePtr,
     };
 
     destHandle.updateRecord(newRecord);
+
+    for (const auto & addedQuery :
+         mManager->getExtraQueryBackends(targetArchetype, initialDestArchetype))
+    {
+        addedQuery->signalEntityAdded(destHandle, newRecord);
+    }
+
+#if defined(ENTITY_SANITIZE)
+    assert(initialDestArchetype.verifyHandlesConsistency(*mManager));
+    assert(targetArchetype.verifyHandlesConsistency(*mManager));
+#endif
 }
 
 
+void Handle<Entity>::removeAlong(const ArchetypeEdge & aEdge, const EntityRecord & aInitialRecord)
+{
+    // If none of the components was present, the entity stays in the same
+    // archetype, at the same index. There is nothing to do in this situation.
+    // Discussion from 2023/05/27: even there might be legitimate cases
+    // to get in this scenario, disallow it for the moment.
+    // If it shows up, we can allow it via a parameter / distinct member
+    // function.
+    // --
+    // But it would break tests.
+    // assert(false);
+    if (aEdge.mDestination == aInitialRecord.mArchetype)
+    {
+        return;
+    }
+
+    Archetype & targetArchetype = mManager->archetype(aEdge.mDestination);
+    Archetype & initialArchetype = mManager->archetype(aInitialRecord.mArchetype);
+
+    // Notify the query backends that match source archetype, but not target
+    // archetype, that the entity is being removed.
+    for (const auto & removedQuery :
+         mManager->getExtraQueryBackends(initialArchetype, targetArchetype))
+    {
+        removedQuery->signalEntityRemoved(*this, aInitialRecord);
+    }
+
+    // The target archetype will grow by one: the size before insertion will be
+    // the inserted index.
+    EntityIndex newIndex = targetArchetype.countEntities();
+    initialArchetype.move(aInitialRecord.mIndex, targetArchetype, aEdge.mColumnMapping, *mManager);
+
+    updateRecord(EntityRecord{
+        .mArchetype = aEdge.mDestination,
+        .mIndex = newIndex,
+    });
+
+#if defined(ENTITY_SANITIZE)
+    assert(initialArchetype.verifyHandlesConsistency(*mManager));
+    assert(targetArchetype.verifyHandlesConsistency(*mManager));
+#endif
+}
+
 
 std::optional<Entity_view> Handle<Entity>::get() const
 {
-    // TODO Potential optimisation: is it wise to to the check here?
-    // Knowing that the client has to check.
-    // record() already return a nullptr archetype for invalid entities,
-    // which could directly be checked by the client.
-    if(isValid())
+    // The validity test and the record access are a single lookup.
+    if(const EntityRecord * found = findRecord())
     {
         return Entity_view{
-            reference(),
+            reference(*found),
         };
     }
     else
@@ -110,14 +190,15 @@ std::optional<Entity_view> Handle<Entity>::get() const
 
 std::optional<Entity> Handle<Entity>::get(Phase & aPhase)
 {
-    // TODO Potential optimisation: is it wise to to the check here?
-    // Knowing that the client has to check.
-    // record() already return a nullptr archetype for invalid entities,
-    // which could directly be checked by the client.
-    if(isValid())
+    if(const EntityRecord * found = findRecord())
     {
+        // The operations deferred through the Entity might empty archetypes.
+        if (mManager->getReclaimPolicy().mMode == ReclaimPolicy::Mode::PhaseEnd)
+        {
+            aPhase.notifyAtEnd(*mManager);
+        }
         return Entity{
-            reference(),
+            reference(*found),
             *this,
             aPhase,
         };
@@ -131,8 +212,8 @@ std::optional<Entity> Handle<Entity>::get(Phase & aPhase)
 
 void Handle<Entity>::erase()
 {
-    EntityRecord rec = record();
-    Archetype & arch = archetype();
+    const EntityRecord rec = record();
+    Archetype & arch = mManager->archetype(rec.mArchetype);
     auto querySet = mManager->getQueryBackendSet(arch);
 
     for (const auto & query : querySet)
@@ -146,13 +227,18 @@ void Handle<Entity>::erase()
 }
 
 
-// TODO redesign this group of retrieval functions
-// This approach tends to call record() several times...
-EntityRecord Handle<Entity>::record() const
+const EntityRecord & Handle<Entity>::record() const
 {
     return mManager->record(mKey);
 }
 
+
+const EntityRecord * Handle<Entity>::findRecord() const
+{
+    return mManager->findRecord(mKey);
+}
+
+
 Archetype & Handle<Entity>::archetype() const
 {
     return mManager->archetype(record().mArchetype);
@@ -160,10 +246,17 @@ Archetype & Handle<Entity>::archetype() const
 
 
 EntityReference Handle<Entity>::reference() const
+{
+    return reference(record());
+}
+
+
+EntityReference Handle<Entity>::reference(const EntityRecord & aRecord) const
 {
     return {
-        &archetype(),
-        record().mIndex,
+        &mManager->archetype(aRecord.mArchetype),
+        aRecord.mIndex,
+        mManager,
     };
 }
 
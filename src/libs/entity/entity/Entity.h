@@ -4,10 +4,13 @@
 #include "Archetype.h"
 #include "HandleKey.h"
 #include "entity/Component.h"
+#include "Flag.h"
 
 #include <functional>
 #include <mutex>
 #include <optional>
+#include <tuple>
+#include <type_traits>
 
 #include <cstddef>
 
@@ -48,18 +51,24 @@ private:
 };
 
 
+/// \brief Locates an Entity in the EntityManager.
+/// \note Intentionally kept trivial and small: it is accessed each time a Handle is resolved.
+/// Colder data, such as the entity name, is stored separately.
 struct EntityRecord
 {
     HandleKey<Archetype> mArchetype;
     EntityIndex mIndex; // Index of this Entity in (each store of) the Archetype.
-    std::shared_ptr<std::string> mNamePtr;
 };
 
+static_assert(std::is_trivially_copyable_v<EntityRecord> && sizeof(EntityRecord) == 16);
+
 
 struct EntityReference
 {
     Archetype * mArchetype;
     EntityIndex mIndex;
+    // Holds the sparse components.
+    EntityManager * mManager;
 };
 
 
@@ -79,10 +88,16 @@ public:
     template <class F_operation>
     void append(F_operation && aOperation);
 
+    /// \brief Notify `aManager` once all the operations are executed,
+    /// so it can apply its ReclaimPolicy.
+    /// \note Thread safe, a manager registered several times is notified once.
+    void notifyAtEnd(EntityManager & aManager);
+
 private:
     // TODO Use better concurrency mechanism, such as lightweight mutexes or a lock-free container.
     std::mutex mMutex;
     std::vector<std::function<void()>> mOperations;
+    std::vector<EntityManager *> mManagers;
 };
 
 
@@ -101,12 +116,24 @@ public:
     template <class T_component>
     bool has();
 
+    /// \return A reference to the component, or a SoaRef for a SoaComponent.
     template <class T_component>
-    T_component & get();
+    ComponentRef_t<T_component> get();
+
+    /// \brief Return whether `aFlag` is set on the entity.
+    bool testFlag(Flag aFlag) const;
+
+    /// \brief Immediately set `aFlag` to `aValue` on the entity.
+    /// \details Flags are not components: this does not migrate the entity,
+    /// so it is allowed while iterating a Query.
+    void setFlag(Flag aFlag, bool aValue = true);
 
     const char * name();
 
 private:
+    HandleKey<Entity> key() const
+    { return mReference.mArchetype->getEntityIndices()[mReference.mIndex]; }
+
     EntityReference mReference;
 };
 
@@ -123,8 +150,20 @@ public:
     template <class T_component>
     Entity & add(T_component aComponent);
 
-    /// \brief Remove component T_component from the entity.
-    template <class T_component>
+    /// \brief Add all the components to the entity, which migrates a single time.
+    template <class T_first, class T_second, class... VT_others>
+    Entity & add(T_first aFirst, T_second aSecond, VT_others... aOthers);
+
+    /// \brief Add component T_component to the entity, constructing it from `aArgs`
+    /// directly in its storage when the phase is flushed.
+    /// \details The arguments are stored by value until then, as with std::bind:
+    /// use std::ref() to pass a reference.
+    /// The component itself is never copied nor moved by the operation.
+    template <class T_component, class... VT_args>
+    Entity & emplace(VT_args &&... aArgs);
+
+    /// \brief Remove components VT_components from the entity, which migrates a single time.
+    template <class... VT_components>
     Entity & remove();
 
     void copy(Handle<Entity> aHandle);
@@ -160,6 +199,7 @@ namespace detail
 template <>
 class Handle<Entity>
 {
+    friend class CompactHandle;
     friend class Entity;
     friend class EntityManager;
     template <class...> friend class Query; // Instantiates Handle on iteration.
@@ -201,6 +241,9 @@ public:
         return mKey;
     }
 
+    /// \return The name the entity was given, or a name generated from its index for an unnamed entity.
+    /// \attention A generated name is stored in a thread local buffer,
+    /// only valid until the next name is generated on the same thread.
     const char * name() const;
 
     const TypeSet getTypeSet() const;
@@ -211,25 +254,52 @@ private:
         mManager{&aManager}
     {}
 
-    template <class T_component>
-    void add(T_component aComponent);
+    /// \brief Add all the components at once: the entity migrates directly to the final archetype.
+    template <class... VT_components>
+    void add(VT_components... aComponents);
     void copy(Handle<Entity> aHandle);
 
-    // TODO emplace() which construct the components by forwarding arguments.
+    /// \brief Add component T_component, constructed in place by forwarding `aArgs`.
+    template <class T_component, class... VT_args>
+    void emplace(VT_args &&... aArgs);
 
-    template <class T_component>
+    /// \brief Remove all the components at once: the entity migrates directly to the final archetype.
+    template <class... VT_components>
     void remove();
 
+    /// \brief Push `aComponent` to `aTargetArchetype` if it is absent from `aInitialArchetype`,
+    /// otherwise assign it to the component at `aIndex`.
+    template <class T_component>
+    static void placeComponent(const Archetype & aInitialArchetype,
+                               Archetype & aTargetArchetype,
+                               EntityIndex aIndex,
+                               T_component & aComponent);
+
+    /// \brief Move the entity along `aEdge`, then let `aPlace` push or assign the added components
+    /// in the destination archetype.
+    /// \param aPlace Invoked as `aPlace(initialArchetype, targetArchetype, indexInTarget)`.
+    template <class F_place>
+    void addAlong(const ArchetypeEdge & aEdge,
+                  const EntityRecord & aInitialRecord,
+                  F_place && aPlace);
+
+    /// \brief Move the entity along `aEdge`, dropping the components absent from the destination archetype.
+    void removeAlong(const ArchetypeEdge & aEdge, const EntityRecord & aInitialRecord);
+
     void erase();
 
-    // TODO return an EntityRecord* (or use the nested Archetype*) allowing :
-    // * to test when needed.
-    // * to blindly dereference when logic requires that the record be valid.
     /// \return The EntityRecord associated with the handled entity.
-    /// The record is returned by **copy**, to prevent mutation.
-    EntityRecord record() const;
+    /// \attention The handle must be valid.
+    /// \warning The reference is into the registry, it is invalidated when entities are added.
+    /// Copy the record when it must persist accross such operations.
+    const EntityRecord & record() const;
+
+    /// \return The EntityRecord associated with the handled entity, or nullptr if the handle is not valid.
+    /// \note This is a single lookup, prefer it over isValid() followed by record().
+    const EntityRecord * findRecord() const;
 
     EntityReference reference() const;
+    EntityReference reference(const EntityRecord & aRecord) const;
 
     Archetype & archetype() const;
 
@@ -266,29 +336,63 @@ Entity & Entity::add(T_component aComponent)
 }
 
 
-template <class T_component>
+template <class T_first, class T_second, class... VT_others>
+Entity & Entity::add(T_first aFirst, T_second aSecond, VT_others... aOthers)
+{
+    mPhase.append(
+        [handle = mHandle,
+         components = std::make_tuple(std::move(aFirst), std::move(aSecond), std::move(aOthers)...)] () mutable
+        {
+            std::apply(
+                [&handle](T_first & aFirst, T_second & aSecond, VT_others &... aOthers)
+                {
+                    handle.add(std::move(aFirst), std::move(aSecond), std::move(aOthers)...);
+                },
+                components);
+        });
+    return *this;
+}
+
+
+template <class T_component, class... VT_args>
+Entity & Entity::emplace(VT_args &&... aArgs)
+{
+    mPhase.append(
+        [handle = mHandle, args = std::make_tuple(std::forward<VT_args>(aArgs)...)] () mutable
+        {
+            // Applied on an rvalue tuple: the values are moved, the references (from std::ref()) stay lvalues.
+            std::apply(
+                [&handle](auto &&... aStoredArgs)
+                {
+                    handle.emplace<T_component>(std::forward<decltype(aStoredArgs)>(aStoredArgs)...);
+                },
+                std::move(args));
+        });
+    return *this;
+}
+
+
+template <class... VT_components>
 Entity & Entity::remove()
 {
     mPhase.append(
         [handle = mHandle] () mutable
         {
-            handle.remove<T_component>();
+            handle.remove<VT_components...>();
         });
     return *this;
 }
 
 
-template <class T_component>
-bool Entity_view::has()
+inline bool Entity_view::testFlag(Flag aFlag) const
 {
-    return mReference.mArchetype->has<T_component>();
+    return mReference.mArchetype->testFlag(mReference.mIndex, aFlag);
 }
 
 
-template <class T_component>
-T_component & Entity_view::get()
+inline void Entity_view::setFlag(Flag aFlag, bool aValue)
 {
-    return mReference.mArchetype->get<T_component>(mReference.mIndex);
+    mReference.mArchetype->setFlag(mReference.mIndex, aFlag, aValue);
 }
 
 
@@ -4,9 +4,13 @@
 #include "Archetype.h"
 #include "Blueprint.h"
 
+#include <algorithm>
+#include <charconv>
 #include <cstdio>
 #include <iterator>
+#include <stdexcept>
 #include <cassert>
+#include <utility>
 
 
 namespace ad {
@@ -14,28 +18,119 @@ namespace ent {
 
 Handle<Entity> EntityManager::createFromBlueprint(Handle<Entity> aBlueprint, const char * aName)
 {
-    assert(aBlueprint.isValid());
-    auto newHandle = addEntity(aName);
+    return mState->createFromBlueprint(aBlueprint, aName, *this);
+}
+
+EntityManager & EntityManager::getEmptyHandleEntityManager()
+{
+    // Note: This manager never registers any entity, and the invalid entity key index
+    // is out of the bounds of any registry anyway.
+    // This design allows to implement Handle<Entity>::isValid() logic
+    // without explicitly testing for the invalid key.
+    static EntityManager emptyHandleEntityManager;
+    return emptyHandleEntityManager;
+}
+
+
+void EntityManager::InternalState::addEntities(EntityManager & aManager,
+                                               std::span<Handle<Entity>> aOutput)
+{
+    std::pair<Archetype &, HandleKey<Archetype>> emptyArchetype =
+        mArchetypes.getEmptyArchetype();
+
+    mEntities.reserve(aOutput.size());
+    emptyArchetype.first.reserveKeys(aOutput.size());
+
+    EntityIndex indexInArchetype = emptyArchetype.first.countEntities();
+    for (Handle<Entity> & handle : aOutput)
     {
-        Phase blueprint;
-        aBlueprint.get(blueprint)->copy(newHandle);
+        HandleKey<Entity> key = mEntities.insert(EntityRecord{
+            emptyArchetype.second,
+            indexInArchetype++,
+        });
+        emptyArchetype.first.pushKey(key);
+        handle = Handle<Entity>{key, aManager};
     }
+
+    // The entities are unnamed, see addEntity().
+    mNames.resize(mEntities.slotCount(), detail::NameTable::gNoName);
+}
+
+
+const ArchetypeEdge & EntityManager::InternalState::insertEdges(Archetype::Transition aTransition,
+                                                                ComponentId aComponent,
+                                                                HandleKey<Archetype> aSource,
+                                                                HandleKey<Archetype> aDestinationKey)
+{
+    Archetype & source = mArchetypes.get(aSource);
+    Archetype & destination = mArchetypes.get(aDestinationKey);
+
+    // The opposite transition leads back to the source archetype, cache it while both are at hand.
+    // (Unless the transition was a no-op, e.g. adding a component already present.)
+    if (aSource != aDestinationKey)
     {
-        Phase removeBlueprint;
-        newHandle.get(removeBlueprint)->remove<Blueprint>();
+        Archetype::Transition reverse = aTransition == Archetype::Transition::Add ?
+            Archetype::Transition::Remove : Archetype::Transition::Add;
+        if (destination.findEdge(reverse, aComponent) == nullptr)
+        {
+            destination.insertEdge(reverse, aComponent, aSource, source);
+        }
     }
 
-    return newHandle;
+    return source.insertEdge(aTransition, aComponent, aDestinationKey, destination);
 }
 
-EntityManager & EntityManager::getEmptyHandleEntityManager()
+
+HandleKey<Entity> EntityManager::InternalState::reserveEntity()
 {
-    static EntityManager emptyHandleEntityManager;
-    // Note: Add an entry for the invalid entity key, mapping it to an invalid EntityRecord.
-    // This design allows to implement Handle<Entity>::isValid() logic 
-    // without explicitly testing for the invalid key.
-    emptyHandleEntityManager.mState->insertInvalidHandleKey();
-    return emptyHandleEntityManager;
+    return mEntities.reserveKey();
+}
+
+
+void EntityManager::InternalState::insertReservedEntity(HandleKey<Entity> aKey)
+{
+    std::pair<Archetype &, HandleKey<Archetype>> emptyArchetype =
+        mArchetypes.getEmptyArchetype();
+
+    mEntities.insertReserved(aKey, EntityRecord{
+        emptyArchetype.second,
+        emptyArchetype.first.countEntities(),
+    });
+    resizeNames();
+    emptyArchetype.first.pushKey(aKey);
+}
+
+
+Handle<Entity> EntityManager::InternalState::createFromBlueprint(Handle<Entity> aBlueprint,
+                                                                 const char * aName,
+                                                                 EntityManager & aManager)
+{
+    assert(aBlueprint.isValid());
+    const EntityRecord blueprintRecord = aBlueprint.record();
+
+    // The new entity is created directly in the archetype of the blueprint without the Blueprint tag,
+    // instead of being copied into the blueprint archetype then migrated.
+    const ArchetypeEdge & edge = restrictArchetype<Blueprint>(blueprintRecord.mArchetype);
+    HandleKey<Archetype> targetKey = edge.mDestination;
+    Archetype & target = mArchetypes.get(targetKey);
+    Archetype & blueprintArchetype = mArchetypes.get(blueprintRecord.mArchetype);
+
+    HandleKey<Entity> key = insertEntity(targetKey, target.countEntities(), aName);
+    // Only the components present in the target are copied, i.e. not the Blueprint tag.
+    blueprintArchetype.copy(blueprintRecord.mIndex, key, target, edge.mColumnMapping, aManager);
+    mSparseSets.copyEntity(aBlueprint.mKey, key);
+
+    Handle<Entity> handle{key, aManager};
+    const EntityRecord record = mEntities.record(key);
+    for (detail::QueryBackendBase * query : getQueryBackendSet(target))
+    {
+        query->signalEntityAdded(handle, record);
+    }
+
+#if defined(ENTITY_SANITIZE)
+    assert(target.verifyHandlesConsistency(aManager));
+#endif
+    return handle;
 }
 
 
@@ -48,24 +143,99 @@ Handle<Archetype> EntityManager::InternalState::getArchetypeHandle(const TypeSet
 
 std::size_t EntityManager::InternalState::countLiveEntities() const
 {
-    assert(mHandleMap.size() >= mFreedHandles.size());
+    return mEntities.countLive();
+}
+
+
+Flag EntityManager::InternalState::registerFlag()
+{
+    if (mFlagCount == gMaxFlags)
+    {
+        throw std::logic_error{"The maximum number of flags is already registered."};
+    }
+    return static_cast<Flag>(mFlagCount++);
+}
+
+
+void EntityManager::InternalState::shrinkToFit()
+{
+    mEntities.shrink();
+    mNames.resize(mEntities.slotCount());
+    mNames.shrink_to_fit();
+
+    mArchetypes.forEach([](Archetype & aArchetype)
+    {
+        aArchetype.shrinkToFit();
+    });
+}
+
+
+std::size_t EntityManager::InternalState::reclaimEmptyArchetypes()
+{
+    return eraseArchetypesIf([](const Archetype & aArchetype)
+    {
+        return aArchetype.countEntities() == 0;
+    });
+}
+
+
+void EntityManager::InternalState::endPhase()
+{
+    if (mReclaimPolicy.mMode == ReclaimPolicy::Mode::PhaseEnd)
+    {
+        // Each archetype is aged, whether it is eventually destroyed or not.
+        // An age of 0 would destroy the archetypes with entities.
+        eraseArchetypesIf([minimumAge = std::max<std::size_t>(mReclaimPolicy.mMinimumAge, 1)]
+                          (Archetype & aArchetype)
+        {
+            return aArchetype.agePhaseEnd() >= minimumAge;
+        });
+    }
+}
+
+
+std::vector<ArchetypeStatistics> EntityManager::InternalState::getArchetypeStatistics() const
+{
+    std::vector<ArchetypeStatistics> result;
+    result.reserve(mArchetypes.size());
+    mArchetypes.forEach([&result](const Archetype & aArchetype)
+    {
+        result.push_back(ArchetypeStatistics{
+            .mTypeSet = aArchetype.getTypeSet(),
+            .mEntityCount = aArchetype.countEntities(),
+            .mCapacity = aArchetype.capacity(),
+            .mHighWaterMark = aArchetype.getHighWaterMark(),
+        });
+    });
+    return result;
+}
 
-    return mHandleMap.size() - mFreedHandles.size();
+
+void EntityManager::InternalState::reserveFromBlueprint(Handle<Entity> aBlueprint, std::size_t aCount)
+{
+    assert(aBlueprint.isValid());
+    // The entities created from the blueprint go to its archetype without the Blueprint tag.
+    const ArchetypeEdge & edge = restrictArchetype<Blueprint>(aBlueprint.record().mArchetype);
+    mEntities.reserve(aCount);
+    mArchetypes.get(edge.mDestination).reserve(aCount);
 }
 
 
 EntityRecord & EntityManager::InternalState::record(HandleKey<Entity> aKey)
 {
-    // TODO implement checks:
-    // * that the generation is matching
-    // * that the record is still there? (or is it a responsibility of the client to check for nullptr?)
-    return mHandleMap.at(aKey);
+    return mEntities.record(aKey);
 }
 
 
-const HandleKey<Entity> & EntityManager::InternalState::keyForIndex(HandleKey<Entity> aKey)
+EntityRecord * EntityManager::InternalState::findRecord(HandleKey<Entity> aKey)
 {
-    return mHandleMap.find(aKey)->first;
+    return mEntities.find(aKey);
+}
+
+
+bool EntityManager::InternalState::isValid(HandleKey<Entity> aKey) const
+{
+    return mEntities.isValid(aKey);
 }
 
 
@@ -76,14 +246,33 @@ Archetype & EntityManager::InternalState::archetype(HandleKey<Archetype> aHandle
 
 const char * EntityManager::InternalState::name(HandleKey<Entity> aHandle) const
 {
-    return mHandleMap.at(aHandle).mNamePtr->c_str();
+    assert(mEntities.isValid(aHandle));
+
+    if (detail::NameTable::NameId nameId = mNames[aHandle];
+        nameId != detail::NameTable::gNoName)
+    {
+        return mNameTable.get(nameId);
+    }
+
+    // Generate the debug name of an unnamed entity from its index.
+    // It is formatted in a thread local buffer instead of being interned,
+    // so the manager is not modified and names can be queried concurrently.
+    constexpr std::string_view prefix{"Entity "};
+    thread_local char buffer[prefix.size() + std::numeric_limits<EntityIndex>::digits10 + 2];
+    std::copy(prefix.begin(), prefix.end(), buffer);
+    auto [end, _error] = std::to_chars(buffer + prefix.size(), std::end(buffer) - 1,
+                                       static_cast<EntityIndex>(aHandle));
+    *end = '\0';
+    return buffer;
 }
 
-Handle<Entity> EntityManager::InternalState::handleFromName(const handy::StringId & aNameId, EntityManager & aManager) const
+Handle<Entity> EntityManager::InternalState::handleFromName(std::string_view aName, EntityManager & aManager) const
 {
-    if (mHandleByNameMap.contains(aNameId))
+    detail::NameTable::NameId nameId = mNameTable.find(aName);
+    // Only explicit names are interned and associated to an entity in mHandleByName.
+    if (nameId < mHandleByName.size() && mEntities.isValid(mHandleByName[nameId]))
     {
-        return Handle<Entity>{mHandleByNameMap.at(aNameId), aManager};
+        return Handle<Entity>{mHandleByName[nameId], aManager};
     }
     else
     {
@@ -92,6 +281,20 @@ Handle<Entity> EntityManager::InternalState::handleFromName(const handy::StringI
 }
 
 
+std::vector<Handle<Entity>>
+EntityManager::InternalState::handlesFromNames(std::span<const std::string_view> aNames,
+                                               EntityManager & aManager) const
+{
+    std::vector<Handle<Entity>> result;
+    result.reserve(aNames.size());
+    for (std::string_view name : aNames)
+    {
+        result.push_back(handleFromName(name, aManager));
+    }
+    return result;
+}
+
+
 void EntityManager::InternalState::freeHandle(HandleKey<Entity> aKey)
 { 
     // Even though it is possible that the latest handle key is use for a legitimate Handle,
@@ -100,17 +303,96 @@ void EntityManager::InternalState::freeHandle(HandleKey<Entity> aKey)
     // to be able to free it.
     assert(aKey != HandleKey<Entity>::MakeLatest());
 
-    // Get the reference to the currently stored handle key.
-    const auto & handleKey = keyForIndex(aKey);
-    // Increment the generation of the key in the map, so any existing handle to the freed element
-    // will not compare equal anymore (and thus will not be considered to point to a valid Entity).
-    handleKey.advanceGeneration();
+    mEntities.erase(aKey);
+    // The index will be reused, it must not keep the sparse components of the erased entity.
+    mSparseSets.eraseEntity(aKey);
 
-    // Important: the handle with advanced generation is stord in the free list
-    // because this is the handle that will be returned by an `addEntity()` re-using it.
-    mFreedHandles.push_back(handleKey);
+    // Release the name, so long running simulations do not accumulate the names of erased entities.
+    detail::NameTable::NameId & nameId = mNames[aKey];
+    if (nameId != detail::NameTable::gNoName)
+    {
+        if (nameId < mHandleByName.size() && mHandleByName[nameId] == aKey)
+        {
+            mHandleByName[nameId] = HandleKey<Entity>::MakeLatest();
+        }
+        mNameTable.release(nameId);
+        nameId = detail::NameTable::gNoName;
+    }
+}
+
+void EntityManager::InternalState::eraseAll(std::span<const Handle<Entity>> aHandles,
+                                           EntityManager & aManager)
+{
+    std::vector<EntityRecord> victims;
+    victims.reserve(aHandles.size());
+    for (Handle<Entity> handle : aHandles)
+    {
+        assert(handle.mManager == &aManager);
+        victims.push_back(mEntities.record(handle.mKey));
+    }
+    // Group the victims by archetype, by increasing index in the archetype.
+    std::sort(victims.begin(), victims.end(),
+              [](const EntityRecord & aLhs, const EntityRecord & aRhs)
+              {
+                  return std::pair{aLhs.mArchetype.getValue(), aLhs.mIndex}
+                         < std::pair{aRhs.mArchetype.getValue(), aRhs.mIndex};
+              });
+
+    std::vector<EntityIndex> indices;
+    for (auto groupBegin = victims.begin(); groupBegin != victims.end();)
+    {
+        auto groupEnd = std::find_if(groupBegin, victims.end(),
+                                     [archetype = groupBegin->mArchetype](const EntityRecord & aRecord)
+                                     {
+                                         return aRecord.mArchetype != archetype;
+                                     });
+        indices.clear();
+        for (auto victim = groupBegin; victim != groupEnd; ++victim)
+        {
+            // Handles appearing several times are erased once.
+            if (indices.empty() || indices.back() != victim->mIndex)
+            {
+                indices.push_back(victim->mIndex);
+            }
+        }
+        eraseInArchetype(groupBegin->mArchetype, indices, aManager);
+        groupBegin = groupEnd;
+    }
 }
 
+
+void EntityManager::InternalState::eraseInArchetype(HandleKey<Archetype> aArchetype,
+                                                    std::span<const EntityIndex> aIndices,
+                                                    EntityManager & aManager)
+{
+    if (aIndices.empty())
+    {
+        return;
+    }
+
+    Archetype & archetype = mArchetypes.get(aArchetype);
+    for (detail::QueryBackendBase * query : getQueryBackendSet(archetype))
+    {
+        query->signalEntitiesRemoved(aArchetype, archetype, aIndices, aManager);
+    }
+
+    // The keys must be collected before the archetype is compacted.
+    std::vector<HandleKey<Entity>> keys;
+    keys.reserve(aIndices.size());
+    for (EntityIndex index : aIndices)
+    {
+        keys.push_back(archetype.getEntityIndices()[index]);
+    }
+
+    archetype.removeMany(aIndices, aManager);
+
+    for (HandleKey<Entity> key : keys)
+    {
+        freeHandle(key);
+    }
+}
+
+
 std::set<detail::QueryBackendBase *>
 EntityManager::InternalState::getQueryBackendSet(const Archetype & aArchetype) const
 {
@@ -118,14 +400,10 @@ EntityManager::InternalState::getQueryBackendSet(const Archetype & aArchetype) c
     TypeSet archetypeTypeSet = aArchetype.getTypeSet();
     for(const auto & [typeSequence, backend] : mQueryBackends)
     {
+        // Note: the backends of queries with sparse components never match,
+        // as sparse components are not in the archetypes: they are not signaled.
         TypeSet queryTypeSet{typeSequence.begin(), typeSequence.end()};
-        if(std::includes(archetypeTypeSet.begin(), archetypeTypeSet.end(),
-                         queryTypeSet.begin(), queryTypeSet.end()) &&
-                     std::find(
-                         archetypeTypeSet.begin(),
-                         archetypeTypeSet.end(),
-                         getId<Blueprint>()
-                     ) == archetypeTypeSet.end())
+        if(detail::isMatching(archetypeTypeSet, queryTypeSet))
         {
             result.insert(backend.get());
         }
@@ -150,34 +428,6 @@ EntityManager::InternalState::getExtraQueryBackends(const Archetype & aCompared,
 }
 
 
-HandleKey<Entity> EntityManager::InternalState::getAvailableHandle()
-{
-    if (mFreedHandles.empty())
-    {
-        return mNextHandle++;
-    }
-    else
-    {
-        HandleKey<Entity> handle = mFreedHandles.front();
-        mFreedHandles.pop_front();
-        return handle;
-    }
-}
-
-
-void EntityManager::InternalState::insertInvalidHandleKey()
-{
-    // The default constructed Handle (which is not valid) use the latest HandleKey value.
-    // Storing a record at the same Handle, except its generation wrapped around,
-    // ensure that the default Handle is not valid.
-    mHandleMap.emplace(
-        HandleKey<Entity>::MakeLatest().advanceGeneration(),
-        EntityRecord{HandleKey<Archetype>::MakeLatest(), // does not matter
-                     std::numeric_limits<EntityIndex>::max()}
-    );
-}
-
-
 State EntityManager::saveState()
 {
     // move the currently active InternalState to the backup State.
@@ -206,14 +456,11 @@ void EntityManager::forEachHandle(std::function<void(Handle<Entity>, const char
 
 void EntityManager::InternalState::forEachHandle(std::function<void(Handle<Entity>, const char *)> aCallback, EntityManager & aManager)
 {
-    for (auto & [key, record] : mHandleMap)
-    {
-        Handle<Entity> handle(key, aManager);
-        if (std::find(mFreedHandles.begin(), mFreedHandles.end(), key) == mFreedHandles.end())
+    mEntities.forEachLive(
+        [this, &aCallback, &aManager](HandleKey<Entity> aKey, const EntityRecord &)
         {
-            aCallback(handle, record.mNamePtr->c_str());
-        }
-    }
+            aCallback(Handle<Entity>{aKey, aManager}, name(aKey));
+        });
 }
 
 
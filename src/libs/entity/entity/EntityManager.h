@@ -3,30 +3,38 @@
 #include "Archetype.h"
 #include "ArchetypeStore.h"
 #include "detail/CloningPointer.h"
+#include "detail/EntityRegistry.h"
+#include "detail/NameTable.h"
 #include "detail/QueryBackend.h"
+#include "detail/SparseSet.h"
 #include "Entity.h"
-#include "handy/StringId.h"
+#include "Flag.h"
 #include "QueryStore.h"
 
 #include <algorithm>
 #include <cstddef>
 #include <cstdio>
-#include <deque>
 #include <iostream>
 #include <map>
-#include <sstream>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <tuple>
+#include <utility>
 
 namespace ad {
 namespace ent {
 
 class State;
-// TODO implement reuse of handle from the free list
-// TODO implement handle free list hosted implicitly in a vector of handles
+
 class EntityManager
 {
     friend class Archetype;
+    friend class Entity_view;
     friend class Handle<Archetype>;
     friend class Handle<Entity>;
+    friend class Phase;
     template <class...>
     friend class Query;
     friend class State;
@@ -42,37 +50,142 @@ class EntityManager
         friend class Inspector;
 
     public:
+        InternalState() = default;
+
+        explicit InternalState(HandleReuse aReuse,
+                               std::pmr::memory_resource * aResource = std::pmr::get_default_resource()) :
+            mEntities{aReuse},
+            mArchetypes{aResource}
+        {}
+
         Handle<Entity> addEntity(EntityManager & aManager, const char * aName);
 
+        std::pmr::memory_resource * getMemoryResource() const
+        { return mArchetypes.getResource(); }
+
+        void addEntities(EntityManager & aManager, std::span<Handle<Entity>> aOutput);
+
+        /// \brief Thread safe, see EntityRegistry::reserveKey().
+        HandleKey<Entity> reserveEntity();
+
+        /// \brief Insert the entity with reserved `aKey` in the empty archetype.
+        void insertReservedEntity(HandleKey<Entity> aKey);
+
+        template <class... VT_components>
+        Handle<Entity> spawn(EntityManager & aManager, VT_components &&... aComponents);
+
+        /// \brief Insert the entity with reserved `aKey` in the archetype of exactly VT_components.
+        template <class... VT_components>
+        void spawnReserved(HandleKey<Entity> aKey, EntityManager & aManager,
+                           VT_components &&... aComponents);
+
+        Handle<Entity> createFromBlueprint(Handle<Entity> aBlueprint,
+                                           const char * aName,
+                                           EntityManager & aManager);
+
+        /// \brief Register a new entity, whose record is `aIndex` in `aArchetype`.
+        /// \attention The caller is responsible for pushing the entity to the archetype.
+        HandleKey<Entity> insertEntity(HandleKey<Archetype> aArchetype,
+                                       EntityIndex aIndex,
+                                       const char * aName);
+
         std::size_t countLiveEntities() const;
 
+        Flag registerFlag();
+
+        void shrinkToFit();
+
+        const ShrinkPolicy & getShrinkPolicy() const
+        { return mShrinkPolicy; }
+
+        void setShrinkPolicy(ShrinkPolicy aPolicy)
+        { mShrinkPolicy = aPolicy; }
+
+        const ReclaimPolicy & getReclaimPolicy() const
+        { return mReclaimPolicy; }
+
+        void setReclaimPolicy(ReclaimPolicy aPolicy)
+        { mReclaimPolicy = aPolicy; }
+
+        std::size_t reclaimEmptyArchetypes();
+
+        /// \brief Apply the ReclaimPolicy::Mode::PhaseEnd policy, once the operations of a phase are executed.
+        void endPhase();
+
+        std::vector<ArchetypeStatistics> getArchetypeStatistics() const;
+
+        template <class... VT_components>
+        void reserve(std::size_t aCount);
+
+        void reserveFromBlueprint(Handle<Entity> aBlueprint, std::size_t aCount);
+
         Handle<Archetype> getArchetypeHandle(const TypeSet & aTypeSet,
                                              EntityManager & aManager);
 
+        /// \brief Return the edge from archetype `aSource` to the archetype with T_component added.
+        /// \details The edge is cached in the source archetype on first use.
         template <class T_component>
-        HandleKey<Archetype> extendArchetype(const Archetype & aArchetype);
+        const ArchetypeEdge & extendArchetype(HandleKey<Archetype> aSource);
 
+        /// \brief Return the edge from archetype `aSource` to the archetype with T_component removed.
         template <class T_component>
-        HandleKey<Archetype> restrictArchetype(const Archetype & aArchetype);
+        const ArchetypeEdge & restrictArchetype(HandleKey<Archetype> aSource);
+
+        /// \brief Return the edge from archetype `aSource` to the archetype with all VT_components added.
+        /// \details The edge is not cached. Only the final archetype is created if needed,
+        /// never the intermediate archetypes adding the components one by one would visit.
+        template <class... VT_components>
+        ArchetypeEdge extendArchetypeMany(HandleKey<Archetype> aSource);
+
+        /// \brief Return the edge from archetype `aSource` to the archetype with all VT_components removed.
+        /// \details See extendArchetypeMany().
+        template <class... VT_components>
+        ArchetypeEdge restrictArchetypeMany(HandleKey<Archetype> aSource);
+
+        /// \brief Return the archetype with exactly the components VT_components.
+        template <class... VT_components>
+        HandleKey<Archetype> makeArchetype();
+
+        /// \brief Return the set storing the sparse component T_component, creating it on first access.
+        template <SparseComponent T_component>
+        detail::SparseSet<T_component> & sparseSet()
+        { return mSparseSets.get<T_component>(); }
+
+        /// \brief Make the sparse components of entity `aDestination` copies of those of `aSource`.
+        void copySparseComponents(HandleKey<Entity> aSource, HandleKey<Entity> aDestination)
+        { mSparseSets.copyEntity(aSource, aDestination); }
 
         EntityRecord & record(HandleKey<Entity> aKey);
 
-        /// \brief Return the complete HandleKey currently associated with the
-        /// index subpart of `aKey`. \details mHandleMap is only comparing the
-        /// index part of the HandleKey, which means this function will return
-        /// an HandleKey with the same index, but not necessarily the same
-        /// generation. This is usefull to test an Handle validity.
-        const HandleKey<Entity> & keyForIndex(HandleKey<Entity> aKey);
+        EntityRecord * findRecord(HandleKey<Entity> aKey);
+
+        /// \brief Return true if `aKey` (including its generation) is
+        /// currently associated to an entity.
+        bool isValid(HandleKey<Entity> aKey) const;
 
         Archetype & archetype(HandleKey<Archetype> aHandle);
 
+        /// \return The explicit name of the entity, or for an unnamed entity a name generated
+        /// in a thread local buffer, which is overwritten by the next generated name on the same thread.
         const char * name(HandleKey<Entity> aHandle) const;
 
-        Handle<Entity> handleFromName(const handy::StringId & aNameId,
+        Handle<Entity> handleFromName(std::string_view aName,
                                       EntityManager & aManager) const;
 
+        std::vector<Handle<Entity>>
+        handlesFromNames(std::span<const std::string_view> aNames,
+                         EntityManager & aManager) const;
+
         void freeHandle(HandleKey<Entity> aKey);
 
+        void eraseAll(std::span<const Handle<Entity>> aHandles, EntityManager & aManager);
+
+        /// \brief Erase the entities at `aIndices` in archetype `aArchetype`, notifying the queries in batch.
+        /// \param aIndices must be strictly increasing.
+        void eraseInArchetype(HandleKey<Archetype> aArchetype,
+                              std::span<const EntityIndex> aIndices,
+                              EntityManager & aManager);
+
         template <class... VT_components>
         detail::QueryBackend<VT_components...> * getQueryBackend();
 
@@ -87,41 +200,63 @@ class EntityManager
             std::function<void(Handle<Entity>, const char *)> aCallback,
             EntityManager & aManager);
 
-        // TODO This could be massively optimized by keeping a graph of
-        // transformations on the archetypes, and storing the backend difference
-        // along the edges. Basically, the edge would cache this information.
+        template <class F_callback>
+        void forEachHandleInStorageOrder(F_callback && aCallback,
+                                         EntityManager & aManager) const;
+
+        template <class F_callback>
+        void forEachHandleParallel(F_callback && aCallback,
+                                   std::size_t aThreadCount,
+                                   EntityManager & aManager) const;
+
+        // TODO The archetypes now keep a graph of transformations (see ArchetypeEdge),
+        // the backend difference could be stored along the edges as well.
+        // It would have to be invalidated when new backends are created.
         /// \brief Return all QueryBackends that are present in aCompared, but
         /// not in aReference.
         std::vector<detail::QueryBackendBase *>
         getExtraQueryBackends(const Archetype & aCompared,
                               const Archetype & aReference) const;
 
-        void insertInvalidHandleKey();
-
     private:
+        void resizeNames();
+
+        /// \brief Push the components then the key of a newly registered entity,
+        /// and notify the matching queries.
+        template <class... VT_components>
+        Handle<Entity> pushSpawned(HandleKey<Entity> aKey,
+                                   Archetype & aArchetype,
+                                   EntityManager & aManager,
+                                   VT_components &&... aComponents);
+
         template <class F_maker>
         HandleKey<Archetype>
         makeArchetypeIfAbsent(const TypeSet & aTargetTypeSet,
                               F_maker && aMakeCallback);
 
-        /// \brief Get an available handle. Prefers returning from the free list
-        /// if not empty.
-        HandleKey<Entity> getAvailableHandle();
-
-        // TODO Refactor the Handle<Entity> related members into a coherent
-        // separate class.
-        HandleKey<Entity> mNextHandle{
-            HandleKey<Entity>::MakeFirst()}; // Initially, the first handle is
-                                             // the next handle.
-
-        // Note: Uses a custom comparison, only testing the index part of the
-        // HandleKey (not the generation). This is to be consistent with the
-        // fact that different generations of the same index should be placed at
-        // the same key position from the map perspective.
-        std::map<HandleKey<Entity>, EntityRecord, HandleKey<Entity>::LessIndex>
-            mHandleMap;
-        std::map<handy::StringId, HandleKey<Entity>> mHandleByNameMap;
-        std::deque<HandleKey<Entity>> mFreedHandles;
+        /// \brief Destroy the archetypes for which `aPredicate` returns true,
+        /// and remove them from the query backends.
+        template <class F_predicate>
+        std::size_t eraseArchetypesIf(F_predicate && aPredicate);
+
+        /// \brief Cache the edge for `aTransition` of `aComponent` from `aSource` to `aDestinationKey`,
+        /// as well as the reverse edge when the transition changes the archetype.
+        const ArchetypeEdge & insertEdges(Archetype::Transition aTransition,
+                                          ComponentId aComponent,
+                                          HandleKey<Archetype> aSource,
+                                          HandleKey<Archetype> aDestinationKey);
+
+        detail::EntityRegistry mEntities;
+        std::size_t mFlagCount{0};
+        ShrinkPolicy mShrinkPolicy;
+        ReclaimPolicy mReclaimPolicy;
+        // Indexed by the index part of the entity HandleKey.
+        // Kept apart from the registry, so the records stay compact.
+        std::vector<detail::NameTable::NameId> mNames;
+        detail::NameTable mNameTable;
+        // Indexed by NameId, the last entity explicitly given each name.
+        // The entry is reset when this entity is freed.
+        std::vector<HandleKey<Entity>> mHandleByName;
 
         // This must appear BEFORE the archetypes, so QueryBackends are
         // destructed AFTER Archetypes: Archetypes might store Queries, whose
@@ -129,20 +264,94 @@ class EntityManager
         QueryStore mQueryBackends;
 
         ArchetypeStore mArchetypes;
+        // Keyed by the index part of the entity HandleKey.
+        detail::SparseStore mSparseSets;
     };
 
 public:
-    /// \warning Thread unsafe!
-    // TODO #thread P1: should be made thread safe (take a look at lock-free
-    // approaches) because this operation is not deferred (so parallel jobs
-    // could be doing it concurrently) An idea to evaluate: could it be
-    // lock-free via read-modify-write? see:
-    // https://preshing.com/20120612/an-introduction-to-lock-free-programming/
+    EntityManager() = default;
+
+    /// \brief Construct a manager re-using the handles of erased entities following `aReuse`.
+    explicit EntityManager(HandleReuse aReuse) :
+        mState{std::make_unique<InternalState>(aReuse)}
+    {}
+
+    /// \brief Construct a manager allocating the component stores and the archetype handles from `aResource`.
+    /// \details This allows arenas per manager (e.g. a std::pmr::monotonic_buffer_resource
+    /// for a throwaway simulation), or pools backed by huge pages.
+    /// The resource must outlive the manager, and the states saved from it.
+    /// \note The archetypes, the query backends and the registry are still allocated from the global heap.
+    explicit EntityManager(std::pmr::memory_resource * aResource, HandleReuse aReuse = HandleReuse::Fifo) :
+        mState{std::make_unique<InternalState>(aReuse, aResource)}
+    {}
+
+    /// \brief The memory resource providing the component stores and the archetype handles.
+    std::pmr::memory_resource * getMemoryResource() const
+    {
+        return mState->getMemoryResource();
+    }
+
+    /// \warning Thread unsafe! Parallel jobs should use addEntity(Phase &).
     Handle<Entity> addEntity(const char * aName = nullptr)
     {
         return mState->addEntity(*this, aName);
     }
 
+    /// \brief Create an unnamed entity, which is inserted at the end of `aPhase`.
+    /// \details The handle is reserved immediately without locking the manager,
+    /// so this can be called concurrently from several jobs.
+    /// It can be stored and compared right away, but it only becomes valid once the phase completes.
+    /// \note Thread safe with respect to other deferred creations (see also spawn(Phase &, ...)),
+    /// and to read-only accesses. Other operations on the manager must not run concurrently.
+    Handle<Entity> addEntity(Phase & aPhase)
+    {
+        Handle<Entity> handle{mState->reserveEntity(), *this};
+        aPhase.append([this, key = handle.mKey]()
+        {
+            mState->insertReservedEntity(key);
+        });
+        return handle;
+    }
+
+    /// \brief Add `aCount` unnamed entities at once.
+    /// \details The capacity for all the entities is reserved up-front,
+    /// which is more efficient than repeated calls to addEntity().
+    /// \warning Thread unsafe!
+    std::vector<Handle<Entity>> addEntities(std::size_t aCount)
+    {
+        std::vector<Handle<Entity>> result(aCount);
+        mState->addEntities(*this, result);
+        return result;
+    }
+
+    /// \brief Add as many unnamed entities as `aOutput` size, writing their handles to `aOutput`.
+    /// \warning Thread unsafe!
+    void addEntities(std::span<Handle<Entity>> aOutput)
+    {
+        mState->addEntities(*this, aOutput);
+    }
+
+    /// \brief Create an unnamed entity with all the provided components at once.
+    /// \details The entity is created directly in the archetype of this exact set of components,
+    /// the components are moved into its stores, and each matching query is notified once.
+    /// This avoids migrating the entity through intermediate archetypes,
+    /// as happens when adding the components one at a time.
+    /// \warning Not deferred: the target archetype must not be under iteration.
+    /// Use the overload taking a Phase from inside Query::each().
+    template <class... VT_components>
+    Handle<Entity> spawn(VT_components... aComponents)
+    {
+        static_assert(sizeof...(VT_components) > 0, "Use addEntity() to create an entity without components.");
+        static_assert(areDistinct<VT_components...>(), "A component type cannot be provided twice.");
+        return mState->spawn(*this, std::move(aComponents)...);
+    }
+
+    /// \brief Deferred variant of spawn(), which is thread safe in the same way as addEntity(Phase &).
+    /// \details The handle is reserved immediately, the entity is created with all its components
+    /// (and becomes valid) at the end of `aPhase`.
+    template <class... VT_components>
+    Handle<Entity> spawn(Phase & aPhase, VT_components... aComponents);
+
     Handle<Entity> addBlueprint(const char * aName = nullptr)
     {
         auto handle = mState->addEntity(*this, aName);
@@ -161,18 +370,142 @@ public:
         return mState->countLiveEntities();
     }
 
+    /// \brief Register a new per-entity Flag, initially unset on all entities.
+    /// \details Flags can be set with Entity_view::setFlag(), and filtered on by Query::each().
+    /// \throw std::logic_error if gMaxFlags flags are already registered.
+    Flag registerFlag()
+    {
+        return mState->registerFlag();
+    }
+
+    /// \brief Erase all the entities in `aHandles` at once.
+    /// \details The entities are grouped by archetype: each archetype store is compacted in a single pass,
+    /// and the queries matching an archetype are looked up once, then notified of all its removed entities.
+    /// This is much faster than erasing the entities one by one when there are many.
+    /// A handle can appear several times, but it must be valid.
+    /// \warning Not deferred, and thread unsafe: the archetypes must not be under iteration.
+    void eraseAll(std::span<const Handle<Entity>> aHandles)
+    {
+        mState->eraseAll(aHandles, *this);
+    }
+
+    /// \brief Release the memory held for the entity indices past the highest live one,
+    /// and the capacity of each archetype past its count of entities.
+    /// \details Intended after large despawns, notably combined with HandleReuse::LowestIndex
+    /// which keeps the live indices packed at the start.
+    /// The handles of erased entities remain invalid.
+    /// \warning Thread unsafe! Must not be called while deferred creations are pending,
+    /// nor while a Query is iterating.
+    void shrinkToFit()
+    {
+        mState->shrinkToFit();
+    }
+
+    /// \brief Set when the archetypes automatically give back the memory of their removed entities.
+    /// \details The policy is applied each time entities are removed from an archetype
+    /// (including when they migrate to another archetype).
+    void setShrinkPolicy(ShrinkPolicy aPolicy)
+    {
+        mState->setShrinkPolicy(aPolicy);
+    }
+
+    /// \brief Destroy the archetypes without entities, giving back their memory,
+    /// and remove them from the queries, which then do not visit them anymore.
+    /// \details The archetype without components is never destroyed.
+    /// An archetype is recreated if entities come to match it again.
+    /// The keys of the entities are not affected, but a Handle<Archetype> to a destroyed archetype is invalidated.
+    /// \return The count of destroyed archetypes.
+    /// \warning Thread unsafe! Must not be called while a Query is iterating.
+    std::size_t reclaimEmptyArchetypes()
+    {
+        return mState->reclaimEmptyArchetypes();
+    }
+
+    /// \brief Set when the archetypes without entities are automatically destroyed.
+    /// \details See reclaimEmptyArchetypes(). A Phase is the safe point of the automatic reclamation:
+    /// it is never done while an operation is executed, nor while a Query is iterating.
+    /// \attention With ReclaimPolicy::Mode::PhaseEnd, the phases must end while the manager is alive,
+    /// and outside of Query iterations (which is already required to execute the deferred operations).
+    void setReclaimPolicy(ReclaimPolicy aPolicy)
+    {
+        mState->setReclaimPolicy(aPolicy);
+    }
+
+    /// \brief Ensure that `aCount` more entities with exactly the components VT_components
+    /// can be created without reallocating.
+    /// \details Creates the archetype if it does not exist yet.
+    /// Intended to pre-allocate before a burst of spawns, e.g. when a level starts.
+    /// \warning Thread unsafe!
+    template <class... VT_components>
+    void reserve(std::size_t aCount)
+    {
+        mState->reserve<VT_components...>(aCount);
+    }
+
+    /// \brief Ensure that `aCount` more entities can be created from `aBlueprint` without reallocating.
+    /// \warning Thread unsafe!
+    void reserveFromBlueprint(Handle<Entity> aBlueprint, std::size_t aCount)
+    {
+        mState->reserveFromBlueprint(aBlueprint, aCount);
+    }
+
+    /// \brief Report the count of entities, capacity and high-water mark of each live archetype,
+    /// by order of creation (until reclaimed archetypes get their slot reused).
+    std::vector<ArchetypeStatistics> getArchetypeStatistics() const
+    {
+        return mState->getArchetypeStatistics();
+    }
+
     /// \note: Not const, since it actually re-allocate the internal state
     State saveState();
     void restoreState(const State & aState);
 
     // \note: For debug purpose we need a way to access all currently valid
     // handles
+    /// \brief Invoke `aCallback` with each live entity and its name, by increasing handle id.
+    /// \note Linear in the number of entity slots, i.e. the maximum count of entities alive at once.
+    /// The names of unnamed entities are generated without allocating, see Handle<Entity>::name().
     void
     forEachHandle(std::function<void(Handle<Entity>, const char *)> aCallback);
 
-    Handle<Entity> handleFromName(const std::string & aName)
+    /// \brief Invoke `aCallback` with the handle of each live entity, in storage order:
+    /// archetype by archetype, following the order of the entities in the archetype stores.
+    /// \details Linear in the number of live entities, and the components of consecutively
+    /// visited entities are contiguous in memory.
+    /// \attention Entities must not be added, modified, nor removed from the callback
+    /// (deferred operations via a Phase are fine).
+    template <class F_callback>
+    void forEachHandleInStorageOrder(F_callback && aCallback)
+    {
+        mState->forEachHandleInStorageOrder(std::forward<F_callback>(aCallback), *this);
+    }
+
+    /// \brief Variant of forEachHandleInStorageOrder() splitting the entities between `aThreadCount` threads,
+    /// intended for tooling scanning large worlds.
+    /// \details `aCallback` is invoked concurrently (the calling thread takes a share),
+    /// so it must be thread safe. Each thread visits a contiguous range of the storage order.
+    /// \attention The manager must not be modified until the function returns.
+    template <class F_callback>
+    void forEachHandleParallel(F_callback && aCallback,
+                               std::size_t aThreadCount = std::thread::hardware_concurrency())
+    {
+        mState->forEachHandleParallel(std::forward<F_callback>(aCallback), aThreadCount, *this);
+    }
+
+    /// \return The handle to the entity explicitly named `aName`,
+    /// or an invalid handle if there is no such entity.
+    /// \note Does not allocate.
+    Handle<Entity> handleFromName(std::string_view aName)
     {
-        return mState->handleFromName(handy::StringId(aName), *this);
+        return mState->handleFromName(aName, *this);
+    }
+
+    /// \brief Resolve several names at once, e.g. when loading a level.
+    /// \return The handles, in the same order as `aNames`.
+    std::vector<Handle<Entity>>
+    handlesFromNames(std::span<const std::string_view> aNames)
+    {
+        return mState->handlesFromNames(aNames, *this);
     }
 
 private:
@@ -184,15 +517,44 @@ private:
     }
 
     template <class T_component>
-    HandleKey<Archetype> extendArchetype(const Archetype & aArchetype)
+    const ArchetypeEdge & extendArchetype(HandleKey<Archetype> aSource)
     {
-        return mState->extendArchetype<T_component>(aArchetype);
+        return mState->extendArchetype<T_component>(aSource);
     }
 
     template <class T_component>
-    HandleKey<Archetype> restrictArchetype(const Archetype & aArchetype)
+    const ArchetypeEdge & restrictArchetype(HandleKey<Archetype> aSource)
+    {
+        return mState->restrictArchetype<T_component>(aSource);
+    }
+
+    template <class... VT_components>
+    ArchetypeEdge extendArchetypeMany(HandleKey<Archetype> aSource)
+    {
+        return mState->extendArchetypeMany<VT_components...>(aSource);
+    }
+
+    template <class... VT_components>
+    ArchetypeEdge restrictArchetypeMany(HandleKey<Archetype> aSource)
+    {
+        return mState->restrictArchetypeMany<VT_components...>(aSource);
+    }
+
+    template <class... VT_components>
+    HandleKey<Archetype> makeArchetype()
+    {
+        return mState->makeArchetype<VT_components...>();
+    }
+
+    template <SparseComponent T_component>
+    detail::SparseSet<T_component> & sparseSet()
+    {
+        return mState->sparseSet<T_component>();
+    }
+
+    void copySparseComponents(HandleKey<Entity> aSource, HandleKey<Entity> aDestination)
     {
-        return mState->restrictArchetype<T_component>(aArchetype);
+        mState->copySparseComponents(aSource, aDestination);
     }
 
     EntityRecord & record(HandleKey<Entity> aKey)
@@ -200,9 +562,29 @@ private:
         return mState->record(aKey);
     }
 
-    const HandleKey<Entity> & keyForIndex(HandleKey<Entity> aKey)
+    const ShrinkPolicy & getShrinkPolicy() const
     {
-        return mState->keyForIndex(aKey);
+        return mState->getShrinkPolicy();
+    }
+
+    const ReclaimPolicy & getReclaimPolicy() const
+    {
+        return mState->getReclaimPolicy();
+    }
+
+    void endPhase()
+    {
+        mState->endPhase();
+    }
+
+    EntityRecord * findRecord(HandleKey<Entity> aKey)
+    {
+        return mState->findRecord(aKey);
+    }
+
+    bool isValid(HandleKey<Entity> aKey) const
+    {
+        return mState->isValid(aKey);
     }
 
     Archetype & archetype(HandleKey<Archetype> aHandle)
@@ -217,6 +599,11 @@ private:
 
     void freeHandle(HandleKey<Entity> aKey) { return mState->freeHandle(aKey); }
 
+    void eraseInArchetype(HandleKey<Archetype> aArchetype, std::span<const EntityIndex> aIndices)
+    {
+        mState->eraseInArchetype(aArchetype, aIndices, *this);
+    }
+
     template <class... VT_components>
     detail::QueryBackend<VT_components...> * getQueryBackend()
     {
@@ -271,51 +658,87 @@ private:
 //
 // NOTE: Implemented this file because it needs EntityManager definition.
 template <class T_component>
-void Handle<Entity>::add(T_component aComponent)
+bool Entity_view::has()
 {
-    EntityRecord initialRecord = record();
-    HandleKey<Archetype> initialArchetypeKey = initialRecord.mArchetype;
+    if constexpr (SparseComponent<T_component>)
+    {
+        return mReference.mManager->sparseSet<T_component>().contains(key());
+    }
+    else
+    {
+        return mReference.mArchetype->has<T_component>();
+    }
+}
 
-    HandleKey<Archetype> targetArchetypeKey =
-        mManager->extendArchetype<T_component>(
-            mManager->archetype(initialArchetypeKey));
-    Archetype & targetArchetype = mManager->archetype(targetArchetypeKey);
 
-    // The extend might have invalidate the archetype reference
-    // So take it only now.
-    Archetype & initialArchetype = mManager->archetype(initialArchetypeKey);
+template <class T_component>
+ComponentRef_t<T_component> Entity_view::get()
+{
+    if constexpr (SparseComponent<T_component>)
+    {
+        return mReference.mManager->sparseSet<T_component>().get(key());
+    }
+    else
+    {
+        return mReference.mArchetype->get<T_component>(mReference.mIndex);
+    }
+}
 
-    // The target archetype will grow by one: the size before insertion will be
-    // the inserted index.
-    EntityIndex newIndex = targetArchetype.countEntities();
-    initialArchetype.move(initialRecord.mIndex, targetArchetype, *mManager);
 
-    EntityRecord newRecord{
-        .mArchetype = targetArchetypeKey,
-        .mIndex = newIndex,
-        .mNamePtr = initialRecord.mNamePtr,
-    };
+template <class... VT_components>
+void Handle<Entity>::add(VT_components... aComponents)
+{
+    static_assert(sizeof...(VT_components) > 0, "At least one component must be added.");
+    static_assert(areDistinct<VT_components...>(), "A component type cannot be provided twice.");
 
+    if constexpr ((SparseComponent<VT_components> || ...))
+    {
+        static_assert(sizeof...(VT_components) == 1, "Sparse components must be added one at a time.");
+        // Sparse components do not change the archetype.
+        (mManager->sparseSet<VT_components>().emplace(mKey, std::move(aComponents)), ...);
+    }
+    else
+    {
+        auto place = [&aComponents...](const Archetype & aInitialArchetype,
+                                       Archetype & aTargetArchetype,
+                                       EntityIndex aIndex)
+        {
+            (placeComponent(aInitialArchetype, aTargetArchetype, aIndex, aComponents), ...);
+        };
+
+        EntityRecord initialRecord = record();
+        if constexpr (sizeof...(VT_components) == 1)
+        {
+            addAlong(mManager->extendArchetype<VT_components...>(initialRecord.mArchetype),
+                     initialRecord,
+                     place);
+        }
+        else
+        {
+            addAlong(mManager->extendArchetypeMany<VT_components...>(initialRecord.mArchetype),
+                     initialRecord,
+                     place);
+        }
+    }
+}
+
+template <class T_component>
+void Handle<Entity>::placeComponent(const Archetype & aInitialArchetype,
+                                    Archetype & aTargetArchetype,
+                                    EntityIndex aIndex,
+                                    T_component & aComponent)
+{
     // TODO ideally, we get rid of this test, so the implementations is as fast
     // as possible when the component is not present, and it is suboptimal if it
-    // is already present. The problem is with the push vs assign, and the
-    // difference in record index.
-    if (!initialArchetype.has<T_component>()) [[likely]]
+    // is already present. The problem is with the push vs assign.
+    if (!aInitialArchetype.has<T_component>()) [[likely]]
     {
-        targetArchetype.push(std::move(aComponent));
-        updateRecord(newRecord);
+        aTargetArchetype.push(std::move(aComponent));
     }
     else
     {
-        // If the component was already present, move() left the entity at the
-        // same index, in the same archetype. We need to replace the value, but
-        // there is no need to update the EntityRecord.
-        targetArchetype.get<T_component>(initialRecord.mIndex) =
-            std::move(aComponent);
-        newRecord.mIndex =
-            initialRecord
-                .mIndex; // Just for consistency, this is not used later.
-
+        // The component was already present, it was moved along with the entity:
+        // replace the value.
         // Discussion from 2023/05/27: even there might be legitimate cases
         // to get in this scenario, disallow it for the moment.
         // If it shows up, we can allow it via a parameter / distinct member
@@ -323,76 +746,76 @@ void Handle<Entity>::add(T_component aComponent)
         // --
         // But it would break tests.
         // assert(false);
+        aTargetArchetype.get<T_component>(aIndex) = std::move(aComponent);
     }
+}
 
-    // Notify the query backends that match target archetype, but not source
-    // archetype, that a new entity was added.
-    auto addedBackends =
-        mManager->getExtraQueryBackends(targetArchetype, initialArchetype);
-    for (const auto & addedQuery : addedBackends)
+template <class T_component, class... VT_args>
+void Handle<Entity>::emplace(VT_args &&... aArgs)
+{
+    if constexpr (SparseComponent<T_component>)
     {
-        // We should not pass there if this is a redundant add().
-        assert(!initialArchetype.has<T_component>());
-        addedQuery->signalEntityAdded(*this, newRecord);
+        mManager->sparseSet<T_component>().emplace(mKey, std::forward<VT_args>(aArgs)...);
+    }
+    else
+    {
+        EntityRecord initialRecord = record();
+        addAlong(mManager->extendArchetype<T_component>(initialRecord.mArchetype),
+                 initialRecord,
+                 [&aArgs...](const Archetype & aInitialArchetype,
+                             Archetype & aTargetArchetype,
+                             EntityIndex aIndex)
+                 {
+                     if (!aInitialArchetype.has<T_component>()) [[likely]]
+                     {
+                         // Constructed directly at the back of the destination store.
+                         aTargetArchetype.emplace<T_component>(std::forward<VT_args>(aArgs)...);
+                     }
+                     else
+                     {
+                         aTargetArchetype.get<T_component>(aIndex) =
+                             T_component(std::forward<VT_args>(aArgs)...);
+                     }
+                 });
     }
-
-#if defined(ENTITY_SANITIZE)
-    assert(initialArchetype.verifyHandlesConsistency(*mManager));
-    assert(targetArchetype.verifyHandlesConsistency(*mManager));
-#endif
 }
 
-template <class T_component>
-void Handle<Entity>::remove()
+template <class F_place>
+void Handle<Entity>::addAlong(const ArchetypeEdge & aEdge,
+                              const EntityRecord & aInitialRecord,
+                              F_place && aPlace)
 {
-    EntityRecord initialRecord = record();
-    HandleKey<Archetype> initialArchetypeKey = initialRecord.mArchetype;
-
-    HandleKey<Archetype> targetArchetypeKey =
-        mManager->restrictArchetype<T_component>(
-            mManager->archetype(initialArchetypeKey));
-    Archetype & targetArchetype = mManager->archetype(targetArchetypeKey);
-
+    HandleKey<Archetype> initialArchetypeKey = aInitialRecord.mArchetype;
+    Archetype & targetArchetype = mManager->archetype(aEdge.mDestination);
     Archetype & initialArchetype = mManager->archetype(initialArchetypeKey);
 
-    // Notify the query backends that match source archetype, but not target
-    // archetype, that the entity is being removed.
-    auto removedBackends =
-        mManager->getExtraQueryBackends(initialArchetype, targetArchetype);
-    for (const auto & removedQuery : removedBackends)
-    {
-        removedQuery->signalEntityRemoved(*this, initialRecord);
-    }
-
     // The target archetype will grow by one: the size before insertion will be
     // the inserted index.
     EntityIndex newIndex = targetArchetype.countEntities();
-    initialArchetype.move(initialRecord.mIndex, targetArchetype, *mManager);
+    initialArchetype.move(aInitialRecord.mIndex, targetArchetype, aEdge.mColumnMapping, *mManager);
+
+    // If all the components were already present, move() left the entity at the
+    // same index, in the same archetype. There is no need to update the EntityRecord.
+    const bool migrated = aEdge.mDestination != initialArchetypeKey;
+    aPlace(std::as_const(initialArchetype),
+           targetArchetype,
+           migrated ? newIndex : aInitialRecord.mIndex);
 
-    // If the component was not present, move() left the entity at the same
-    // index, nothing to be done.
-    if (initialArchetype.has<T_component>()) [[likely]]
+    if (migrated) [[likely]]
     {
         EntityRecord newRecord{
-            .mArchetype = targetArchetypeKey,
+            .mArchetype = aEdge.mDestination,
             .mIndex = newIndex,
-            .mNamePtr = initialRecord.mNamePtr,
         };
         updateRecord(newRecord);
-    }
-    else
-    {
-        // If the component was not present, move() left the entity at the same
-        // index, in the same archetype. There is nothing to do in this
-        // situation.
 
-        // Discussion from 2023/05/27: even there might be legitimate cases
-        // to get in this scenario, disallow it for the moment.
-        // If it shows up, we can allow it via a parameter / distinct member
-        // function.
-        // --
-        // But it would break tests.
-        // assert(false);
+        // Notify the query backends that match target archetype, but not source
+        // archetype, that a new entity was added.
+        for (const auto & addedQuery :
+             mManager->getExtraQueryBackends(targetArchetype, initialArchetype))
+        {
+            addedQuery->signalEntityAdded(*this, newRecord);
+        }
     }
 
 #if defined(ENTITY_SANITIZE)
@@ -401,6 +824,89 @@ void Handle<Entity>::remove()
 #endif
 }
 
+template <class... VT_components>
+void Handle<Entity>::remove()
+{
+    static_assert(sizeof...(VT_components) > 0, "At least one component must be removed.");
+    static_assert(areDistinct<VT_components...>(), "A component type cannot be provided twice.");
+
+    if constexpr ((SparseComponent<VT_components> || ...))
+    {
+        static_assert(sizeof...(VT_components) == 1, "Sparse components must be removed one at a time.");
+        (mManager->sparseSet<VT_components>().erase(mKey), ...);
+    }
+    else
+    {
+        EntityRecord initialRecord = record();
+        if constexpr (sizeof...(VT_components) == 1)
+        {
+            removeAlong(mManager->restrictArchetype<VT_components...>(initialRecord.mArchetype),
+                        initialRecord);
+        }
+        else
+        {
+            removeAlong(mManager->restrictArchetypeMany<VT_components...>(initialRecord.mArchetype),
+                        initialRecord);
+        }
+    }
+}
+
+template <class... VT_components>
+Handle<Entity> EntityManager::spawn(Phase & aPhase, VT_components... aComponents)
+{
+    static_assert(sizeof...(VT_components) > 0, "Use addEntity() to create an entity without components.");
+    static_assert(areDistinct<VT_components...>(), "A component type cannot be provided twice.");
+
+    Handle<Entity> handle{mState->reserveEntity(), *this};
+    aPhase.append(
+        [this, key = handle.mKey, components = std::make_tuple(std::move(aComponents)...)] () mutable
+        {
+            std::apply(
+                [this, key](VT_components &... aComponent)
+                {
+                    mState->spawnReserved(key, *this, std::move(aComponent)...);
+                },
+                components);
+        });
+    return handle;
+}
+
+inline HandleKey<Entity>
+EntityManager::InternalState::insertEntity(HandleKey<Archetype> aArchetype,
+                                           EntityIndex aIndex,
+                                           const char * aName)
+{
+    HandleKey<Entity> key = mEntities.insert(EntityRecord{
+        aArchetype,
+        aIndex,
+    });
+
+    resizeNames();
+
+    // Unnamed entities do not allocate, their name is generated on demand (see name()).
+    if (aName != nullptr)
+    {
+        detail::NameTable::NameId nameId = mNameTable.intern(aName);
+        mNames[key] = nameId;
+
+        if (nameId >= mHandleByName.size())
+        {
+            mHandleByName.resize(nameId + 1, HandleKey<Entity>::MakeLatest());
+        }
+#ifndef NDEBUG
+        if (mEntities.isValid(mHandleByName[nameId]))
+        {
+            std::cerr << "There is already a entity with name: " << aName
+                      << std::endl;
+            assert(false);
+        }
+#endif
+        mHandleByName[nameId] = key;
+    }
+
+    return key;
+}
+
 inline Handle<Entity>
 EntityManager::InternalState::addEntity(EntityManager & aManager,
                                         const char * aName)
@@ -409,33 +915,10 @@ EntityManager::InternalState::addEntity(EntityManager & aManager,
     std::pair<Archetype &, HandleKey<Archetype>> emptyArchetype =
         mArchetypes.getEmptyArchetype();
 
-    HandleKey<Entity> key = getAvailableHandle();
-
-    if (aName == nullptr)
-    {
-        std::stringstream newName;
-        newName << "Entity " << key;
-        aName = newName.str().c_str();
-    }
-
-    mHandleMap.insert_or_assign(key, EntityRecord{
-                                         emptyArchetype.second,
+    HandleKey<Entity> key = insertEntity(emptyArchetype.second,
                                          emptyArchetype.first.countEntities(),
-                                         std::make_shared<std::string>(aName),
-                                     });
-
-    handy::StringId nameId{aName};
-#ifndef NDEBUG
-    if (mHandleByNameMap.contains(nameId)
-        && mHandleByNameMap.at(nameId).isLastGeneration())
-    {
-        std::cerr << "There is already a entity with name: " << aName
-                  << std::endl;
-        assert(false);
-    }
-#endif
+                                         aName);
 
-    mHandleByNameMap.insert_or_assign(nameId, key);
     // Has to be done after taking the entity count as index, for the new
     // EntityRecord.
     emptyArchetype.first.pushKey(key);
@@ -444,27 +927,225 @@ EntityManager::InternalState::addEntity(EntityManager & aManager,
 }
 
 template <class T_component>
-HandleKey<Archetype>
-EntityManager::InternalState::extendArchetype(const Archetype & aArchetype)
+const ArchetypeEdge &
+EntityManager::InternalState::extendArchetype(HandleKey<Archetype> aSource)
 {
-    TypeSet targetTypeSet{aArchetype.getTypeSet()};
+    const Archetype & source = mArchetypes.get(aSource);
+    if (const ArchetypeEdge * edge = source.findEdge(Archetype::Transition::Add, getId<T_component>()))
+    {
+        return *edge;
+    }
+
+    TypeSet targetTypeSet{source.getTypeSet()};
     targetTypeSet.insert(getId<T_component>());
 
-    return makeArchetypeIfAbsent(
+    HandleKey<Archetype> target = makeArchetypeIfAbsent(
         targetTypeSet, std::bind(&Archetype::makeExtended<T_component>,
-                                 std::cref(aArchetype)));
+                                 std::cref(source)));
+    return insertEdges(Archetype::Transition::Add, getId<T_component>(), aSource, target);
 }
 
 template <class T_component>
-HandleKey<Archetype>
-EntityManager::InternalState::restrictArchetype(const Archetype & aArchetype)
+const ArchetypeEdge &
+EntityManager::InternalState::restrictArchetype(HandleKey<Archetype> aSource)
 {
-    TypeSet targetTypeSet{aArchetype.getTypeSet()};
+    const Archetype & source = mArchetypes.get(aSource);
+    if (const ArchetypeEdge * edge = source.findEdge(Archetype::Transition::Remove, getId<T_component>()))
+    {
+        return *edge;
+    }
+
+    TypeSet targetTypeSet{source.getTypeSet()};
     targetTypeSet.erase(getId<T_component>());
 
-    return makeArchetypeIfAbsent(
+    HandleKey<Archetype> target = makeArchetypeIfAbsent(
         targetTypeSet, std::bind(&Archetype::makeRestricted<T_component>,
-                                 std::cref(aArchetype)));
+                                 std::cref(source)));
+    return insertEdges(Archetype::Transition::Remove, getId<T_component>(), aSource, target);
+}
+
+template <class... VT_components>
+ArchetypeEdge
+EntityManager::InternalState::extendArchetypeMany(HandleKey<Archetype> aSource)
+{
+    const Archetype & source = mArchetypes.get(aSource);
+    TypeSet targetTypeSet{source.getTypeSet()};
+    (targetTypeSet.insert(getId<VT_components>()), ...);
+
+    HandleKey<Archetype> target = makeArchetypeIfAbsent(
+        targetTypeSet, std::bind(&Archetype::makeExtended<VT_components...>,
+                                 std::cref(source)));
+    return ArchetypeEdge{
+        .mDestination = target,
+        .mColumnMapping = source.computeColumnMapping(mArchetypes.get(target)),
+    };
+}
+
+template <class... VT_components>
+ArchetypeEdge
+EntityManager::InternalState::restrictArchetypeMany(HandleKey<Archetype> aSource)
+{
+    const Archetype & source = mArchetypes.get(aSource);
+    TypeSet targetTypeSet{source.getTypeSet()};
+    (targetTypeSet.erase(getId<VT_components>()), ...);
+
+    HandleKey<Archetype> target = makeArchetypeIfAbsent(
+        targetTypeSet, std::bind(&Archetype::makeRestricted<VT_components...>,
+                                 std::cref(source)));
+    return ArchetypeEdge{
+        .mDestination = target,
+        .mColumnMapping = source.computeColumnMapping(mArchetypes.get(target)),
+    };
+}
+
+template <class... VT_components>
+void EntityManager::InternalState::reserve(std::size_t aCount)
+{
+    mEntities.reserve(aCount);
+    mArchetypes.get(makeArchetype<VT_components...>()).reserve(aCount);
+}
+
+template <class... VT_components>
+HandleKey<Archetype> EntityManager::InternalState::makeArchetype()
+{
+    // Computed once per component set.
+    static const TypeSet gTargetTypeSet = getTypeSet<VT_components...>();
+    return makeArchetypeIfAbsent(gTargetTypeSet, std::bind(&Archetype::makeWith<VT_components...>,
+                                                           mArchetypes.getResource()));
+}
+
+template <class... VT_components>
+Handle<Entity>
+EntityManager::InternalState::spawn(EntityManager & aManager,
+                                    VT_components &&... aComponents)
+{
+    HandleKey<Archetype> archetypeKey = makeArchetype<VT_components...>();
+    Archetype & archetype = mArchetypes.get(archetypeKey);
+
+    // The archetype will grow by one: the size before insertion will be
+    // the inserted index.
+    HandleKey<Entity> key =
+        insertEntity(archetypeKey, archetype.countEntities(), nullptr);
+    return pushSpawned(key, archetype, aManager, std::move(aComponents)...);
+}
+
+template <class... VT_components>
+void EntityManager::InternalState::spawnReserved(HandleKey<Entity> aKey,
+                                                 EntityManager & aManager,
+                                                 VT_components &&... aComponents)
+{
+    HandleKey<Archetype> archetypeKey = makeArchetype<VT_components...>();
+    Archetype & archetype = mArchetypes.get(archetypeKey);
+
+    mEntities.insertReserved(aKey, EntityRecord{
+        archetypeKey,
+        archetype.countEntities(),
+    });
+    resizeNames();
+    pushSpawned(aKey, archetype, aManager, std::move(aComponents)...);
+}
+
+template <class... VT_components>
+Handle<Entity>
+EntityManager::InternalState::pushSpawned(HandleKey<Entity> aKey,
+                                          Archetype & aArchetype,
+                                          EntityManager & aManager,
+                                          VT_components &&... aComponents)
+{
+    (aArchetype.push(std::move(aComponents)), ...);
+    aArchetype.pushKey(aKey);
+
+    Handle<Entity> handle{aKey, aManager};
+    const EntityRecord record = mEntities.record(aKey);
+    for (detail::QueryBackendBase * query : getQueryBackendSet(aArchetype))
+    {
+        query->signalEntityAdded(handle, record);
+    }
+
+#if defined(ENTITY_SANITIZE)
+    assert(aArchetype.verifyHandlesConsistency(aManager));
+#endif
+    return handle;
+}
+
+inline void EntityManager::InternalState::resizeNames()
+{
+    if (mNames.size() < mEntities.slotCount())
+    {
+        mNames.resize(mEntities.slotCount(), detail::NameTable::gNoName);
+    }
+}
+
+template <class F_callback>
+void EntityManager::InternalState::forEachHandleInStorageOrder(F_callback && aCallback,
+                                                               EntityManager & aManager) const
+{
+    mArchetypes.forEach([&aCallback, &aManager](const Archetype & aArchetype)
+    {
+        for (HandleKey<Entity> key : aArchetype.getEntityIndices())
+        {
+            aCallback(Handle<Entity>{key, aManager});
+        }
+    });
+}
+
+template <class F_callback>
+void EntityManager::InternalState::forEachHandleParallel(F_callback && aCallback,
+                                                         std::size_t aThreadCount,
+                                                         EntityManager & aManager) const
+{
+    std::vector<std::span<const HandleKey<Entity>>> ranges;
+    std::size_t entityCount = 0;
+    mArchetypes.forEach([&](const Archetype & aArchetype)
+    {
+        if (!aArchetype.getEntityIndices().empty())
+        {
+            ranges.push_back(aArchetype.getEntityIndices());
+            entityCount += ranges.back().size();
+        }
+    });
+
+    // Visits the entities in [aFirst, aLast) of the storage order.
+    auto visit = [&ranges, &aCallback, &aManager](std::size_t aFirst, std::size_t aLast)
+    {
+        for (std::span<const HandleKey<Entity>> range : ranges)
+        {
+            if (aFirst >= range.size())
+            {
+                aFirst -= range.size();
+                aLast -= range.size();
+                continue;
+            }
+            for (std::size_t index = aFirst; index != std::min(aLast, range.size()); ++index)
+            {
+                aCallback(Handle<Entity>{range[index], aManager});
+            }
+            if (aLast <= range.size())
+            {
+                return;
+            }
+            aFirst = 0;
+            aLast -= range.size();
+        }
+    };
+
+    const std::size_t threadCount = std::clamp<std::size_t>(aThreadCount, 1, std::max<std::size_t>(entityCount, 1));
+    const std::size_t share = (entityCount + threadCount - 1) / threadCount;
+
+    std::vector<std::thread> threads;
+    threads.reserve(threadCount - 1);
+    for (std::size_t threadId = 1; threadId < threadCount; ++threadId)
+    {
+        threads.emplace_back(visit,
+                             std::min(threadId * share, entityCount),
+                             std::min((threadId + 1) * share, entityCount));
+    }
+    visit(0, std::min(share, entityCount));
+
+    for (std::thread & thread : threads)
+    {
+        thread.join();
+    }
 }
 
 template <class F_maker>
@@ -483,6 +1164,21 @@ HandleKey<Archetype> EntityManager::InternalState::makeArchetypeIfAbsent(
     return handle;
 }
 
+template <class F_predicate>
+std::size_t EntityManager::InternalState::eraseArchetypesIf(F_predicate && aPredicate)
+{
+    std::vector<HandleKey<Archetype>> erased =
+        mArchetypes.eraseIf(std::forward<F_predicate>(aPredicate));
+    if (!erased.empty())
+    {
+        for (auto & [_types, queryBackend] : mQueryBackends)
+        {
+            queryBackend->eraseArchetypes(erased);
+        }
+    }
+    return erased.size();
+}
+
 template <class... VT_components>
 detail::QueryBackend<VT_components...> *
 EntityManager::InternalState::getQueryBackend()
@@ -0,0 +1,53 @@
+#pragma once
+
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+
+namespace ad {
+namespace ent {
+
+
+/// \brief Identifies a per-entity boolean flag, registered via EntityManager::registerFlag().
+///
+/// Contrary to tag components, flags are not part of the archetype: each archetype stores
+/// one bit per entity and per flag. Flipping a flag is a single bit write,
+/// it neither migrates the entity nor notifies the queries.
+using Flag = std::uint8_t;
+
+/// \brief The maximum number of flags registered in an EntityManager.
+constexpr std::size_t gMaxFlags = 32;
+
+/// \brief A set of flags, as a mask where bit `n` represents Flag `n`.
+using FlagSet = std::uint32_t;
+
+static_assert(sizeof(FlagSet) * 8 >= gMaxFlags);
+
+
+/// \brief Restricts a Query iteration to the entities which have all the required flags set,
+/// and none of the excluded flags set.
+struct FlagFilter
+{
+    FlagFilter & require(Flag aFlag)
+    {
+        assert(aFlag < gMaxFlags);
+        mRequired |= FlagSet{1} << aFlag;
+        return *this;
+    }
+
+    FlagFilter & exclude(Flag aFlag)
+    {
+        assert(aFlag < gMaxFlags);
+        mExcluded |= FlagSet{1} << aFlag;
+        return *this;
+    }
+
+    FlagSet mRequired{0};
+    FlagSet mExcluded{0};
+};
+
+
+} // namespace ent
+} // namespace ad
@@ -58,6 +58,13 @@ public:
         return HandleKey{aIndex & gIndexMask};
     }
 
+    /// \brief Make the handle key with provided index and generation.
+    static constexpr HandleKey MakeIndex(Underlying_t aIndex, Underlying_t aGeneration)
+    {
+        assert((aIndex & gGenerationMask) == 0);
+        return HandleKey{(aGeneration << gGenerationShift) | (aIndex & gIndexMask)};
+    }
+
     constexpr bool operator==(const HandleKey & aRhs) const = default;
 
     //TODO: too dangerous !!! because things like "this | 23" removes the generation
@@ -77,11 +84,8 @@ public:
         return incremented;
     }
 
-    // TODO this being const is a massive code smell.
-    // Adressing it require to either store the generation in the EntityRecord (which is non-const in the map, contrary to the key)
-    // or replacing the map altogether, which is probably the way to go (e.g. SparseSet).
     /// \brief Increment the generation.
-    constexpr const HandleKey & advanceGeneration() const
+    constexpr HandleKey & advanceGeneration()
     {
         auto newGeneration = ((mGenerationAndIndex >> gGenerationShift) + 1) << gGenerationShift;
         mGenerationAndIndex = newGeneration | (mGenerationAndIndex & gIndexMask);
@@ -96,6 +100,14 @@ public:
         return (mGenerationAndIndex >> gGenerationShift) == gGenerationMask;
     }
 
+    constexpr Underlying_t getGeneration() const
+    { return mGenerationAndIndex >> gGenerationShift; }
+
+    /// \brief Return the complete value, including the generation.
+    /// \note Intended for hashing and serialization.
+    constexpr Underlying_t getValue() const
+    { return mGenerationAndIndex; }
+
     /// \brief Compare the index only, disregard generation.
     struct LessIndex
     {
@@ -110,8 +122,7 @@ private:
         mGenerationAndIndex{aGenerationAndIndex}
     {}
 
-    // We need to advance generation on HandleKey<Entity> used as map key (so only returned as const ref)
-    mutable Underlying_t mGenerationAndIndex;
+    Underlying_t mGenerationAndIndex;
 };
 
 
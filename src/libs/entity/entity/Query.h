@@ -2,6 +2,7 @@
 
 #include "Component.h"
 #include "EntityManager.h"
+#include "Flag.h"
 
 #include "detail/Invoker.h"
 #include "detail/QueryBackend.h"
@@ -11,7 +12,11 @@
 #include <handy/Guard.h>
 #endif
 
+#include <algorithm>
+#include <bit>
 #include <numeric>
+#include <optional>
+#include <span>
 
 
 namespace ad {
@@ -50,9 +55,48 @@ public:
     template <class F_function>
     void each(F_function && aCallback);
 
+    /// \brief Iteration over the entities matching the query and passing `aFilter`.
+    /// \details The flag columns are filtered a word (i.e. many entities) at a time,
+    /// the callback is only invoked for the selected entities.
+    template <class F_function>
+    void each(const FlagFilter & aFilter, F_function && aCallback);
+
+    /// \brief Iteration over the matching archetypes, invoking `aCallback` once per non-empty archetype
+    /// with the arrays of its components, so the loops over the entities can be vectorized.
+    /// \details The callback takes one parameter per component of the query, in order:
+    /// a std::span<T> for a component stored in a std::vector, a SoaSpan<T> for a SoaComponent.
+    /// Chunked, sparse and tag components are not supported.
+    template <class F_function>
+    void eachBatch(F_function && aCallback);
+
     template <class F_function>
     void eachPair(F_function && aCallback);
 
+    /// \brief Erase all entities matching the query for which `aPredicate` returns true.
+    /// \details The predicate takes the same arguments as an each() callback.
+    /// The removals are batched per archetype (see EntityManager::eraseAll()).
+    /// \return The number of erased entities.
+    /// \warning Not deferred: it must not be called while iterating a query.
+    template <class F_predicate>
+    std::size_t removeIf(F_predicate && aPredicate);
+
+    /// \brief Iteration over the entities of `aHandles` matching the query, in storage order.
+    /// \details The callback takes the same arguments as an each() callback.
+    /// The handles are resolved at once, then sorted by archetype and by index in the archetype,
+    /// so the stores are walked sequentially instead of accessed in the order of `aHandles`.
+    /// Invalid handles, and handles to entities not matching the query, are skipped.
+    /// A handle appearing several times is visited as many times.
+    /// \return The number of visited entities.
+    template <class F_function>
+    std::size_t eachOf(std::span<const Handle<Entity>> aHandles, F_function && aCallback);
+
+    /// \brief Copy the `T_component` of each entity of `aHandles` to the same position in `aOutput`.
+    /// \details The components are read in storage order, as with eachOf().
+    /// The positions of the skipped handles are left untouched in `aOutput`.
+    /// \return The number of gathered components.
+    template <class T_component>
+    std::size_t gather(std::span<const Handle<Entity>> aHandles, std::span<T_component> aOutput);
+
     // TODO Ad 2022/07/13: Should the query notify of the potential existence of entities
     // at the moment a EntityAdded listener is installed?
     // It was decided not to do it at the moment, revising the decision if the need arises.
@@ -67,11 +111,68 @@ public:
 private:
     void swap(Query & aRhs);
 
+    static constexpr bool gHasSparseComponents = (SparseComponent<VT_components> || ...);
+
+    using Matched_t = typename detail::QueryBackend<VT_components...>::MatchedArchetype;
+
+    /// \brief Holds the views on the sparse sets, which are the storages of the sparse components.
+    /// \details It must outlive the storages obtained from getStorages().
+    /// The entries of the other components stay empty.
+    using SparseViews_t = std::tuple<std::optional<Storage<VT_components>>...>;
+
     std::tuple<Storage<VT_components> & ...>
-    getStorages(const typename detail::QueryBackend<VT_components...>::MatchedArchetype & aMatch)
+    getStorages(const Matched_t & aMatch, SparseViews_t & aSparseViews)
+    {
+        return std::tie(getStorage<VT_components>(aMatch, aSparseViews)...);
+    }
+
+    template <class T_component>
+    Storage<T_component> & getStorage(const Matched_t & aMatch, SparseViews_t & aSparseViews)
+    {
+        if constexpr (SparseComponent<T_component>)
+        {
+            return std::get<std::optional<Storage<T_component>>>(aSparseViews)
+                .emplace(mManager->sparseSet<T_component>(), getArchetype(aMatch).getEntityIndices());
+        }
+        else
+        {
+            return getArchetype(aMatch).getStorage(
+                std::get<StorageIndex<T_component>>(aMatch.mComponentIndices));
+        }
+    }
+
+    /// \brief Return whether the entity at `aIndex` in the archetype of `aStorages` has all the sparse components.
+    /// \details This is the intersection of the archetype iteration with the sparse sets.
+    static bool hasSparseComponents(const std::tuple<Storage<VT_components> & ...> & aStorages,
+                                    EntityIndex aIndex)
+    {
+        return ([&aStorages, aIndex]()
+        {
+            if constexpr (SparseComponent<VT_components>)
+            {
+                return std::get<Storage<VT_components> &>(aStorages).contains(aIndex);
+            }
+            else
+            {
+                return true;
+            }
+        }() && ...);
+    }
+
+    /// \brief Return whether the entity `aKey` has all the sparse components.
+    bool hasSparseComponents(HandleKey<Entity> aKey) const
     {
-        return std::tie(getArchetype(aMatch).getStorage(
-            std::get<StorageIndex<VT_components>>(aMatch.mComponentIndices))...);
+        return ([this, aKey]()
+        {
+            if constexpr (SparseComponent<VT_components>)
+            {
+                return mManager->sparseSet<VT_components>().contains(aKey);
+            }
+            else
+            {
+                return true;
+            }
+        }() && ...);
     }
 
     // TODO Ad 2022/07/27 #perf p2: Have a better "handle" mechanism, e.g. an offset in an array.
@@ -83,13 +184,26 @@ private:
     const detail::QueryBackend<VT_components...> & getBackend() const
     { return *mManager->queryBackend<VT_components...>(gTypeSequence); }
 
-    using Matched_t = typename detail::QueryBackend<VT_components...>::MatchedArchetype;
     const std::vector<Matched_t> & matches() const
     { return getBackend().mMatchingArchetypes; }
 
     Archetype & getArchetype(const Matched_t & aMatch)
     { return mManager->archetype(aMatch.mArchetype); }
 
+    /// \brief An entity from the handles provided to eachOf(), located in its archetype.
+    struct Located
+    {
+        HandleKey<Archetype> mArchetype;
+        EntityIndex mIndex;
+        // Position of the handle in the provided handles.
+        std::size_t mPosition;
+    };
+
+    /// \brief Invoke `aVisitor` with the storages and the located entities of each matching archetype,
+    /// the entities of an archetype being sorted by index.
+    template <class F_visitor>
+    std::size_t visitLocated(std::span<const Handle<Entity>> aHandles, F_visitor && aVisitor);
+
     const Archetype & getArchetype(const Matched_t & aMatch) const
     { return mManager->archetype(aMatch.mArchetype); }
 
@@ -142,21 +256,37 @@ void Query<VT_components...>::swap(Query & aRhs)
 template <class... VT_components>
 std::size_t Query<VT_components...>::countMatches() const
 {
-    return std::accumulate(matches().begin(), matches().end(),
-                           std::size_t{0},
-                           [this](std::size_t accu, const auto & matched)
-                           {
-                                // note: explicitly use this, as Clang was wrongly warning that
-                                // this is unused after its capture...
-                                return accu + this->getArchetype(matched).countEntities();
-                           });
+    if constexpr (gHasSparseComponents)
+    {
+        // Each entity of the matching archetypes is tested against the sparse sets.
+        std::size_t result = 0;
+        for(const auto & matched : matches())
+        {
+            for(HandleKey<Entity> key : getArchetype(matched).getEntityIndices())
+            {
+                result += hasSparseComponents(key);
+            }
+        }
+        return result;
+    }
+    else
+    {
+        return std::accumulate(matches().begin(), matches().end(),
+                               std::size_t{0},
+                               [this](std::size_t accu, const auto & matched)
+                               {
+                                    // note: explicitly use this, as Clang was wrongly warning that
+                                    // this is unused after its capture...
+                                    return accu + this->getArchetype(matched).countEntities();
+                               });
+    }
 }
 
 
 template<class... VT_components>
 bool Query<VT_components...>::verifyArchetypes()
 {
-    const auto queryTypeSet = getTypeSet<VT_components...>();
+    const auto queryTypeSet = getArchetypeTypeSet<VT_components...>();
     for(const auto & match : matches())
     {
         auto & archetype = getArchetype(match);
@@ -208,10 +338,15 @@ void Query<VT_components...>::each(F_function && aCallback)
         // which could potentially invalidate it (such as adding a new archetype)
         // are deferred until the end of the phase.
         std::size_t size = getArchetype(match).countEntities();
-        std::tuple<Storage<VT_components> & ...> storages = getStorages(match);
-        const std::vector<HandleKey<Entity>> & handleKeys = getArchetype(match).getEntityIndices();
+        SparseViews_t sparseViews;
+        std::tuple<Storage<VT_components> & ...> storages = getStorages(match, sparseViews);
+        const EntityHandles & handleKeys = getArchetype(match).getEntityIndices();
         for(std::size_t entityId = 0; entityId != size; ++entityId)
         {
+            if (!hasSparseComponents(storages, entityId))
+            {
+                continue;
+            }
             detail::Invoker<handy::FunctionArgument_tuple<F_function>>::template invoke<VT_components...>(
                 std::forward<F_function>(aCallback),
                 Handle<Entity>{handleKeys[entityId], *mManager},
@@ -222,10 +357,233 @@ void Query<VT_components...>::each(F_function && aCallback)
 }
 
 
+template <class... VT_components>
+template <class F_function>
+void Query<VT_components...>::eachBatch(F_function && aCallback)
+{
+    static_assert(((!SparseComponent<VT_components> && !TagComponent<VT_components>) && ...),
+                  "Batches are only available for components stored in the archetype columns.");
+
+#if defined(ENTITY_SANITIZE)
+    assert(verifyArchetypes());
+#endif
+    for(const auto & match : matches())
+    {
+        if (getArchetype(match).countEntities() == 0)
+        {
+            continue;
+        }
+#if defined(ENTITY_SANITIZE)
+        auto & iterations = getArchetype(match).mCurrentQueryIterations;
+        ++iterations;
+        Guard iterationIncrementScope{[&iterations]{--iterations;}};
+#endif
+        SparseViews_t sparseViews;
+        std::apply([&aCallback](Storage<VT_components> & ... aStorages)
+                   {
+                       aCallback(aStorages.batch()...);
+                   },
+                   getStorages(match, sparseViews));
+    }
+}
+
+
+template <class... VT_components>
+template <class F_function>
+void Query<VT_components...>::each(const FlagFilter & aFilter, F_function && aCallback)
+{
+#if defined(ENTITY_SANITIZE)
+    assert(verifyArchetypes());
+#endif
+    constexpr std::size_t wordBits = detail::BitColumn::gWordBits;
+
+    for(const auto & match : matches())
+    {
+#if defined(ENTITY_SANITIZE)
+        auto & iterations = getArchetype(match).mCurrentQueryIterations;
+        ++iterations;
+        Guard iterationIncrementScope{[&iterations]{--iterations;}};
+#endif
+        const Archetype & archetype = getArchetype(match);
+        std::size_t size = archetype.countEntities();
+        SparseViews_t sparseViews;
+        std::tuple<Storage<VT_components> & ...> storages = getStorages(match, sparseViews);
+        const EntityHandles & handleKeys = archetype.getEntityIndices();
+        for(std::size_t wordIndex = 0; wordIndex * wordBits < size; ++wordIndex)
+        {
+            // The callback might change the flags: the word is selected before it is invoked.
+            for(detail::BitColumn::Word selected = archetype.selectFlagged(aFilter, wordIndex);
+                selected != 0;
+                selected &= selected - 1)
+            {
+                std::size_t entityId = wordIndex * wordBits + std::countr_zero(selected);
+                if (!hasSparseComponents(storages, entityId))
+                {
+                    continue;
+                }
+                detail::Invoker<handy::FunctionArgument_tuple<F_function>>::template invoke<VT_components...>(
+                    std::forward<F_function>(aCallback),
+                    Handle<Entity>{handleKeys[entityId], *mManager},
+                    storages,
+                    entityId);
+            }
+        }
+    }
+}
+
+
+template <class... VT_components>
+template <class F_predicate>
+std::size_t Query<VT_components...>::removeIf(F_predicate && aPredicate)
+{
+#if defined(ENTITY_SANITIZE)
+    assert(verifyArchetypes());
+#endif
+    std::size_t removedCount = 0;
+    std::vector<EntityIndex> removed;
+    for(const auto & match : matches())
+    {
+        removed.clear();
+        {
+#if defined(ENTITY_SANITIZE)
+            auto & iterations = getArchetype(match).mCurrentQueryIterations;
+            ++iterations;
+            Guard iterationIncrementScope{[&iterations]{--iterations;}};
+#endif
+            std::size_t size = getArchetype(match).countEntities();
+            SparseViews_t sparseViews;
+            std::tuple<Storage<VT_components> & ...> storages = getStorages(match, sparseViews);
+            const EntityHandles & handleKeys = getArchetype(match).getEntityIndices();
+            for(std::size_t entityId = 0; entityId != size; ++entityId)
+            {
+                if (hasSparseComponents(storages, entityId)
+                    && detail::Invoker<handy::FunctionArgument_tuple<F_predicate>>::template invoke<VT_components...>(
+                        aPredicate,
+                        Handle<Entity>{handleKeys[entityId], *mManager},
+                        storages,
+                        entityId))
+                {
+                    removed.push_back(entityId);
+                }
+            }
+        }
+        // Matching archetypes are not added nor removed by erasing entities,
+        // so the iteration over the matches can continue.
+        mManager->eraseInArchetype(match.mArchetype, removed);
+        removedCount += removed.size();
+    }
+    return removedCount;
+}
+
+
+template <class... VT_components>
+template <class F_visitor>
+std::size_t Query<VT_components...>::visitLocated(std::span<const Handle<Entity>> aHandles,
+                                                  F_visitor && aVisitor)
+{
+    std::vector<Located> located;
+    located.reserve(aHandles.size());
+    for (std::size_t position = 0; position != aHandles.size(); ++position)
+    {
+        assert(!aHandles[position].isValid() || aHandles[position].mManager == mManager);
+        if (const EntityRecord * record = mManager->findRecord(aHandles[position].mKey);
+            record != nullptr && hasSparseComponents(aHandles[position].mKey))
+        {
+            located.push_back({record->mArchetype, record->mIndex, position});
+        }
+    }
+    std::sort(located.begin(), located.end(),
+              [](const Located & aLhs, const Located & aRhs)
+              {
+                  return std::pair{aLhs.mArchetype.getValue(), aLhs.mIndex}
+                         < std::pair{aRhs.mArchetype.getValue(), aRhs.mIndex};
+              });
+
+    std::size_t visitedCount = 0;
+    for (auto groupBegin = located.begin(); groupBegin != located.end();)
+    {
+        auto groupEnd = std::find_if(groupBegin, located.end(),
+                                     [archetype = groupBegin->mArchetype](const Located & aLocated)
+                                     {
+                                         return aLocated.mArchetype != archetype;
+                                     });
+
+        // The match is looked up once per archetype, entities of non-matching archetypes are skipped.
+        auto match = std::find_if(matches().begin(), matches().end(),
+                                  [archetype = groupBegin->mArchetype](const Matched_t & aMatch)
+                                  {
+                                      return aMatch.mArchetype == archetype;
+                                  });
+        if (match != matches().end())
+        {
+#if defined(ENTITY_SANITIZE)
+            auto & iterations = getArchetype(*match).mCurrentQueryIterations;
+            ++iterations;
+            Guard iterationIncrementScope{[&iterations]{--iterations;}};
+#endif
+            SparseViews_t sparseViews;
+            aVisitor(getStorages(*match, sparseViews), std::span<const Located>{groupBegin, groupEnd});
+            visitedCount += groupEnd - groupBegin;
+        }
+        groupBegin = groupEnd;
+    }
+    return visitedCount;
+}
+
+
+template <class... VT_components>
+template <class F_function>
+std::size_t Query<VT_components...>::eachOf(std::span<const Handle<Entity>> aHandles,
+                                            F_function && aCallback)
+{
+    return visitLocated(
+        aHandles,
+        [this, &aCallback](std::tuple<Storage<VT_components> & ...> aStorages,
+                           std::span<const Located> aLocated)
+        {
+            const EntityHandles & handleKeys =
+                mManager->archetype(aLocated.front().mArchetype).getEntityIndices();
+            for (const Located & entity : aLocated)
+            {
+                detail::Invoker<handy::FunctionArgument_tuple<F_function>>::template invoke<VT_components...>(
+                    std::forward<F_function>(aCallback),
+                    Handle<Entity>{handleKeys[entity.mIndex], *mManager},
+                    aStorages,
+                    entity.mIndex);
+            }
+        });
+}
+
+
+template <class... VT_components>
+template <class T_component>
+std::size_t Query<VT_components...>::gather(std::span<const Handle<Entity>> aHandles,
+                                            std::span<T_component> aOutput)
+{
+    static_assert((std::is_same_v<T_component, VT_components> || ...),
+                  "The gathered component must be a component of the query.");
+    assert(aOutput.size() >= aHandles.size());
+
+    return visitLocated(
+        aHandles,
+        [&aOutput](std::tuple<Storage<VT_components> & ...> aStorages,
+                   std::span<const Located> aLocated)
+        {
+            Storage<T_component> & storage = std::get<Storage<T_component> &>(aStorages);
+            for (const Located & entity : aLocated)
+            {
+                aOutput[entity.mPosition] = storage[entity.mIndex];
+            }
+        });
+}
+
+
 template <class... VT_components>
 template <class F_function>
 void Query<VT_components...>::eachPair(F_function && aCallback)
 {
+    static_assert(!gHasSparseComponents, "Pair iteration does not support sparse components.");
+
 #if defined(ENTITY_SANITIZE)
     assert(verifyArchetypes());
 #endif
@@ -242,8 +600,9 @@ void Query<VT_components...>::eachPair(F_function && aCallback)
         // which could potentially invalidate it (such as adding a new archetype)
         // are deferred until the end of the phase.
         Archetype & archetypeA = getArchetype(*matchItA);
-        std::tuple<Storage<VT_components> & ...> storagesA = getStorages(*matchItA);
-        const std::vector<HandleKey<Entity>> & handleKeysA = getArchetype(*matchItA).getEntityIndices();
+        SparseViews_t sparseViewsA;
+        std::tuple<Storage<VT_components> & ...> storagesA = getStorages(*matchItA, sparseViewsA);
+        const EntityHandles & handleKeysA = getArchetype(*matchItA).getEntityIndices();
         for(std::size_t entityIdA = 0;
             entityIdA != archetypeA.countEntities();
             ++entityIdA)
@@ -274,8 +633,9 @@ void Query<VT_components...>::eachPair(F_function && aCallback)
                 Guard iterationIncrementScope{[&iterations]{--iterations;}};
 #endif
                 Archetype & archetypeB = getArchetype(*matchItB);
-                std::tuple<Storage<VT_components> & ...> storagesB = getStorages(*matchItB);
-                const std::vector<HandleKey<Entity>> & handleKeysB = getArchetype(*matchItB).getEntityIndices();
+                SparseViews_t sparseViewsB;
+                std::tuple<Storage<VT_components> & ...> storagesB = getStorages(*matchItB, sparseViewsB);
+                const EntityHandles & handleKeysB = getArchetype(*matchItB).getEntityIndices();
                 for(std::size_t entityIdB = 0;
                     entityIdB != archetypeB.countEntities();
                     ++entityIdB)
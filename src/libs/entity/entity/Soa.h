@@ -0,0 +1,423 @@
+#pragma once
+
+
+#include "Component.h"
+#include "detail/AlignedAllocator.h"
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <span>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+
+
+namespace detail {
+
+    template <class T_component>
+    class SoaVector; // forward
+
+
+    template <class>
+    struct MemberType;
+
+    template <class T_class, class T_member>
+    struct MemberType<T_member T_class::*>
+    {
+        using type = T_member;
+    };
+
+
+    template <class T_component>
+    using SoaFields_t = std::remove_cv_t<decltype(SoaFields<T_component>::gFields)>;
+
+    template <class T_component>
+    constexpr std::size_t gSoaFieldCount = std::tuple_size_v<SoaFields_t<T_component>>;
+
+    /// \brief The type of the field at `N_field` in the SoaFields list of T_component.
+    template <class T_component, std::size_t N_field>
+    using SoaField_t = typename MemberType<std::tuple_element_t<N_field, SoaFields_t<T_component>>>::type;
+
+
+    /// \brief The position of data member `F_member` in the SoaFields list of T_component.
+    template <class T_component, auto F_member>
+    constexpr std::size_t getSoaFieldIndex()
+    {
+        return []<std::size_t... VN_field>(std::index_sequence<VN_field...>)
+        {
+            std::size_t result = std::numeric_limits<std::size_t>::max();
+            ([&result]()
+            {
+                using Field_t = std::tuple_element_t<VN_field, SoaFields_t<T_component>>;
+                if constexpr (std::is_same_v<Field_t, decltype(F_member)>)
+                {
+                    if (std::get<VN_field>(SoaFields<T_component>::gFields) == F_member)
+                    {
+                        result = VN_field;
+                    }
+                }
+            }(), ...);
+            return result;
+        }(std::make_index_sequence<gSoaFieldCount<T_component>>{});
+    }
+
+} // namespace detail
+
+
+/// \brief Proxy to a SoaComponent in its storage, standing for the reference to the component.
+///
+/// Callbacks of queries including a SoaComponent take a SoaRef parameter instead of a reference
+/// (e.g. `[](SoaRef<Body> aBody){...}`). The fields are accessed by reference with get(),
+/// while the whole component can be read (conversion) or written (assignment).
+template <class T_component>
+class SoaRef
+{
+    friend class detail::SoaVector<T_component>;
+
+public:
+    /// \brief Access data member `F_member` (e.g. `aBody.get<&Body::x>()`), which must be a listed field.
+    template <auto F_member>
+    auto & get() const
+    {
+        constexpr std::size_t index = detail::getSoaFieldIndex<T_component, F_member>();
+        static_assert(index != std::numeric_limits<std::size_t>::max(),
+                      "The data member is not listed in the SoaFields of the component.");
+        return field<index>();
+    }
+
+    /// \brief Access the field at position `N_field` in the SoaFields list.
+    template <std::size_t N_field>
+    detail::SoaField_t<T_component, N_field> & field() const;
+
+    /// \brief Assemble a copy of the component.
+    operator T_component() const;
+
+    const SoaRef & operator=(const T_component & aValue) const;
+    const SoaRef & operator=(T_component && aValue) const;
+
+    /// \brief Assign the value of the referenced component (does not rebind the proxy).
+    const SoaRef & operator=(const SoaRef & aRhs) const
+    { return *this = static_cast<T_component>(aRhs); }
+
+    SoaRef(const SoaRef &) = default;
+
+private:
+    SoaRef(detail::SoaVector<T_component> & aVector, std::size_t aIndex) :
+        mVector{&aVector},
+        mIndex{aIndex}
+    {}
+
+    detail::SoaVector<T_component> * mVector;
+    std::size_t mIndex;
+};
+
+
+/// \brief The contiguous array of each field of a SoaComponent, for a whole archetype.
+/// \details Loops over a single field array can be auto-vectorized by the compiler.
+template <class T_component>
+class SoaSpan
+{
+public:
+    explicit SoaSpan(detail::SoaVector<T_component> & aVector);
+
+    std::size_t size() const
+    { return std::get<0>(mFields).size(); }
+
+    /// \brief The array of data member `F_member`, which must be a listed field.
+    template <auto F_member>
+    auto get() const
+    {
+        constexpr std::size_t index = detail::getSoaFieldIndex<T_component, F_member>();
+        static_assert(index != std::numeric_limits<std::size_t>::max(),
+                      "The data member is not listed in the SoaFields of the component.");
+        return field<index>();
+    }
+
+    /// \brief The array of the field at position `N_field` in the SoaFields list.
+    template <std::size_t N_field>
+    std::span<detail::SoaField_t<T_component, N_field>> field() const
+    { return std::get<N_field>(mFields); }
+
+private:
+    template <class>
+    struct Spans;
+
+    template <std::size_t... VN_field>
+    struct Spans<std::index_sequence<VN_field...>>
+    {
+        using type = std::tuple<std::span<detail::SoaField_t<T_component, VN_field>>...>;
+    };
+
+    typename Spans<std::make_index_sequence<detail::gSoaFieldCount<T_component>>>::type mFields;
+};
+
+
+/// \brief The type through which a component is accessed in its storage:
+/// a SoaRef for a SoaComponent, a reference otherwise.
+template <class T_component>
+using ComponentRef_t = std::conditional_t<SoaComponent<T_component>,
+                                          SoaRef<T_component>,
+                                          T_component &>;
+
+
+/// \brief The component type designated by a callback parameter of type T_parameter
+/// (either a reference to the component, or a SoaRef).
+template <class T_parameter>
+struct ComponentOf
+{
+    using type = std::decay_t<T_parameter>;
+};
+
+template <class T_component>
+struct ComponentOf<SoaRef<T_component>>
+{
+    using type = T_component;
+};
+
+template <class T_parameter>
+using Component_t = typename ComponentOf<std::decay_t<T_parameter>>::type;
+
+
+namespace detail {
+
+
+/// \brief Sequence of SoaComponents stored as one column per field (see ColumnVector),
+/// with the subset of the std::vector interface used by the component storages.
+///
+/// Elements are accessed via SoaRef proxies, and are assembled into values from their fields
+/// (so the component must be default constructible, and its listed fields must cover its value).
+template <class T_component>
+class SoaVector
+{
+    static_assert(std::is_default_constructible_v<T_component>,
+                  "SoaComponents are assembled from their fields, they must be default constructible.");
+
+    friend class SoaRef<T_component>;
+    friend class SoaSpan<T_component>;
+
+    template <class>
+    struct Columns;
+
+    template <std::size_t... VN_field>
+    struct Columns<std::index_sequence<VN_field...>>
+    {
+        using type = std::tuple<ColumnVector<SoaField_t<T_component, VN_field>, T_component>...>;
+    };
+
+    using Columns_t = typename Columns<std::make_index_sequence<gSoaFieldCount<T_component>>>::type;
+
+public:
+    SoaVector() = default;
+
+    /// \brief The columns are allocated from `aResource`.
+    explicit SoaVector(std::pmr::memory_resource * aResource) :
+        mColumns{makeColumns(aResource, std::make_index_sequence<gSoaFieldCount<T_component>>{})}
+    {}
+
+    std::size_t size() const
+    { return std::get<0>(mColumns).size(); }
+
+    bool empty() const
+    { return size() == 0; }
+
+    std::size_t capacity() const
+    { return std::get<0>(mColumns).capacity(); }
+
+    void reserve(std::size_t aCapacity)
+    { forEachColumn([aCapacity](auto & aColumn){ aColumn.reserve(aCapacity); }); }
+
+    /// \brief Reduce the capacity of each column to `aCapacity`, but not below the size.
+    void shrink(std::size_t aCapacity);
+
+    SoaRef<T_component> operator[](std::size_t aIndex)
+    {
+        assert(aIndex < size());
+        return SoaRef<T_component>{*this, aIndex};
+    }
+
+    /// \brief Assemble a copy of the element at `aIndex`.
+    T_component operator[](std::size_t aIndex) const;
+
+    SoaRef<T_component> back()
+    { return (*this)[size() - 1]; }
+
+    void push_back(const T_component & aValue);
+    void push_back(T_component && aValue);
+
+    /// \brief Push the fields of `aMoved`, moving them out of their storage.
+    void push_back(SoaRef<T_component> aMoved);
+
+    template <class... VT_args>
+    SoaRef<T_component> emplace_back(VT_args &&... aArgs)
+    {
+        push_back(T_component(std::forward<VT_args>(aArgs)...));
+        return back();
+    }
+
+    void pop_back()
+    { forEachColumn([](auto & aColumn){ aColumn.pop_back(); }); }
+
+private:
+    template <std::size_t... VN_field>
+    static Columns_t makeColumns(std::pmr::memory_resource * aResource, std::index_sequence<VN_field...>)
+    { return Columns_t{std::tuple_element_t<VN_field, Columns_t>(aResource)...}; }
+
+    template <class F_operation>
+    void forEachColumn(F_operation && aOperation)
+    { std::apply([&aOperation](auto &... aColumns){ (aOperation(aColumns), ...); }, mColumns); }
+
+    template <class F_operation>
+    void forEachField(F_operation && aOperation) const
+    {
+        [&aOperation]<std::size_t... VN_field>(std::index_sequence<VN_field...>)
+        {
+            (aOperation(std::integral_constant<std::size_t, VN_field>{}), ...);
+        }(std::make_index_sequence<gSoaFieldCount<T_component>>{});
+    }
+
+    template <std::size_t N_field>
+    static constexpr auto gMember = std::get<N_field>(SoaFields<T_component>::gFields);
+
+    Columns_t mColumns;
+};
+
+
+/// \brief Move the element designated by `aSource` onto the element designated by `aDestination`.
+/// \details Overload of the relocation of elements referenced directly, see Archetype.h.
+template <class T_component>
+void relocate(SoaRef<T_component> aDestination, SoaRef<T_component> aSource)
+{
+    [&]<std::size_t... VN_field>(std::index_sequence<VN_field...>)
+    {
+        ((aDestination.template field<VN_field>() = std::move(aSource.template field<VN_field>())), ...);
+    }(std::make_index_sequence<gSoaFieldCount<T_component>>{});
+}
+
+
+} // namespace detail
+
+
+//
+// Implementations
+//
+template <class T_component>
+template <std::size_t N_field>
+detail::SoaField_t<T_component, N_field> & SoaRef<T_component>::field() const
+{
+    return std::get<N_field>(mVector->mColumns)[mIndex];
+}
+
+
+template <class T_component>
+SoaRef<T_component>::operator T_component() const
+{
+    return std::as_const(*mVector)[mIndex];
+}
+
+
+template <class T_component>
+const SoaRef<T_component> & SoaRef<T_component>::operator=(const T_component & aValue) const
+{
+    mVector->forEachField([this, &aValue](auto aField)
+    {
+        field<aField>() = aValue.*detail::SoaVector<T_component>::template gMember<aField>;
+    });
+    return *this;
+}
+
+
+template <class T_component>
+const SoaRef<T_component> & SoaRef<T_component>::operator=(T_component && aValue) const
+{
+    mVector->forEachField([this, &aValue](auto aField)
+    {
+        field<aField>() = std::move(aValue.*detail::SoaVector<T_component>::template gMember<aField>);
+    });
+    return *this;
+}
+
+
+template <class T_component>
+SoaSpan<T_component>::SoaSpan(detail::SoaVector<T_component> & aVector) :
+    mFields{std::apply([](auto &... aColumns){ return decltype(mFields){aColumns...}; },
+                       aVector.mColumns)}
+{}
+
+
+namespace detail {
+
+
+template <class T_component>
+void SoaVector<T_component>::shrink(std::size_t aCapacity)
+{
+    aCapacity = std::max(aCapacity, size());
+    forEachColumn([aCapacity](auto & aColumn)
+    {
+        if (aColumn.capacity() > aCapacity)
+        {
+            std::remove_reference_t<decltype(aColumn)> shrunk(aColumn.get_allocator());
+            shrunk.reserve(aCapacity);
+            shrunk.insert(shrunk.end(),
+                          std::make_move_iterator(aColumn.begin()),
+                          std::make_move_iterator(aColumn.end()));
+            aColumn = std::move(shrunk);
+        }
+    });
+}
+
+
+template <class T_component>
+T_component SoaVector<T_component>::operator[](std::size_t aIndex) const
+{
+    assert(aIndex < size());
+    T_component result{};
+    forEachField([this, &result, aIndex](auto aField)
+    {
+        result.*gMember<aField> = std::get<aField>(mColumns)[aIndex];
+    });
+    return result;
+}
+
+
+template <class T_component>
+void SoaVector<T_component>::push_back(const T_component & aValue)
+{
+    forEachField([this, &aValue](auto aField)
+    {
+        std::get<aField>(mColumns).push_back(aValue.*gMember<aField>);
+    });
+}
+
+
+template <class T_component>
+void SoaVector<T_component>::push_back(T_component && aValue)
+{
+    forEachField([this, &aValue](auto aField)
+    {
+        std::get<aField>(mColumns).push_back(std::move(aValue.*gMember<aField>));
+    });
+}
+
+
+template <class T_component>
+void SoaVector<T_component>::push_back(SoaRef<T_component> aMoved)
+{
+    forEachField([this, aMoved](auto aField)
+    {
+        std::get<aField>(mColumns).push_back(std::move(aMoved.template field<aField>()));
+    });
+}
+
+
+} // namespace detail
+
+
+} // namespace ent
+} // namespace ad
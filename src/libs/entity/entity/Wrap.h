@@ -29,20 +29,19 @@ public:
     Wrap(EntityManager & aWorld, const char * aName, VT_ctorArgs &&... aCtorArgs) :
         mWrapped{aWorld.addEntity(aName)}
     {
-        // Note: one drawback is that we make one phase per initialized handle.
-        // If we were doing it manually, we could share one init phase among several stores.
-        Phase init;
+        // The stored instance is constructed in place, directly in its storage.
+        // Note: Wrap is a friend of Handle<Entity>, which allows to emplace immediately,
+        // so the arguments are forwarded (instead of being stored until a phase is flushed).
 
         // If the construction expression providing the EntityManager first is valid, select it.
         if constexpr(requires {T_stored{aWorld, std::forward<VT_ctorArgs>(aCtorArgs)...};})
         {
-            // TODO #emplace, emplace when entity offers it
-            mWrapped.get(init)->add(T_stored(aWorld, std::forward<VT_ctorArgs>(aCtorArgs)...));
+            mWrapped.emplace<T_stored>(aWorld, std::forward<VT_ctorArgs>(aCtorArgs)...);
         }
         // Otherwise, call a construction expression only providing the variadic arguments.
         else
         {
-            mWrapped.get(init)->add(T_stored(std::forward<VT_ctorArgs>(aCtorArgs)...));
+            mWrapped.emplace<T_stored>(std::forward<VT_ctorArgs>(aCtorArgs)...);
         }
     }
 
@@ -0,0 +1,93 @@
+#pragma once
+
+
+#include <entity/Component.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <limits>
+#include <memory_resource>
+#include <new>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+namespace detail {
+
+
+/// \brief Allocator returning blocks aligned to `N_alignment` (or to the alignment of T_element, if stricter),
+/// whose size is padded to a multiple of this alignment.
+/// The blocks are obtained from a std::pmr::memory_resource (by default, the default resource).
+///
+/// With the alignment of a cache line, two blocks never share a cache line,
+/// and with the alignment of a SIMD register, the block can be read by full registers
+/// up to its padded end (the padding elements are not constructed).
+template <class T_element, std::size_t N_alignment>
+class AlignedAllocator
+{
+public:
+    using value_type = T_element;
+
+    static constexpr std::size_t gAlignment = std::max(N_alignment, alignof(T_element));
+    static_assert(std::has_single_bit(gAlignment), "The alignment must be a power of two.");
+
+    template <class T_other>
+    struct rebind
+    {
+        using other = AlignedAllocator<T_other, N_alignment>;
+    };
+
+    AlignedAllocator() noexcept :
+        mResource{std::pmr::get_default_resource()}
+    {}
+
+    /*implicit*/ AlignedAllocator(std::pmr::memory_resource * aResource) noexcept :
+        mResource{aResource}
+    {}
+
+    template <class T_other>
+    AlignedAllocator(const AlignedAllocator<T_other, N_alignment> & aOther) noexcept :
+        mResource{aOther.resource()}
+    {}
+
+    T_element * allocate(std::size_t aCount)
+    {
+        return static_cast<T_element *>(mResource->allocate(getPaddedBytes(aCount), gAlignment));
+    }
+
+    void deallocate(T_element * aPointer, std::size_t aCount) noexcept
+    {
+        mResource->deallocate(aPointer, getPaddedBytes(aCount), gAlignment);
+    }
+
+    std::pmr::memory_resource * resource() const
+    { return mResource; }
+
+    /// \brief The size of the block allocated for `aCount` elements.
+    static std::size_t getPaddedBytes(std::size_t aCount)
+    {
+        if (aCount > (std::numeric_limits<std::size_t>::max() - gAlignment) / sizeof(T_element))
+        {
+            throw std::bad_array_new_length{};
+        }
+        return (aCount * sizeof(T_element) + gAlignment - 1) & ~(gAlignment - 1);
+    }
+
+    friend bool operator==(const AlignedAllocator & aLhs, const AlignedAllocator & aRhs)
+    { return *aLhs.mResource == *aRhs.mResource; }
+
+private:
+    std::pmr::memory_resource * mResource;
+};
+
+
+/// \brief The vector of T_element used as a column of T_component (a column per field for a SoaComponent).
+template <class T_element, class T_component = T_element>
+using ColumnVector = std::vector<T_element, AlignedAllocator<T_element, ColumnAlignment<T_component>::value>>;
+
+
+} // namespace detail
+} // namespace ent
+} // namespace ad
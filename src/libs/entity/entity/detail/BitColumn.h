@@ -0,0 +1,98 @@
+#pragma once
+
+
+#include <entity/Component.h>
+
+#include <span>
+#include <vector>
+
+#include <cassert>
+#include <cstdint>
+
+
+namespace ad {
+namespace ent {
+namespace detail {
+
+
+/// \brief One bit per entity of an Archetype, in the same order as the entities in its stores.
+///
+/// The words are only allocated up to the highest bit ever set:
+/// the bits past the allocated words are implicitly unset.
+/// This way, the columns of the flags which are never set in an archetype do not allocate,
+/// and there is nothing to do when entities are pushed (they start with all flags unset).
+class BitColumn
+{
+public:
+    using Word = std::uint64_t;
+    static constexpr std::size_t gWordBits = 64;
+
+    bool test(EntityIndex aIndex) const
+    {
+        return (word(aIndex / gWordBits) >> (aIndex % gWordBits)) & Word{1};
+    }
+
+    void set(EntityIndex aIndex, bool aValue)
+    {
+        std::size_t wordIndex = aIndex / gWordBits;
+        Word mask = Word{1} << (aIndex % gWordBits);
+        if (aValue)
+        {
+            if (wordIndex >= mWords.size())
+            {
+                mWords.resize(wordIndex + 1, Word{0});
+            }
+            mWords[wordIndex] |= mask;
+        }
+        else if (wordIndex < mWords.size())
+        {
+            mWords[wordIndex] &= ~mask;
+        }
+    }
+
+    /// \return The word containing the bits of entities [aWordIndex * gWordBits, (aWordIndex + 1) * gWordBits).
+    Word word(std::size_t aWordIndex) const
+    {
+        return aWordIndex < mWords.size() ? mWords[aWordIndex] : Word{0};
+    }
+
+    /// \brief Mirror detail::eraseByMoveOver(), `aLastIndex` being the index of the last entity.
+    void eraseByMoveOver(EntityIndex aErasedIndex, EntityIndex aLastIndex)
+    {
+        set(aErasedIndex, test(aLastIndex));
+        set(aLastIndex, false);
+    }
+
+    /// \brief Mirror detail::compactByRelocation().
+    void compact(std::span<const Relocation> aRelocations, std::size_t aNewSize)
+    {
+        if (mWords.empty())
+        {
+            return;
+        }
+
+        for (auto [source, destination] : aRelocations)
+        {
+            set(destination, test(source));
+        }
+        // Unset the bits past the new size, so pushed entities start unset.
+        std::size_t wordCount = (aNewSize + gWordBits - 1) / gWordBits;
+        if (wordCount < mWords.size())
+        {
+            mWords.resize(wordCount);
+        }
+        // The last word might not be allocated, its bits are then already unset.
+        if (aNewSize % gWordBits != 0 && wordCount != 0 && wordCount <= mWords.size())
+        {
+            mWords[wordCount - 1] &= (Word{1} << (aNewSize % gWordBits)) - 1;
+        }
+    }
+
+private:
+    std::vector<Word> mWords;
+};
+
+
+} // namespace detail
+} // namespace ent
+} // namespace ad
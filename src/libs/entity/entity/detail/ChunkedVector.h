@@ -0,0 +1,257 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <new>
+#include <span>
+#include <utility>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+namespace detail {
+
+
+/// \brief The size of the blocks allocated by ChunkedVector.
+constexpr std::size_t gChunkBytes = 16 * 1024;
+
+
+/// \brief Sequence of elements stored in fixed-size blocks (chunks), with the subset of
+/// the std::vector interface used by the component storages.
+///
+/// Growing allocates a new chunk, it never relocates the existing elements:
+/// the address of an element is stable until it is erased.
+/// This also bounds the cost of a push to the allocation of a single chunk.
+///
+/// All chunks are full, except the last one.
+/// Each chunk is aligned to `N_alignment` (or to the alignment of T_element, if stricter),
+/// and is allocated from a std::pmr::memory_resource (by default, the default resource).
+template <class T_element, std::size_t N_alignment = alignof(T_element)>
+class ChunkedVector
+{
+public:
+    static constexpr std::size_t gChunkCapacity = std::max<std::size_t>(1, gChunkBytes / sizeof(T_element));
+
+    ChunkedVector() = default;
+
+    explicit ChunkedVector(std::pmr::memory_resource * aResource) :
+        mResource{aResource}
+    {}
+
+    ~ChunkedVector()
+    { clear(); }
+
+    ChunkedVector(const ChunkedVector & aRhs);
+    ChunkedVector & operator=(const ChunkedVector & aRhs);
+
+    ChunkedVector(ChunkedVector && aRhs) noexcept;
+    ChunkedVector & operator=(ChunkedVector && aRhs) noexcept;
+
+    std::size_t size() const
+    { return mSize; }
+
+    bool empty() const
+    { return mSize == 0; }
+
+    T_element & operator[](std::size_t aIndex)
+    {
+        assert(aIndex < mSize);
+        return chunkData(aIndex / gChunkCapacity)[aIndex % gChunkCapacity];
+    }
+
+    const T_element & operator[](std::size_t aIndex) const
+    {
+        assert(aIndex < mSize);
+        return chunkData(aIndex / gChunkCapacity)[aIndex % gChunkCapacity];
+    }
+
+    T_element & back()
+    { return (*this)[mSize - 1]; }
+
+    template <class... VT_args>
+    T_element & emplace_back(VT_args &&... aArgs);
+
+    void push_back(const T_element & aElement)
+    { emplace_back(aElement); }
+
+    void push_back(T_element && aElement)
+    { emplace_back(std::move(aElement)); }
+
+    void pop_back();
+
+    /// \brief Destroy the elements past the first `aSize`.
+    void truncate(std::size_t aSize);
+
+    void clear()
+    { truncate(0); }
+
+    std::size_t countChunks() const
+    { return (mSize + gChunkCapacity - 1) / gChunkCapacity; }
+
+    /// \brief The count of elements the allocated chunks can hold.
+    std::size_t capacity() const
+    { return mChunks.size() * gChunkCapacity; }
+
+    /// \brief Allocate the chunks to hold at least `aCapacity` elements.
+    void reserve(std::size_t aCapacity);
+
+    /// \brief Release the chunks which are not needed to hold `aCapacity` elements (nor the current elements).
+    void shrink(std::size_t aCapacity);
+
+    /// \brief The elements stored in chunk `aChunkIndex`, which are contiguous.
+    std::span<T_element> chunk(std::size_t aChunkIndex)
+    {
+        assert(aChunkIndex < countChunks());
+        return {chunkData(aChunkIndex),
+                std::min(gChunkCapacity, mSize - aChunkIndex * gChunkCapacity)};
+    }
+
+private:
+    struct Chunk
+    {
+        alignas(std::max(N_alignment, alignof(T_element))) std::byte mBytes[sizeof(T_element) * gChunkCapacity];
+    };
+
+    /// \brief Return the chunk to the resource it was allocated from.
+    struct ChunkDeleter
+    {
+        void operator()(Chunk * aChunk) const
+        { mResource->deallocate(aChunk, sizeof(Chunk), alignof(Chunk)); }
+
+        std::pmr::memory_resource * mResource;
+    };
+
+    using ChunkPointer = std::unique_ptr<Chunk, ChunkDeleter>;
+
+    /// \brief Allocate a chunk, whose bytes are not initialized (elements are constructed in place).
+    ChunkPointer makeChunk()
+    {
+        return ChunkPointer{::new (mResource->allocate(sizeof(Chunk), alignof(Chunk))) Chunk,
+                            ChunkDeleter{mResource}};
+    }
+
+    T_element * chunkData(std::size_t aChunkIndex) const
+    { return std::launder(reinterpret_cast<T_element *>(mChunks[aChunkIndex]->mBytes)); }
+
+    // Allocated chunks are kept when elements are removed, so pushing and popping
+    // around a chunk boundary does not allocate repeatedly.
+    std::vector<ChunkPointer> mChunks;
+    std::size_t mSize{0};
+    std::pmr::memory_resource * mResource{std::pmr::get_default_resource()};
+};
+
+
+//
+// Implementations
+//
+template <class T_element, std::size_t N_alignment>
+ChunkedVector<T_element, N_alignment>::ChunkedVector(const ChunkedVector & aRhs) :
+    mResource{aRhs.mResource}
+{
+    for (std::size_t index = 0; index != aRhs.size(); ++index)
+    {
+        push_back(aRhs[index]);
+    }
+}
+
+
+template <class T_element, std::size_t N_alignment>
+ChunkedVector<T_element, N_alignment> & ChunkedVector<T_element, N_alignment>::operator=(const ChunkedVector & aRhs)
+{
+    ChunkedVector copy{aRhs};
+    *this = std::move(copy);
+    return *this;
+}
+
+
+template <class T_element, std::size_t N_alignment>
+ChunkedVector<T_element, N_alignment>::ChunkedVector(ChunkedVector && aRhs) noexcept :
+    mChunks{std::move(aRhs.mChunks)},
+    mSize{std::exchange(aRhs.mSize, 0)},
+    mResource{aRhs.mResource}
+{}
+
+
+template <class T_element, std::size_t N_alignment>
+ChunkedVector<T_element, N_alignment> & ChunkedVector<T_element, N_alignment>::operator=(ChunkedVector && aRhs) noexcept
+{
+    if (this == &aRhs)
+    {
+        return *this;
+    }
+    clear();
+    // Each chunk is released to its own resource by its deleter.
+    mChunks = std::move(aRhs.mChunks);
+    mSize = std::exchange(aRhs.mSize, 0);
+    mResource = aRhs.mResource;
+    return *this;
+}
+
+
+template <class T_element, std::size_t N_alignment>
+template <class... VT_args>
+T_element & ChunkedVector<T_element, N_alignment>::emplace_back(VT_args &&... aArgs)
+{
+    std::size_t chunkIndex = mSize / gChunkCapacity;
+    if (chunkIndex == mChunks.size())
+    {
+        mChunks.push_back(makeChunk());
+    }
+    T_element * element =
+        ::new (mChunks[chunkIndex]->mBytes + sizeof(T_element) * (mSize % gChunkCapacity))
+            T_element(std::forward<VT_args>(aArgs)...);
+    ++mSize;
+    return *element;
+}
+
+
+template <class T_element, std::size_t N_alignment>
+void ChunkedVector<T_element, N_alignment>::pop_back()
+{
+    assert(mSize > 0);
+    std::destroy_at(&back());
+    --mSize;
+}
+
+
+template <class T_element, std::size_t N_alignment>
+void ChunkedVector<T_element, N_alignment>::reserve(std::size_t aCapacity)
+{
+    while (capacity() < aCapacity)
+    {
+        mChunks.push_back(makeChunk());
+    }
+}
+
+
+template <class T_element, std::size_t N_alignment>
+void ChunkedVector<T_element, N_alignment>::shrink(std::size_t aCapacity)
+{
+    std::size_t keptChunks =
+        std::max(countChunks(), (aCapacity + gChunkCapacity - 1) / gChunkCapacity);
+    if (keptChunks < mChunks.size())
+    {
+        mChunks.resize(keptChunks);
+        mChunks.shrink_to_fit();
+    }
+}
+
+
+template <class T_element, std::size_t N_alignment>
+void ChunkedVector<T_element, N_alignment>::truncate(std::size_t aSize)
+{
+    while (mSize > aSize)
+    {
+        pop_back();
+    }
+}
+
+
+} // namespace detail
+} // namespace ent
+} // namespace ad
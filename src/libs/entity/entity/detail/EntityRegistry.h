@@ -0,0 +1,491 @@
+#pragma once
+
+
+#include <entity/Entity.h>
+#include <entity/HandleKey.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <functional>
+#include <limits>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+
+
+/// \brief Order in which the indices of erased entities are re-used by new entities.
+enum class HandleReuse
+{
+    /// \brief Oldest freed index first.
+    /// This delays the re-use of each index, so its generation advances slowly.
+    Fifo,
+    /// \brief Most recently freed index first, whose registry slot is likely still in cache.
+    Lifo,
+    /// \brief Lowest freed index first, keeping the live indices packed at the start of the registry.
+    /// This lets the registry release the most memory when it is shrunk after large despawns.
+    LowestIndex,
+};
+
+
+namespace detail {
+
+
+/// \brief Associates each HandleKey<Entity> to the EntityRecord of the handled entity.
+///
+/// The registry is a dense array of slots, directly indexed by the index part of the HandleKey.
+/// Each slot stores the complete HandleKey (i.e. including the generation) beside the record,
+/// so resolving a key is a single array access followed by a comparison of the generation.
+///
+/// The order in which freed slots are re-used is given by the HandleReuse policy.
+/// With Fifo and Lifo, the freed slots form a list hosted implicitly in the slots themselves:
+/// the record of a free slot stores the index of the next free slot.
+/// With LowestIndex, the freed indices are kept in a min-heap.
+///
+/// Keys can also be reserved concurrently, then inserted later (see reserveKey()).
+/// A reserved key is one generation past the key stored in its slot,
+/// so it is not valid until it is inserted.
+class EntityRegistry
+{
+public:
+    EntityRegistry() = default;
+    ~EntityRegistry() = default;
+
+    explicit EntityRegistry(HandleReuse aReuse) :
+        mReuse{aReuse}
+    {}
+
+    EntityRegistry(const EntityRegistry & aRhs);
+    EntityRegistry & operator=(const EntityRegistry & aRhs);
+
+    /// \brief Associate `aRecord` to an available HandleKey, which is returned.
+    /// Prefers returning a freed index, in the order of the reuse policy.
+    HandleKey<Entity> insert(EntityRecord aRecord);
+
+    /// \brief Reserve an available HandleKey, which will be associated to a record by insertReserved().
+    /// The key is not valid until then.
+    /// \note Thread safe with respect to other calls to reserveKey() and to the const members.
+    /// No other member may be called concurrently.
+    /// It is lock-free, except with HandleReuse::LowestIndex where popping the heap takes a spin lock.
+    HandleKey<Entity> reserveKey();
+
+    /// \brief Associate `aRecord` to `aKey`, which was returned by reserveKey().
+    void insertReserved(HandleKey<Entity> aKey, EntityRecord aRecord);
+
+    /// \brief Free the slot of `aKey`, advancing its generation so `aKey` is not valid anymore.
+    void erase(HandleKey<Entity> aKey);
+
+    /// \brief Return true if `aKey` is the current key of its slot, i.e. if the entity is alive.
+    bool isValid(HandleKey<Entity> aKey) const;
+
+    /// \attention `aKey` must be valid.
+    EntityRecord & record(HandleKey<Entity> aKey);
+    const EntityRecord & record(HandleKey<Entity> aKey) const;
+
+    /// \return The record associated to `aKey`, or nullptr if `aKey` is not valid.
+    EntityRecord * find(HandleKey<Entity> aKey);
+    const EntityRecord * find(HandleKey<Entity> aKey) const;
+
+    std::size_t countLive() const
+    { return mLiveCount; }
+
+    /// \brief One past the greatest index ever returned, i.e. the size of tables indexed by entity index.
+    std::size_t slotCount() const
+    { return mSlots.size(); }
+
+    HandleReuse getReusePolicy() const
+    { return mReuse; }
+
+    /// \brief Ensure that `aCount` insertions will not reallocate the registry.
+    void reserve(std::size_t aCount)
+    {
+        std::size_t availableSlots = mSlots.size() - mLiveCount;
+        if (aCount > availableSlots)
+        {
+            mSlots.reserve(mSlots.size() + (aCount - availableSlots));
+        }
+    }
+
+    /// \brief Release the free slots at the end of the registry,
+    /// so slotCount() becomes one past the highest live index.
+    /// \attention There must be no reserved key pending insertion.
+    void shrink();
+
+    /// \brief Invoke `aCallback` with the HandleKey and the EntityRecord of each live entity,
+    /// by increasing index.
+    template <class F_callback>
+    void forEachLive(F_callback && aCallback) const;
+
+private:
+    static constexpr EntityIndex gNoFreeSlot = std::numeric_limits<EntityIndex>::max();
+    /// \brief The archetype key stored in the record of free slots.
+    static constexpr HandleKey<Archetype> gFreeSlotArchetype = HandleKey<Archetype>::MakeLatest();
+
+    struct Slot
+    {
+        bool isFree() const
+        { return mRecord.mArchetype == gFreeSlotArchetype; }
+
+        HandleKey<Entity> mKey;
+        EntityRecord mRecord;
+    };
+
+    /// \brief Remove the next index to re-use from the freed indices.
+    /// \return The index, or gNoFreeSlot if no index is free.
+    EntityIndex popFree();
+    void pushFree(EntityIndex aIndex);
+
+    /// \brief The key of a slot created at `aIndex`.
+    HandleKey<Entity> makeFreshKey(EntityIndex aIndex) const
+    { return HandleKey<Entity>::MakeIndex(aIndex, mFreshGeneration); }
+
+    /// \brief Return the slot at `aIndex`, growing the registry if needed.
+    /// The slots added before `aIndex` are left free, but are not in the freed indices:
+    /// their keys were reserved by reserveKey().
+    Slot & materialize(EntityIndex aIndex);
+
+    std::vector<Slot> mSlots;
+    HandleReuse mReuse{HandleReuse::Fifo};
+    // Fifo and Lifo: the free list, whose head is the next slot to re-use.
+    // The head is atomic for reserveKey(), which pops it without locking.
+    // The tail is only maintained with Fifo, and only meaningful while the list is not empty.
+    std::atomic<EntityIndex> mFreeHead{gNoFreeSlot};
+    EntityIndex mFreeTail{gNoFreeSlot};
+    // LowestIndex: min-heap of the freed indices, and the spin lock taken by reserveKey().
+    std::vector<EntityIndex> mFreeHeap;
+    std::atomic_flag mFreeHeapLock;
+    // The next index past the freed indices, at least mSlots.size().
+    // It is greater while reserved keys are pending insertion.
+    std::atomic<EntityIndex> mNextIndex{0};
+    // The generation of the slots created from now on.
+    // It is raised by shrink(), so the keys of released slots are never issued again.
+    HandleKey<Entity>::Underlying_t mFreshGeneration{0};
+    std::size_t mLiveCount{0};
+};
+
+
+//
+// Implementations
+//
+inline EntityRegistry::EntityRegistry(const EntityRegistry & aRhs) :
+    mSlots{aRhs.mSlots},
+    mReuse{aRhs.mReuse},
+    mFreeHead{aRhs.mFreeHead.load(std::memory_order_relaxed)},
+    mFreeTail{aRhs.mFreeTail},
+    mFreeHeap{aRhs.mFreeHeap},
+    mNextIndex{aRhs.mNextIndex.load(std::memory_order_relaxed)},
+    mFreshGeneration{aRhs.mFreshGeneration},
+    mLiveCount{aRhs.mLiveCount}
+{}
+
+
+inline EntityRegistry & EntityRegistry::operator=(const EntityRegistry & aRhs)
+{
+    mSlots = aRhs.mSlots;
+    mReuse = aRhs.mReuse;
+    mFreeHead.store(aRhs.mFreeHead.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    mFreeTail = aRhs.mFreeTail;
+    mFreeHeap = aRhs.mFreeHeap;
+    mNextIndex.store(aRhs.mNextIndex.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    mFreshGeneration = aRhs.mFreshGeneration;
+    mLiveCount = aRhs.mLiveCount;
+    return *this;
+}
+
+
+inline HandleKey<Entity> EntityRegistry::insert(EntityRecord aRecord)
+{
+    ++mLiveCount;
+
+    EntityIndex freeIndex = popFree();
+    if (freeIndex == gNoFreeSlot)
+    {
+        // Not concurrent with reserveKey(), relaxed accesses are enough.
+        EntityIndex index = mNextIndex.load(std::memory_order_relaxed);
+        mNextIndex.store(index + 1, std::memory_order_relaxed);
+        if (index == mSlots.size()) [[likely]]
+        {
+            HandleKey<Entity> key = makeFreshKey(index);
+            mSlots.push_back(Slot{key, aRecord});
+            return key;
+        }
+        else
+        {
+            Slot & slot = materialize(index);
+            slot.mRecord = aRecord;
+            return slot.mKey;
+        }
+    }
+    else
+    {
+        Slot & slot = mSlots[freeIndex];
+        assert(slot.isFree());
+
+        // The generation was already advanced when the slot was freed.
+        slot.mRecord = aRecord;
+        return slot.mKey;
+    }
+}
+
+
+inline HandleKey<Entity> EntityRegistry::reserveKey()
+{
+    if (mReuse == HandleReuse::LowestIndex)
+    {
+        EntityIndex index = gNoFreeSlot;
+        while (mFreeHeapLock.test_and_set(std::memory_order_acquire))
+        {}
+        if (!mFreeHeap.empty())
+        {
+            std::pop_heap(mFreeHeap.begin(), mFreeHeap.end(), std::greater<>{});
+            index = mFreeHeap.back();
+            mFreeHeap.pop_back();
+        }
+        mFreeHeapLock.clear(std::memory_order_release);
+
+        if (index != gNoFreeSlot)
+        {
+            // The slot key is only replaced by the reserved key on insertion.
+            return HandleKey<Entity>{mSlots[index].mKey}.advanceGeneration();
+        }
+    }
+    else
+    {
+        // Pop the head of the free list.
+        // The slots are not written while keys are reserved, so reading the next index of the head is safe,
+        // and a popped slot cannot come back to the list (no ABA problem).
+        EntityIndex head = mFreeHead.load(std::memory_order_relaxed);
+        while (head != gNoFreeSlot)
+        {
+            if (mFreeHead.compare_exchange_weak(head, mSlots[head].mRecord.mIndex,
+                                                std::memory_order_relaxed))
+            {
+                // The slot key is only replaced by the reserved key on insertion.
+                return HandleKey<Entity>{mSlots[head].mKey}.advanceGeneration();
+            }
+        }
+    }
+
+    // No index is free, reserve an index past the end.
+    // The slot will be materialized with the fresh generation, the reserved key is one generation past.
+    return makeFreshKey(mNextIndex.fetch_add(1, std::memory_order_relaxed)).advanceGeneration();
+}
+
+
+inline void EntityRegistry::insertReserved(HandleKey<Entity> aKey, EntityRecord aRecord)
+{
+    Slot & slot = materialize(aKey);
+    assert(slot.isFree() && HandleKey<Entity>{slot.mKey}.advanceGeneration() == aKey);
+    slot.mKey = aKey;
+    slot.mRecord = aRecord;
+    ++mLiveCount;
+}
+
+
+inline EntityRegistry::Slot & EntityRegistry::materialize(EntityIndex aIndex)
+{
+    assert(aIndex < mNextIndex.load(std::memory_order_relaxed));
+    while (mSlots.size() <= aIndex)
+    {
+        mSlots.push_back(Slot{
+            .mKey = makeFreshKey(mSlots.size()),
+            .mRecord = {
+                .mArchetype = gFreeSlotArchetype,
+                .mIndex = gNoFreeSlot,
+            },
+        });
+    }
+    return mSlots[aIndex];
+}
+
+
+inline void EntityRegistry::erase(HandleKey<Entity> aKey)
+{
+    assert(isValid(aKey));
+
+    EntityIndex index = aKey;
+    Slot & slot = mSlots[index];
+
+    // Any existing handle to the freed entity will not compare equal anymore
+    // (and thus will not be considered to point to a valid Entity).
+    // Important: the key with advanced generation is the key returned by an `insert()` re-using the slot.
+    slot.mKey.advanceGeneration();
+    slot.mRecord = EntityRecord{
+        .mArchetype = gFreeSlotArchetype,
+        .mIndex = gNoFreeSlot,
+    };
+
+    pushFree(index);
+    --mLiveCount;
+}
+
+
+inline EntityIndex EntityRegistry::popFree()
+{
+    if (mReuse == HandleReuse::LowestIndex)
+    {
+        if (mFreeHeap.empty())
+        {
+            return gNoFreeSlot;
+        }
+        std::pop_heap(mFreeHeap.begin(), mFreeHeap.end(), std::greater<>{});
+        EntityIndex index = mFreeHeap.back();
+        mFreeHeap.pop_back();
+        return index;
+    }
+    else
+    {
+        // Not concurrent with reserveKey(), relaxed accesses are enough.
+        EntityIndex head = mFreeHead.load(std::memory_order_relaxed);
+        if (head != gNoFreeSlot)
+        {
+            mFreeHead.store(mSlots[head].mRecord.mIndex, std::memory_order_relaxed);
+        }
+        return head;
+    }
+}
+
+
+inline void EntityRegistry::pushFree(EntityIndex aIndex)
+{
+    switch (mReuse)
+    {
+        case HandleReuse::Fifo:
+            // The slot becomes the tail of the list.
+            // The tail is stale once the list was emptied, notably by reserveKey().
+            if (mFreeHead.load(std::memory_order_relaxed) == gNoFreeSlot)
+            {
+                mFreeHead.store(aIndex, std::memory_order_relaxed);
+            }
+            else
+            {
+                mSlots[mFreeTail].mRecord.mIndex = aIndex;
+            }
+            mFreeTail = aIndex;
+            break;
+        case HandleReuse::Lifo:
+            // The slot becomes the head of the list.
+            mSlots[aIndex].mRecord.mIndex = mFreeHead.load(std::memory_order_relaxed);
+            mFreeHead.store(aIndex, std::memory_order_relaxed);
+            break;
+        case HandleReuse::LowestIndex:
+            mFreeHeap.push_back(aIndex);
+            std::push_heap(mFreeHeap.begin(), mFreeHeap.end(), std::greater<>{});
+            break;
+    }
+}
+
+
+inline void EntityRegistry::shrink()
+{
+    assert(mNextIndex.load(std::memory_order_relaxed) == mSlots.size());
+
+    std::size_t newSize = mSlots.size();
+    while (newSize != 0 && mSlots[newSize - 1].isFree())
+    {
+        --newSize;
+        // No handle holds the current key of a free slot, but it might hold any older key.
+        // Starting the slots created later at the greatest generation of the released slots
+        // guarantees a stale handle never becomes valid again.
+        mFreshGeneration = std::max(mFreshGeneration, mSlots[newSize].mKey.getGeneration());
+    }
+
+    if (newSize == mSlots.size())
+    {
+        return;
+    }
+
+    // Remove the released indices from the freed indices, preserving the order of the others.
+    if (mReuse == HandleReuse::LowestIndex)
+    {
+        std::erase_if(mFreeHeap, [newSize](EntityIndex aIndex){ return aIndex >= newSize; });
+        std::make_heap(mFreeHeap.begin(), mFreeHeap.end(), std::greater<>{});
+    }
+    else
+    {
+        EntityIndex newHead = gNoFreeSlot;
+        EntityIndex newTail = gNoFreeSlot;
+        for (EntityIndex current = mFreeHead.load(std::memory_order_relaxed);
+             current != gNoFreeSlot;
+             current = mSlots[current].mRecord.mIndex)
+        {
+            if (current < newSize)
+            {
+                if (newTail == gNoFreeSlot)
+                {
+                    newHead = current;
+                }
+                else
+                {
+                    mSlots[newTail].mRecord.mIndex = current;
+                }
+                newTail = current;
+            }
+        }
+        if (newTail != gNoFreeSlot)
+        {
+            mSlots[newTail].mRecord.mIndex = gNoFreeSlot;
+        }
+        mFreeHead.store(newHead, std::memory_order_relaxed);
+        mFreeTail = newTail;
+    }
+
+    mSlots.erase(mSlots.begin() + newSize, mSlots.end());
+    mSlots.shrink_to_fit();
+    mNextIndex.store(newSize, std::memory_order_relaxed);
+}
+
+
+inline bool EntityRegistry::isValid(HandleKey<Entity> aKey) const
+{
+    // The bound check notably rejects the key of default constructed handles.
+    // Note: the key of a free slot is not held by any handle (see erase() and reserveKey()).
+    EntityIndex index = aKey;
+    return index < mSlots.size() && mSlots[index].mKey == aKey;
+}
+
+
+inline EntityRecord & EntityRegistry::record(HandleKey<Entity> aKey)
+{
+    assert(isValid(aKey));
+    return mSlots[aKey].mRecord;
+}
+
+
+inline const EntityRecord & EntityRegistry::record(HandleKey<Entity> aKey) const
+{
+    assert(isValid(aKey));
+    return mSlots[aKey].mRecord;
+}
+
+
+inline EntityRecord * EntityRegistry::find(HandleKey<Entity> aKey)
+{
+    return isValid(aKey) ? &mSlots[aKey].mRecord : nullptr;
+}
+
+
+inline const EntityRecord * EntityRegistry::find(HandleKey<Entity> aKey) const
+{
+    return isValid(aKey) ? &mSlots[aKey].mRecord : nullptr;
+}
+
+
+template <class F_callback>
+void EntityRegistry::forEachLive(F_callback && aCallback) const
+{
+    for (const Slot & slot : mSlots)
+    {
+        if (!slot.isFree())
+        {
+            aCallback(slot.mKey, slot.mRecord);
+        }
+    }
+}
+
+
+} // namespace detail
+} // namespace ent
+} // namespace ad
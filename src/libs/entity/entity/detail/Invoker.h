@@ -22,23 +22,23 @@ template <class... VT_callbackArgs>
 struct Invoker<std::tuple<VT_callbackArgs...>>
 {
     template <class... VT_components, class F_callback>
-    static void invoke(F_callback aCallback,
-                       std::tuple<Storage<VT_components> & ...> aStorages,
-                       EntityIndex aIndexInArchetype)
+    static decltype(auto) invoke(F_callback aCallback,
+                                 std::tuple<Storage<VT_components> & ...> aStorages,
+                                 EntityIndex aIndexInArchetype)
     {
         // get on the callback arguments types in order to allow 
         // callback taking a subset of components / out of order components.
-        aCallback(std::get<Storage<std::decay_t<VT_callbackArgs>> &>(aStorages)
+        return aCallback(std::get<Storage<Component_t<VT_callbackArgs>> &>(aStorages)
                     .mArray[aIndexInArchetype]...);
     }
 
     template <class... VT_components, class F_callback>
-    static void invoke(F_callback && aCallback,
-                       Handle<Entity> aHandle,
-                       std::tuple<Storage<VT_components> & ...> aStorages,
-                       EntityIndex aIndexInArchetype)
+    static decltype(auto) invoke(F_callback && aCallback,
+                                 Handle<Entity> aHandle,
+                                 std::tuple<Storage<VT_components> & ...> aStorages,
+                                 EntityIndex aIndexInArchetype)
     {
-        invoke(std::forward<F_callback>(aCallback), aStorages, aIndexInArchetype);
+        return invoke(std::forward<F_callback>(aCallback), aStorages, aIndexInArchetype);
     }
 };
 
@@ -48,13 +48,13 @@ template <class... VT_callbackArgs>
 struct Invoker<std::tuple<Handle<Entity>, VT_callbackArgs...>>
 {
     template <class... VT_components, class F_callback>
-    static void invoke(F_callback aCallback,
-                       Handle<Entity> aHandle,
-                       std::tuple<Storage<VT_components> & ...> aStorages,
-                       EntityIndex aIndexInArchetype)
+    static decltype(auto) invoke(F_callback aCallback,
+                                 Handle<Entity> aHandle,
+                                 std::tuple<Storage<VT_components> & ...> aStorages,
+                                 EntityIndex aIndexInArchetype)
     {
-        aCallback(aHandle,
-                  std::get<Storage<std::decay_t<VT_callbackArgs>> &>(aStorages)
+        return aCallback(aHandle,
+                  std::get<Storage<Component_t<VT_callbackArgs>> &>(aStorages)
                     .mArray[aIndexInArchetype]...);
     }
 };
@@ -110,11 +110,11 @@ struct InvokerPair<std::tuple<Handle<Entity>, std::tuple<VT_callbackArgsLeft...>
         // Note: not using std::make_tuple, because it deduces the target types by decaying the parameters type.
         aCallback(aHandleA,
                   std::tuple<VT_callbackArgsLeft...>{
-                      std::get<Storage<std::decay_t<VT_callbackArgsLeft>> &>(aStoragesA)
+                      std::get<Storage<Component_t<VT_callbackArgsLeft>> &>(aStoragesA)
                         .mArray[aIndexInArchetypeA]...},
                   aHandleB,  
                   std::tuple<VT_callbackArgsRight...>{
-                      std::get<Storage<std::decay_t<VT_callbackArgsRight>> &>(aStoragesB)
+                      std::get<Storage<Component_t<VT_callbackArgsRight>> &>(aStoragesB)
                         .mArray[aIndexInArchetypeB]...});
     }
 };
@@ -0,0 +1,382 @@
+#pragma once
+
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+namespace detail {
+
+
+/// \brief FNV-1a hash of a name.
+constexpr std::uint64_t hashName(std::string_view aName)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (char character : aName)
+    {
+        hash ^= static_cast<unsigned char>(character);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+
+/// \brief Interned strings, stored in an arena owned by the table.
+///
+/// Each distinct string is stored once, null-terminated, in large blocks of characters.
+/// Blocks are never reallocated, so the `const char *` returned by get() remains valid
+/// until the string is released.
+/// The strings are identified by a NameId, which remains valid when the table is copied.
+///
+/// Strings are reference counted: when the last reference is released, the NameId is recycled,
+/// and a block whose strings were all released is freed.
+/// The lookup by name uses a flat open-addressing hash table of NameIds.
+class NameTable
+{
+public:
+    using NameId = std::uint32_t;
+
+    /// \brief The id associated to no name.
+    static constexpr NameId gNoName = std::numeric_limits<NameId>::max();
+
+    NameTable() = default;
+    ~NameTable() = default;
+
+    NameTable(const NameTable & aRhs);
+    NameTable & operator=(const NameTable & aRhs);
+
+    NameTable(NameTable && aRhs) = default;
+    NameTable & operator=(NameTable && aRhs) = default;
+
+    /// \brief Return the id of `aName`, storing it in the arena if it was not already present.
+    /// \note Each call adds a reference to the returned id, to be balanced by a call to release().
+    NameId intern(std::string_view aName);
+
+    /// \brief Remove a reference to `aId`, the string is discarded when no reference remains.
+    void release(NameId aId);
+
+    /// \return The id of `aName`, or gNoName if it is not present.
+    NameId find(std::string_view aName) const
+    { return find(aName, hashName(aName)); }
+
+    /// \brief Overload taking the precomputed hash of `aName`.
+    NameId find(std::string_view aName, std::uint64_t aHash) const;
+
+    /// \return The null-terminated string for `aId`.
+    const char * get(NameId aId) const;
+
+    /// \brief Number of distinct strings currently stored.
+    std::size_t size() const
+    { return mStrings.size() - mFreeIds.size(); }
+
+private:
+    static constexpr std::size_t gBlockSize = 16 * 1024;
+    static constexpr std::uint32_t gNoBlock = std::numeric_limits<std::uint32_t>::max();
+
+    struct StringLocation
+    {
+        std::uint64_t mHash;
+        std::uint32_t mBlock{gNoBlock}; // gNoBlock for recycled ids.
+        std::uint32_t mOffset;
+        std::uint32_t mLength;
+        std::uint32_t mReferences;
+    };
+
+    struct Block
+    {
+        std::unique_ptr<char[]> mCharacters;
+        std::size_t mSize;
+        // Count of not released strings in the block.
+        std::size_t mLiveStrings{0};
+    };
+
+    std::string_view view(const StringLocation & aLocation) const
+    { return {mBlocks[aLocation.mBlock].mCharacters.get() + aLocation.mOffset, aLocation.mLength}; }
+
+    /// \return The bucket position where `aHash` probing starts.
+    std::size_t home(std::uint64_t aHash) const
+    { return static_cast<std::size_t>(aHash) & (mBuckets.size() - 1); }
+
+    std::uint32_t allocateBlock(std::size_t aSize);
+    void insertBucket(NameId aId);
+    void eraseBucket(NameId aId);
+    void rehash(std::size_t aBucketCount);
+
+    void swap(NameTable & aRhs);
+
+    std::vector<Block> mBlocks;
+    std::vector<std::uint32_t> mFreeBlocks;
+    // Index of the block receiving new strings.
+    std::uint32_t mCurrentBlock{gNoBlock};
+    std::size_t mCurrentBlockUsed{0};
+
+    // Indexed by NameId.
+    std::vector<StringLocation> mStrings;
+    std::vector<NameId> mFreeIds;
+
+    // Open addressing with linear probing, the size is a power of two (or zero).
+    // Each bucket stores a NameId, or gNoName if it is empty.
+    std::vector<NameId> mBuckets;
+};
+
+
+//
+// Implementations
+//
+inline NameTable::NameTable(const NameTable & aRhs) :
+    mFreeBlocks{aRhs.mFreeBlocks},
+    mCurrentBlock{aRhs.mCurrentBlock},
+    mCurrentBlockUsed{aRhs.mCurrentBlockUsed},
+    mStrings{aRhs.mStrings},
+    mFreeIds{aRhs.mFreeIds},
+    mBuckets{aRhs.mBuckets}
+{
+    mBlocks.reserve(aRhs.mBlocks.size());
+    for (const Block & block : aRhs.mBlocks)
+    {
+        Block & copy = mBlocks.emplace_back(Block{
+            .mCharacters = nullptr,
+            .mSize = block.mSize,
+            .mLiveStrings = block.mLiveStrings,
+        });
+        if (block.mCharacters)
+        {
+            copy.mCharacters = std::make_unique_for_overwrite<char[]>(block.mSize);
+            std::memcpy(copy.mCharacters.get(), block.mCharacters.get(), block.mSize);
+        }
+    }
+}
+
+
+inline NameTable & NameTable::operator=(const NameTable & aRhs)
+{
+    NameTable copy{aRhs};
+    swap(copy);
+    return *this;
+}
+
+
+inline void NameTable::swap(NameTable & aRhs)
+{
+    std::swap(mBlocks, aRhs.mBlocks);
+    std::swap(mFreeBlocks, aRhs.mFreeBlocks);
+    std::swap(mCurrentBlock, aRhs.mCurrentBlock);
+    std::swap(mCurrentBlockUsed, aRhs.mCurrentBlockUsed);
+    std::swap(mStrings, aRhs.mStrings);
+    std::swap(mFreeIds, aRhs.mFreeIds);
+    std::swap(mBuckets, aRhs.mBuckets);
+}
+
+
+inline NameTable::NameId NameTable::intern(std::string_view aName)
+{
+    const std::uint64_t hash = hashName(aName);
+    if (NameId found = find(aName, hash); found != gNoName)
+    {
+        ++mStrings[found].mReferences;
+        return found;
+    }
+
+    const std::size_t required = aName.size() + 1; // null terminator
+    if (mCurrentBlock == gNoBlock
+        || required > mBlocks[mCurrentBlock].mSize - mCurrentBlockUsed)
+    {
+        // Names larger than a block get a dedicated block.
+        mCurrentBlock = allocateBlock(std::max(gBlockSize, required));
+        mCurrentBlockUsed = 0;
+    }
+
+    Block & block = mBlocks[mCurrentBlock];
+    char * destination = block.mCharacters.get() + mCurrentBlockUsed;
+    std::memcpy(destination, aName.data(), aName.size());
+    destination[aName.size()] = '\0';
+    ++block.mLiveStrings;
+
+    StringLocation location{
+        .mHash = hash,
+        .mBlock = mCurrentBlock,
+        .mOffset = static_cast<std::uint32_t>(mCurrentBlockUsed),
+        .mLength = static_cast<std::uint32_t>(aName.size()),
+        .mReferences = 1,
+    };
+    mCurrentBlockUsed += required;
+
+    NameId id;
+    if (mFreeIds.empty())
+    {
+        assert(mStrings.size() < gNoName);
+        id = static_cast<NameId>(mStrings.size());
+        mStrings.push_back(location);
+    }
+    else
+    {
+        id = mFreeIds.back();
+        mFreeIds.pop_back();
+        mStrings[id] = location;
+    }
+
+    insertBucket(id);
+    return id;
+}
+
+
+inline void NameTable::release(NameId aId)
+{
+    StringLocation & location = mStrings[aId];
+    assert(location.mBlock != gNoBlock && location.mReferences > 0);
+
+    if (--location.mReferences == 0)
+    {
+        eraseBucket(aId);
+
+        Block & block = mBlocks[location.mBlock];
+        // The current block is kept, since it still receives new strings.
+        if (--block.mLiveStrings == 0 && location.mBlock != mCurrentBlock)
+        {
+            block.mCharacters.reset();
+            mFreeBlocks.push_back(location.mBlock);
+        }
+
+        location.mBlock = gNoBlock;
+        mFreeIds.push_back(aId);
+    }
+}
+
+
+inline NameTable::NameId NameTable::find(std::string_view aName, std::uint64_t aHash) const
+{
+    if (mBuckets.empty())
+    {
+        return gNoName;
+    }
+
+    for (std::size_t position = home(aHash);
+         mBuckets[position] != gNoName;
+         position = (position + 1) & (mBuckets.size() - 1))
+    {
+        const StringLocation & location = mStrings[mBuckets[position]];
+        if (location.mHash == aHash && view(location) == aName)
+        {
+            return mBuckets[position];
+        }
+    }
+    return gNoName;
+}
+
+
+inline const char * NameTable::get(NameId aId) const
+{
+    assert(aId < mStrings.size() && mStrings[aId].mBlock != gNoBlock);
+    const StringLocation & location = mStrings[aId];
+    return mBlocks[location.mBlock].mCharacters.get() + location.mOffset;
+}
+
+
+inline std::uint32_t NameTable::allocateBlock(std::size_t aSize)
+{
+    // The previous current block might have had all its strings released already.
+    if (mCurrentBlock != gNoBlock && mBlocks[mCurrentBlock].mLiveStrings == 0)
+    {
+        mBlocks[mCurrentBlock].mCharacters.reset();
+        mFreeBlocks.push_back(mCurrentBlock);
+    }
+
+    Block block{
+        .mCharacters = std::make_unique_for_overwrite<char[]>(aSize),
+        .mSize = aSize,
+    };
+
+    if (mFreeBlocks.empty())
+    {
+        mBlocks.push_back(std::move(block));
+        return static_cast<std::uint32_t>(mBlocks.size() - 1);
+    }
+    else
+    {
+        std::uint32_t blockId = mFreeBlocks.back();
+        mFreeBlocks.pop_back();
+        mBlocks[blockId] = std::move(block);
+        return blockId;
+    }
+}
+
+
+inline void NameTable::insertBucket(NameId aId)
+{
+    // Keep the load factor at or below 1/2.
+    // Note: size() already accounts for aId.
+    if (2 * size() > mBuckets.size())
+    {
+        // The rehash inserts all the strings, including aId.
+        rehash(std::max<std::size_t>(16, 2 * mBuckets.size()));
+        return;
+    }
+
+    std::size_t position = home(mStrings[aId].mHash);
+    while (mBuckets[position] != gNoName)
+    {
+        position = (position + 1) & (mBuckets.size() - 1);
+    }
+    mBuckets[position] = aId;
+}
+
+
+inline void NameTable::eraseBucket(NameId aId)
+{
+    const std::size_t mask = mBuckets.size() - 1;
+
+    std::size_t hole = home(mStrings[aId].mHash);
+    while (mBuckets[hole] != aId)
+    {
+        hole = (hole + 1) & mask;
+    }
+
+    // Backward shift deletion: move back the following entries of the cluster
+    // which would not be reachable anymore from their home position.
+    for (std::size_t position = (hole + 1) & mask;
+         mBuckets[position] != gNoName;
+         position = (position + 1) & mask)
+    {
+        std::size_t entryHome = home(mStrings[mBuckets[position]].mHash);
+        // True if entryHome is cyclically in (hole, position].
+        bool homeAfterHole = (position > hole) ? (entryHome > hole && entryHome <= position)
+                                               : (entryHome > hole || entryHome <= position);
+        if (!homeAfterHole)
+        {
+            mBuckets[hole] = mBuckets[position];
+            hole = position;
+        }
+    }
+    mBuckets[hole] = gNoName;
+}
+
+
+inline void NameTable::rehash(std::size_t aBucketCount)
+{
+    mBuckets.assign(aBucketCount, gNoName);
+    for (NameId id = 0; id != mStrings.size(); ++id)
+    {
+        if (mStrings[id].mBlock != gNoBlock)
+        {
+            std::size_t position = home(mStrings[id].mHash);
+            while (mBuckets[position] != gNoName)
+            {
+                position = (position + 1) & (mBuckets.size() - 1);
+            }
+            mBuckets[position] = id;
+        }
+    }
+}
+
+
+} // namespace detail
+} // namespace ent
+} // namespace ad
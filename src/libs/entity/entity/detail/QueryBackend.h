@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <concepts>
 #include <list>
+#include <span>
 
 
 namespace ad {
@@ -20,6 +21,17 @@ namespace ent {
 namespace detail {
 
 
+/// \brief Return true if the entities of an archetype with `aArchetypeTypeSet`
+/// should be visited by a query with `aQueryTypeSet`.
+/// \note Blueprints are never visited by queries.
+inline bool isMatching(const TypeSet & aArchetypeTypeSet, const TypeSet & aQueryTypeSet)
+{
+    return std::includes(aArchetypeTypeSet.begin(), aArchetypeTypeSet.end(),
+                         aQueryTypeSet.begin(), aQueryTypeSet.end())
+           && !aArchetypeTypeSet.contains(getId<Blueprint>());
+}
+
+
 class QueryBackendBase
 {
 public:
@@ -30,8 +42,15 @@ public:
     virtual void pushIfMatches(const TypeSet & aCandidateTypeSet,
                                HandleKey<Archetype> aCandidate,
                                const ArchetypeStore & aStore) = 0;
+    /// \brief Forget the archetypes in `aErased`, which were destroyed.
+    virtual void eraseArchetypes(std::span<const HandleKey<Archetype>> aErased) = 0;
     virtual void signalEntityAdded(Handle<Entity> aEntity, const EntityRecord & aRecord) = 0;
     virtual void signalEntityRemoved(Handle<Entity> aEntity, const EntityRecord & aRecord) = 0;
+    /// \brief Signal the removal of the entities at `aIndices` in `aArchetype`, which is a matching archetype.
+    virtual void signalEntitiesRemoved(HandleKey<Archetype> aArchetypeKey,
+                                       Archetype & aArchetype,
+                                       std::span<const EntityIndex> aIndices,
+                                       EntityManager & aManager) = 0;
 };
 
 
@@ -108,8 +127,8 @@ public:
         std::tuple<StorageIndex<VT_components>...> mComponentIndices;
     };
 
-    using AddedEntityCallback = std::function<void(Handle<Entity>, VT_components &...)>;
-    using RemovedEntityCallback = std::function<void(Handle<Entity>, VT_components &...)>;
+    using AddedEntityCallback = std::function<void(Handle<Entity>, ComponentRef_t<VT_components>...)>;
+    using RemovedEntityCallback = std::function<void(Handle<Entity>, ComponentRef_t<VT_components>...)>;
 
     QueryBackend(const ArchetypeStore & aArchetypes);
 
@@ -125,17 +144,27 @@ public:
                        HandleKey<Archetype> aCandidate,
                        const ArchetypeStore & aStore) final;
 
+    void eraseArchetypes(std::span<const HandleKey<Archetype>> aErased) final;
+
     void signalEntityAdded(Handle<Entity> aEntity, const EntityRecord & aRecord) final;
 
     void signalEntityRemoved(Handle<Entity> aEntity, const EntityRecord & aRecord) final;
 
+    void signalEntitiesRemoved(HandleKey<Archetype> aArchetypeKey,
+                               Archetype & aArchetype,
+                               std::span<const EntityIndex> aIndices,
+                               EntityManager & aManager) final;
+
     template <class T_range>
     void signal_impl(Handle<Entity> aEntity,
                      const EntityRecord & aRecord,
                      const T_range & aListeners) const;
 
+    /// \brief The components which must be in the signature of the matching archetypes.
     static const TypeSet & GetTypeSet();
 
+    static constexpr bool gHasSparseComponents = (SparseComponent<VT_components> || ...);
+
     std::vector<MatchedArchetype> mMatchingArchetypes;
     // A list, because we can delete in the middle, and it should not invalidate other iterators.
     HandledStore<AddedEntityCallback> mAddListeners;
@@ -178,6 +207,9 @@ template <class... VT_components>
 template <class F_function>
 Listening QueryBackend<VT_components...>::listenEntityAdded(F_function && aCallback)
 {
+    // Adding or removing a sparse component does not change the archetype,
+    // the EntityManager does not notify the backends of such changes.
+    static_assert(!gHasSparseComponents, "Queries with sparse components cannot be listened to.");
     auto inserted = mAddListeners.emplace(std::forward<F_function>(aCallback));
     return Listening{
         this,
@@ -193,6 +225,7 @@ template <class... VT_components>
 template <class F_function>
 Listening QueryBackend<VT_components...>::listenEntityRemoved(F_function && aCallback)
 {
+    static_assert(!gHasSparseComponents, "Queries with sparse components cannot be listened to.");
     auto inserted = mRemoveListeners.emplace(std::forward<F_function>(aCallback));
     return Listening{
         this,
@@ -209,19 +242,24 @@ void QueryBackend<VT_components...>::pushIfMatches(const TypeSet & aCandidateTyp
                                                    HandleKey<Archetype> aCandidate,
                                                    const ArchetypeStore & aStore)
 {
-    if(std::includes(aCandidateTypeSet.begin(), aCandidateTypeSet.end(),
-                     GetTypeSet().begin(), GetTypeSet().end()) &&
-                     std::find(
-                         aCandidateTypeSet.begin(),
-                         aCandidateTypeSet.end(),
-                         getId<Blueprint>()
-                     ) == aCandidateTypeSet.end())
+    if(isMatching(aCandidateTypeSet, GetTypeSet()))
     {
         mMatchingArchetypes.emplace_back(aCandidate, aStore);
     }
 }
 
 
+template <class... VT_components>
+void QueryBackend<VT_components...>::eraseArchetypes(std::span<const HandleKey<Archetype>> aErased)
+{
+    std::erase_if(mMatchingArchetypes,
+                  [aErased](const MatchedArchetype & aMatch)
+                  {
+                      return std::find(aErased.begin(), aErased.end(), aMatch.mArchetype) != aErased.end();
+                  });
+}
+
+
 template <class... VT_components>
 void QueryBackend<VT_components...>::signalEntityAdded(Handle<Entity> aEntity, const EntityRecord & aRecord)
 {
@@ -236,6 +274,53 @@ void QueryBackend<VT_components...>::signalEntityRemoved(Handle<Entity> aEntity,
 }
 
 
+template <class... VT_components>
+void QueryBackend<VT_components...>::signalEntitiesRemoved(HandleKey<Archetype> aArchetypeKey,
+                                                           Archetype & aArchetype,
+                                                           std::span<const EntityIndex> aIndices,
+                                                           EntityManager & aManager)
+{
+    // The queries with sparse components are never signaled, see listenEntityAdded().
+    if constexpr (gHasSparseComponents)
+    {
+        return;
+    }
+    else
+    {
+        if (mRemoveListeners.empty())
+        {
+            return;
+        }
+
+        // The match and the storages are looked up once for all the entities.
+        auto found =
+            std::find_if(mMatchingArchetypes.begin(),
+                         mMatchingArchetypes.end(),
+                         [aArchetypeKey](const auto & aMatch) -> bool
+                         {
+                           return aMatch.mArchetype == aArchetypeKey;
+                         });
+        assert(found != mMatchingArchetypes.end());
+
+        std::tuple<Storage<VT_components> & ...> storages =
+            std::tie(
+                aArchetype.getStorage(
+                    std::get<StorageIndex<VT_components>>(found->mComponentIndices))...);
+        const EntityHandles & handleKeys = aArchetype.getEntityIndices();
+        for (EntityIndex index : aIndices)
+        {
+            assert(index < aArchetype.countEntities());
+            for(auto & [_handle, callback] : mRemoveListeners)
+            {
+                Invoker<std::tuple<Handle<Entity>, VT_components...>>::template invoke<VT_components...>(
+                        callback,
+                        Handle<Entity>{handleKeys[index], aManager}, storages, index);
+            }
+        }
+    }
+}
+
+
 template <class... VT_components>
 template <class T_range>
 void QueryBackend<VT_components...>::signal_impl(
@@ -243,35 +328,42 @@ void QueryBackend<VT_components...>::signal_impl(
         const EntityRecord & aRecord,
         const T_range & aListeners) const
 {
-    auto found =
-        std::find_if(mMatchingArchetypes.begin(),
-                     mMatchingArchetypes.end(),
-                     [&aEntity](const auto & aMatch) -> bool
-                     {
-                       return aMatch.mArchetype == aEntity.record().mArchetype;
-                     });
-
-    // TODO: Can be more efficient, we already have the EntityRecord.
-    Archetype & archetype = aEntity.archetype();
-
-    assert(found != mMatchingArchetypes.end());
-    assert(aRecord.mIndex < archetype.countEntities());
-    // TODO this if was introduced by the refactoring to allow vectorization
-    // Can it be removed?
-    if (!aListeners.empty())
+    // The queries with sparse components are never signaled, see listenEntityAdded().
+    if constexpr (gHasSparseComponents)
     {
-        // TODO factorize with the equivalent code in Query.h
-        std::tuple<Storage<VT_components> & ...> storages =
-            std::tie(
-                archetype.getStorage(
-                    std::get<StorageIndex<VT_components>>(found->mComponentIndices))...);
-        for(auto & [_handle, callback] : aListeners)
+        return;
+    }
+    else
+    {
+        auto found =
+            std::find_if(mMatchingArchetypes.begin(),
+                         mMatchingArchetypes.end(),
+                         [&aRecord](const auto & aMatch) -> bool
+                         {
+                           return aMatch.mArchetype == aRecord.mArchetype;
+                         });
+
+        Archetype & archetype = aEntity.archetype();
+
+        assert(found != mMatchingArchetypes.end());
+        assert(aRecord.mIndex < archetype.countEntities());
+        // TODO this if was introduced by the refactoring to allow vectorization
+        // Can it be removed?
+        if (!aListeners.empty())
         {
-            // It is currently hardcoded that the signals' callback are taking all components, in order.
-            // (franz): Added Handle 
-            Invoker<std::tuple<Handle<Entity>, VT_components...>>::template invoke<VT_components...>(
-                    callback,
-                    aEntity, storages, aRecord.mIndex);
+            // TODO factorize with the equivalent code in Query.h
+            std::tuple<Storage<VT_components> & ...> storages =
+                std::tie(
+                    archetype.getStorage(
+                        std::get<StorageIndex<VT_components>>(found->mComponentIndices))...);
+            for(auto & [_handle, callback] : aListeners)
+            {
+                // It is currently hardcoded that the signals' callback are taking all components, in order.
+                // (franz): Added Handle 
+                Invoker<std::tuple<Handle<Entity>, VT_components...>>::template invoke<VT_components...>(
+                        callback,
+                        aEntity, storages, aRecord.mIndex);
+            }
         }
     }
 }
@@ -280,7 +372,8 @@ void QueryBackend<VT_components...>::signal_impl(
 template <class... VT_components>
 const TypeSet & QueryBackend<VT_components...>::GetTypeSet()
 {
-    static TypeSet queryTypeSet = getTypeSet<VT_components...>();
+    // The sparse components are not part of the archetypes signature.
+    static TypeSet queryTypeSet = getArchetypeTypeSet<VT_components...>();
     return queryTypeSet;
 }
 
@@ -0,0 +1,236 @@
+#pragma once
+
+
+#include <entity/Component.h>
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+
+namespace ad {
+namespace ent {
+namespace detail {
+
+
+/// \brief Type-erased SparseSet, so the EntityManager can maintain the sets of all sparse components.
+class SparseSetBase
+{
+public:
+    virtual ~SparseSetBase() = default;
+
+    virtual std::unique_ptr<SparseSetBase> clone() const = 0;
+
+    virtual bool contains(std::size_t aEntityIndex) const = 0;
+
+    /// \brief Remove the component of entity `aEntityIndex`, if it has one.
+    virtual void erase(std::size_t aEntityIndex) = 0;
+
+    /// \brief Give entity `aDestinationIndex` a copy of the component of `aSourceIndex`,
+    /// or remove its component if `aSourceIndex` has none.
+    virtual void copyEntity(std::size_t aSourceIndex, std::size_t aDestinationIndex) = 0;
+
+    virtual std::size_t size() const = 0;
+};
+
+
+/// \brief Components of type T_component, keyed by the index of their entity.
+///
+/// The components are packed in a dense array, the sparse array maps each entity index
+/// to the position of its component in the dense array.
+/// Inserting and erasing a component are constant time, and never move the other components
+/// of the entity (unlike an archetype migration).
+template <class T_component>
+class SparseSet : public SparseSetBase
+{
+public:
+    std::unique_ptr<SparseSetBase> clone() const override;
+
+    bool contains(std::size_t aEntityIndex) const override
+    {
+        return aEntityIndex < mSparse.size() && mSparse[aEntityIndex] != gAbsent;
+    }
+
+    T_component & get(std::size_t aEntityIndex)
+    {
+        assert(contains(aEntityIndex));
+        return mDense[mSparse[aEntityIndex]];
+    }
+
+    /// \brief Construct the component of entity `aEntityIndex` from `aArgs`,
+    /// replacing its current component if it has one.
+    template <class... VT_args>
+    T_component & emplace(std::size_t aEntityIndex, VT_args &&... aArgs);
+
+    void erase(std::size_t aEntityIndex) override;
+
+    void copyEntity(std::size_t aSourceIndex, std::size_t aDestinationIndex) override;
+
+    std::size_t size() const override
+    { return mDense.size(); }
+
+private:
+    static constexpr std::size_t gAbsent = std::numeric_limits<std::size_t>::max();
+
+    // Indexed by entity index, the position of its component in mDense (or gAbsent).
+    std::vector<std::size_t> mSparse;
+    std::vector<T_component> mDense;
+    // The entity index of each component in mDense.
+    std::vector<std::size_t> mEntities;
+};
+
+
+/// \brief The SparseSet of each sparse component type, with value semantic (the sets are cloned on copy).
+class SparseStore : public std::map<ComponentId, std::unique_ptr<SparseSetBase>>
+{
+    using Parent_t = std::map<ComponentId, std::unique_ptr<SparseSetBase>>;
+
+public:
+    SparseStore() = default;
+    ~SparseStore() = default;
+
+    SparseStore(const SparseStore & aRhs) :
+        Parent_t{}
+    {
+        for(const auto & [id, set] : aRhs)
+        {
+            emplace(id, set->clone());
+        }
+    }
+
+    SparseStore & operator=(const SparseStore & aRhs)
+    {
+        SparseStore copy{aRhs};
+        std::swap(static_cast<Parent_t &>(*this), static_cast<Parent_t &>(copy));
+        return *this;
+    }
+
+    SparseStore(SparseStore && aRhs) = default;
+    SparseStore & operator=(SparseStore && aRhs) = default;
+
+    /// \brief Return the set of T_component, creating it on first access.
+    template <class T_component>
+    SparseSet<T_component> & get();
+
+    /// \brief Remove the components of entity `aEntityIndex` from all the sets.
+    void eraseEntity(std::size_t aEntityIndex)
+    {
+        for(auto & [_id, set] : *this)
+        {
+            set->erase(aEntityIndex);
+        }
+    }
+
+    /// \brief Make the sparse components of `aDestinationIndex` copies of those of `aSourceIndex`.
+    void copyEntity(std::size_t aSourceIndex, std::size_t aDestinationIndex)
+    {
+        for(auto & [_id, set] : *this)
+        {
+            set->copyEntity(aSourceIndex, aDestinationIndex);
+        }
+    }
+};
+
+
+//
+// Implementations
+//
+template <class T_component>
+std::unique_ptr<SparseSetBase> SparseSet<T_component>::clone() const
+{
+    if constexpr (std::is_copy_constructible_v<T_component>)
+    {
+        return std::make_unique<SparseSet<T_component>>(*this);
+    }
+    else
+    {
+        throw std::logic_error{"Cannot clone the sparse set of a non-copyable component."};
+    }
+}
+
+
+template <class T_component>
+template <class... VT_args>
+T_component & SparseSet<T_component>::emplace(std::size_t aEntityIndex, VT_args &&... aArgs)
+{
+    if (contains(aEntityIndex))
+    {
+        T_component & component = mDense[mSparse[aEntityIndex]];
+        component = T_component(std::forward<VT_args>(aArgs)...);
+        return component;
+    }
+
+    if (aEntityIndex >= mSparse.size())
+    {
+        mSparse.resize(aEntityIndex + 1, gAbsent);
+    }
+    mSparse[aEntityIndex] = mDense.size();
+    mEntities.push_back(aEntityIndex);
+    return mDense.emplace_back(std::forward<VT_args>(aArgs)...);
+}
+
+
+template <class T_component>
+void SparseSet<T_component>::erase(std::size_t aEntityIndex)
+{
+    if (!contains(aEntityIndex))
+    {
+        return;
+    }
+
+    // The last component is moved over the erased one, as Archetype::remove() does.
+    const std::size_t position = mSparse[aEntityIndex];
+    const std::size_t lastEntity = mEntities.back();
+    if (position != mDense.size() - 1)
+    {
+        mDense[position] = std::move(mDense.back());
+        mEntities[position] = lastEntity;
+        mSparse[lastEntity] = position;
+    }
+    mDense.pop_back();
+    mEntities.pop_back();
+    mSparse[aEntityIndex] = gAbsent;
+}
+
+
+template <class T_component>
+void SparseSet<T_component>::copyEntity(std::size_t aSourceIndex, std::size_t aDestinationIndex)
+{
+    if (!contains(aSourceIndex))
+    {
+        erase(aDestinationIndex);
+    }
+    else if constexpr (std::is_copy_constructible_v<T_component>)
+    {
+        // Copied first: emplace() might reallocate the dense array.
+        T_component copy{get(aSourceIndex)};
+        emplace(aDestinationIndex, std::move(copy));
+    }
+    else
+    {
+        throw std::logic_error{"Cannot copy a non-copyable component."};
+    }
+}
+
+
+template <class T_component>
+SparseSet<T_component> & SparseStore::get()
+{
+    auto [position, inserted] = try_emplace(getId<T_component>());
+    if (inserted)
+    {
+        position->second = std::make_unique<SparseSet<T_component>>();
+    }
+    return static_cast<SparseSet<T_component> &>(*position->second);
+}
+
+
+} // namespace detail
+} // namespace ent
+} // namespace ad